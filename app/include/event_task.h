@@ -1,17 +0,0 @@
-#ifndef __EVENT_TASK_H__
-#define __EVENT_TASK_H__
-
-// #include <zephyr/types.h>
-#include <stddef.h>
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-void event_task_init(void);
-
-#ifdef __cplusplus
-}
-#endif
-
-#endif /* __EVENT_TASK_H__ */
@@ -24,6 +24,8 @@ LOG_MODULE_REGISTER(bsp, LOG_LEVEL_DBG);
 #include <zephyr/sys/util.h>
 
 #include "bsp.h"
+#include <framework/msg_ids.h>
+#include <framework/msg_isr.h>
 #include <framework/sys_cfg.h>
 
 /******************************************************************************/
@@ -173,6 +175,12 @@ void water_flower_check(const struct device *dev, struct gpio_callback *cb,
   printk("water_flower count : %u\n", water_flower_count);
   snprintf(water_flow, sizeof(water_flow), "%u", water_flower_count);
   syscfg_set(WATER_FLOW, water_flow);
+
+#if defined(CONFIG_SYS_MSG_ISR_QUEUE) && defined(CONFIG_SYS_MSG_TOPIC)
+  /* Published by the framework work item, the ISR doesn't allocate */
+  msg_isr_publish(MSG_ID_SENSOR_TASK, SENSOR_EVENT_WATER_FLOW,
+                  (event_data_t)water_flower_count);
+#endif
 }
 
 void gpio_pin_interrupt_set(void) {
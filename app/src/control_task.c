@@ -12,15 +12,15 @@
 // #include <zephyr/fs/nvs.h>
 // #include <zephyr/storage/flash_map.h>
 
+#include <framework/buffer_pool.h>
+#include <framework/msg_call.h>
 #include <framework/msg_ids.h>
 #include <framework/sys_msg_macros.h>
 #include <framework/sys_msg_types.h>
 
 #include "bsp.h"
 #include "control_task.h"
-#include "event_task.h"
 #include "lorawan.h"
-#include "sensor_task.h"
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(control_task, LOG_LEVEL_DBG);
@@ -30,6 +30,13 @@ LOG_MODULE_REGISTER(control_task, LOG_LEVEL_DBG);
 // #define CONFIG_HEARTBEAT_SECONDS 300
 #define CONFIG_HEARTBEAT_SECONDS 120
 
+#define JOIN_RETRY_DELAY K_MSEC(5000)
+#define SEND_RETRY_DELAY K_MSEC(500)
+#define SEND_MAX_RETRIES 5
+/* Sensor data that waited longer than a heartbeat isn't worth sending */
+#define SEND_DATA_TTL_MS (CONFIG_HEARTBEAT_SECONDS * MSEC_PER_SEC)
+#define SEND_DATA_DEADLINE_US (100 * USEC_PER_MSEC)
+
 #if !CONTROL_TASK_USES_MAIN_THREAD
 #ifndef CONTROL_TASK_PRIORITY
 #define CONTROL_TASK_PRIORITY K_PRIO_PREEMPT(1)
@@ -44,6 +51,22 @@ LOG_MODULE_REGISTER(control_task, LOG_LEVEL_DBG);
 #define CONTROL_TASK_QUEUE_DEPTH 32
 #endif
 
+#ifndef CONTROL_TASK_URGENT_QUEUE_DEPTH
+#define CONTROL_TASK_URGENT_QUEUE_DEPTH 4
+#endif
+
+/* The control task creates its messages from a pool of its own, so that a
+ * flood of sensor events can't take the buffers it needs to join or report. */
+#if CONFIG_BUFFER_POOL_COUNT > 1
+#define CONTROL_BUFFER_POOL 1
+
+#ifndef CONTROL_BUFFER_POOL_SIZE
+#define CONTROL_BUFFER_POOL_SIZE 512
+#endif
+#else
+#define CONTROL_BUFFER_POOL BP_POOL_DEFAULT
+#endif
+
 // #define NVS_PARTITION storage_partition
 // #define NVS_PARTITION_DEVICE FIXED_PARTITION_DEVICE(NVS_PARTITION)
 // #define NVS_PARTITION_OFFSET FIXED_PARTITION_OFFSET(NVS_PARTITION)
@@ -52,6 +75,8 @@ LOG_MODULE_REGISTER(control_task, LOG_LEVEL_DBG);
 
 typedef struct {
   msg_task_t msg_task;
+  msg_pending_t join_pending;
+  msg_pending_t send_pending;
   uint32_t boradcast_cnt;
   bool b_factory_reset;
   bool b_task_started;
@@ -62,19 +87,27 @@ typedef struct {
 /**********************************************************/
 static control_ctx_t ctrl_ctx;
 
+#if CONFIG_BUFFER_POOL_COUNT > 1
+BUFFER_POOL_DEFINE(control_pool, CONTROL_BUFFER_POOL, CONTROL_BUFFER_POOL_SIZE);
+#endif
+
 // static struct nvs_fs fs;
 static uint16_t dev_nonce;
 
 static bool b_send_msg_lorawan;
 
-uint8_t tx_data[51] = {0};
+char tx_data[51] = {0};
 
 #if !CONTROL_TASK_USES_MAIN_THREAD
 K_THREAD_STACK_DEFINE(ctrl_task_stack, CONTROL_TASK_STACK_DEPTH);
 #endif
 
-K_MSGQ_DEFINE(ctrl_task_queue, MSG_QUEUE_ENTRY_SIZE, CONTROL_TASK_QUEUE_DEPTH,
-              MSG_QUEUE_ALIGNMENT);
+MSG_QUEUE_DEFINE(ctrl_task_queue, CONTROL_TASK_QUEUE_DEPTH);
+
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+/* Reset requests must not wait behind heartbeat and sensor traffic. */
+MSG_QUEUE_DEFINE(ctrl_task_urgent_queue, CONTROL_TASK_URGENT_QUEUE_DEPTH);
+#endif
 
 /**********************************************************/
 /* Local Function Prototypes                              */
@@ -101,26 +134,35 @@ static dispatch_result_t send_data_lorawan_msg_handler(msg_recv_t *p_msg_rxer,
                                                        msg_t *p_msg);
 static dispatch_result_t sensor_event_msg_handler(msg_recv_t *p_msg_rxer,
                                                   msg_t *p_msg);
+#ifdef CONFIG_SYS_MSG_CALL
+static dispatch_result_t sensor_reading_reply_handler(msg_recv_t *p_msg_rxer,
+                                                      msg_t *p_msg);
+#endif
 
 static void reboot_handler(void);
 
 /**********************************************************/
 /* System Message Dispatcher                              */
 /**********************************************************/
-static msg_handler_t *control_task_msg_dispatcher(msg_code_t msg_code) {
-  /* clang-format off */
-  switch (msg_code) {
-    case SMC_INVALID:           return sys_unknown_msg_handler;
-    case SMC_PERIODIC:          return heart_beat_msg_handler;
-    case SMC_SW_RESET:          return sw_reset_msg_handler;
-    case SMC_FACTORY_RESET:     return factory_reset_msg_handler;
-    case SMC_JOIN_LORAWAN:      return join_lorawan_msg_handler;
-    case SMC_SENSOR_EVENT:      return sensor_event_msg_handler;
-    case SMC_SEND_DATA_LORAWAN: return send_data_lorawan_msg_handler;
-    default:                    return NULL;
-  }
-  /* clang-format on */
-}
+/* clang-format off */
+MSG_DISPATCHER_DEFINE(control_task_msg_dispatcher,
+  MSG_HANDLER(SMC_INVALID,           sys_unknown_msg_handler),
+  MSG_HANDLER(SMC_PERIODIC,          heart_beat_msg_handler),
+  MSG_HANDLER(SMC_SW_RESET,          sw_reset_msg_handler),
+  MSG_HANDLER(SMC_FACTORY_RESET,     factory_reset_msg_handler),
+  MSG_HANDLER(SMC_JOIN_LORAWAN,      join_lorawan_msg_handler),
+  MSG_HANDLER(SMC_SENSOR_EVENT,      sensor_event_msg_handler),
+  MSG_HANDLER(SMC_SEND_DATA_LORAWAN, send_data_lorawan_msg_handler));
+
+#ifdef CONFIG_SYS_MSG_SCHED
+/* Resets and uplinks run before the heartbeat housekeeping */
+MSG_SCHED_DEFINE(control_task_sched, MSG_SCHED_CLASS_NORMAL, 0,
+  MSG_SCHED(SMC_PERIODIC,          MSG_SCHED_CLASS_BACKGROUND, 0),
+  MSG_SCHED(SMC_SW_RESET,          MSG_SCHED_CLASS_CRITICAL,   0),
+  MSG_SCHED(SMC_FACTORY_RESET,     MSG_SCHED_CLASS_CRITICAL,   0),
+  MSG_SCHED(SMC_SEND_DATA_LORAWAN, MSG_SCHED_CLASS_NORMAL,     SEND_DATA_DEADLINE_US));
+#endif
+/* clang-format on */
 
 /**********************************************************/
 /* Global Function Definitions                            */
@@ -132,8 +174,21 @@ void control_task_init(void) {
   ctrl_ctx.msg_task.timer_duration_ticks = K_SECONDS(CONFIG_HEARTBEAT_SECONDS);
   ctrl_ctx.msg_task.timer_period_ticks = K_MSEC(0);
   ctrl_ctx.msg_task.rxer.p_queue = &ctrl_task_queue;
+  ctrl_ctx.msg_task.rxer.pool = CONTROL_BUFFER_POOL;
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+  ctrl_ctx.msg_task.rxer.p_urgent_queue = &ctrl_task_urgent_queue;
+#endif
+#ifdef CONFIG_SYS_MSG_SCHED
+  ctrl_ctx.msg_task.rxer.p_sched = &control_task_sched;
+#endif
 
   msg_register_task(&ctrl_ctx.msg_task);
+#ifdef CONFIG_SYS_MSG_COALESCE
+  /* Sends that pile up during a join or send retry only need to run once. */
+  msg_coalesce_set(SMC_SEND_DATA_LORAWAN, true);
+#endif
+  msg_pending_init(&ctrl_ctx.join_pending, MSG_ID_CONTROL_TASK);
+  msg_pending_init(&ctrl_ctx.send_pending, MSG_ID_CONTROL_TASK);
 
   ctrl_ctx.b_factory_reset = false;
 
@@ -257,10 +312,6 @@ static void ctrl_task_thread(void *p_arg1, void *p_arg2, void *p_arg3) {
 
   reboot_handler();
 
-  // Initialize of other tasks and configuration.
-  sensor_task_init();
-  event_task_init();
-
   // Initialize LoRaWAN
   lorawan_init();
 
@@ -271,7 +322,7 @@ static void ctrl_task_thread(void *p_arg1, void *p_arg2, void *p_arg3) {
   LOG_INF("Control Task is started!!!");
 
   while (true) {
-    msg_receiver(&p_ctrl->msg_task.rxer);
+    msg_receiver_batch(&p_ctrl->msg_task.rxer, 0);
   }
 }
 
@@ -315,8 +366,29 @@ static dispatch_result_t heart_beat_msg_handler(msg_recv_t *p_msg_rxer,
   control_ctx_t *p_ctrl = MSG_TASK_CONTAINER(control_ctx_t);
 
   /* do something (send senor data to LoRa Gateway periodically) */
+#ifdef CONFIG_SYS_MSG_CALL
+  /* Ask the sensor task for a fresh reading. The reply is dispatched to
+   * sensor_reading_reply_handler, so the task isn't blocked while waiting. */
+  event_msg_t *p_request = (event_msg_t *)buffer_pool_try_to_take_from(
+      CONTROL_BUFFER_POOL, sizeof(event_msg_t), K_NO_WAIT, __func__);
+
+  BaseType_t result = SYS_ERROR;
+
+  if (p_request != NULL) {
+    SYS_MSG_HEADER_INIT(p_request, SMC_SENSOR_READ, MSG_ID_CONTROL_TASK);
+    result = sysmsg_call_cb(MSG_ID_SENSOR_TASK, (msg_t *)p_request,
+                            sensor_reading_reply_handler);
+  }
+  if (result != SYS_SUCCESS) {
+    /* The measurement is still reported through the sensor event */
+    LOG_WRN("Sensor reading call failed: %d", result);
+    SYSMSG_CREATE_AND_SEND(MSG_ID_CONTROL_TASK, MSG_ID_SENSOR_TASK,
+                            SMC_SENSOR_MEASURE);
+  }
+#else
   SYSMSG_CREATE_AND_SEND(MSG_ID_CONTROL_TASK, MSG_ID_SENSOR_TASK,
                           SMC_SENSOR_MEASURE);
+#endif
 
   LOG_INF("Received HeartBeat message!!!");
 
@@ -334,19 +406,24 @@ static dispatch_result_t factory_reset_msg_handler(msg_recv_t *p_msg_rxer,
   // Need to do factory reset
   // Need reset to init all the configuration values.
 
-  SYSMSG_CREATE_AND_SEND(MSG_ID_CONTROL_TASK, MSG_ID_CONTROL_TASK,
-                         SMC_SW_RESET);
+  SYSMSG_CREATE_AND_SEND_URGENT(MSG_ID_CONTROL_TASK, MSG_ID_CONTROL_TASK,
+                                SMC_SW_RESET);
 
   return DISPATCH_OK;
 }
 
 static dispatch_result_t join_lorawan_msg_handler(msg_recv_t *p_msg_rxer,
                                                   msg_t *p_msg) {
-  LOG_INF("Joining LoRaWAN network");
-
-  int i = 0, ret = 0;
+  control_ctx_t *p_ctrl = MSG_TASK_CONTAINER(control_ctx_t);
+  /* The attempt number is saved when the join is deferred. */
+  uint32_t attempt = msg_resume_state(p_msg);
+  int ret = 0;
   struct lorawan_join_config join_cfg;
 
+  if (!msg_is_resume(p_msg)) {
+    LOG_INF("Joining LoRaWAN network");
+  }
+
   uint8_t dev_eui[] = LORAWAN_DEV_EUI;
   uint8_t join_eui[] = LORAWAN_JOIN_EUI;
   uint8_t app_key[] = LORAWAN_APP_KEY;
@@ -358,28 +435,26 @@ static dispatch_result_t join_lorawan_msg_handler(msg_recv_t *p_msg_rxer,
   join_cfg.otaa.nwk_key = app_key;
   join_cfg.otaa.dev_nonce = dev_nonce;
 
-  do {
-    printk("Joining network using OTAA, dev nonce %d, attempt %d: ", dev_nonce,
-           i++);
-    ret = lorawan_join(&join_cfg);
-    if (ret < 0) {
-      if ((ret = -ETIMEDOUT)) {
-        printf("Timed-out waiting for response.\n");
-      } else {
-        printk("Join failed (%d)\n", ret);
-      }
+  printk("Joining network using OTAA, dev nonce %d, attempt %d: ", dev_nonce,
+         attempt);
+  ret = lorawan_join(&join_cfg);
+  if (ret < 0) {
+    if ((ret = -ETIMEDOUT)) {
+      printf("Timed-out waiting for response.\n");
     } else {
-      printk("Join successful.\n");
+      printk("Join failed (%d)\n", ret);
     }
+  } else {
+    printk("Join successful.\n");
+  }
 
-    dev_nonce = inc_dev_nonce(dev_nonce);
-    join_cfg.otaa.dev_nonce = dev_nonce;
+  dev_nonce = inc_dev_nonce(dev_nonce);
 
-    if (ret < 0) {
-      // If failed, wait before re-trying.
-      k_sleep(K_MSEC(5000));
-    }
-  } while (ret != 0);
+  if (ret < 0) {
+    // If failed, try again later without blocking the queue.
+    return msg_defer(&p_ctrl->join_pending, p_msg, JOIN_RETRY_DELAY,
+                     attempt + 1);
+  }
 
   ret = lorawan_set_class(LORAWAN_CLASS_C);
   if (ret != 0) {
@@ -399,46 +474,63 @@ static dispatch_result_t sensor_event_msg_handler(msg_recv_t *p_msg_rxer,
   event_msg_t *p_event_msg = (event_msg_t *)p_msg;
 
   if (p_event_msg->event_type == SENSOR_EVENT_WATER_FLOW) {
-    uint32_t flow = (int)p_event_msg->event_data.u32;
-    snprintf(tx_data, sizeof(tx_data), "flow: %d", flow);
+    uint32_t flow = p_event_msg->event_data.u32;
+    snprintf(tx_data, sizeof(tx_data), "flow: %u", flow);
     b_send_msg_lorawan = !b_send_msg_lorawan;
   }
 
   if (b_send_msg_lorawan) {
+#ifdef CONFIG_SYS_MSG_TTL
+    SYSMSG_CREATE_AND_SEND_TTL(MSG_ID_CONTROL_TASK, MSG_ID_CONTROL_TASK, SMC_SEND_DATA_LORAWAN, SEND_DATA_TTL_MS);
+#else
     SYSMSG_CREATE_AND_SEND(MSG_ID_CONTROL_TASK, MSG_ID_CONTROL_TASK, SMC_SEND_DATA_LORAWAN);
+#endif
   }
 
   return DISPATCH_OK;
 }
 
+#ifdef CONFIG_SYS_MSG_CALL
+static dispatch_result_t sensor_reading_reply_handler(msg_recv_t *p_msg_rxer,
+                                                      msg_t *p_msg) {
+  ARG_UNUSED(p_msg_rxer);
+  event_msg_t *p_reading = (event_msg_t *)p_msg;
+
+  snprintf(tx_data, sizeof(tx_data), "flow: %u", p_reading->event_data.u32);
+  SYSMSG_CREATE_AND_SEND(MSG_ID_CONTROL_TASK, MSG_ID_CONTROL_TASK,
+                         SMC_SEND_DATA_LORAWAN);
+
+  return DISPATCH_OK;
+}
+#endif
+
 static dispatch_result_t send_data_lorawan_msg_handler(msg_recv_t *p_msg_rxer,
                                                        msg_t *p_msg) {
-  int retries = 0;
-  LOG_INF("Send data to LoRaWAN server");
+  control_ctx_t *p_ctrl = MSG_TASK_CONTAINER(control_ctx_t);
+  /* The number of failed sends is saved when the send is deferred. */
+  uint32_t retries = msg_resume_state(p_msg);
 
-  relay_toggle();
+  if (!msg_is_resume(p_msg)) {
+    LOG_INF("Send data to LoRaWAN server");
 
-  LOG_HEXDUMP_INF(tx_data, sizeof(tx_data), "packet: ");
+    relay_toggle();
 
-  while (true) {
-    int ret = lorawan_send(FPORT, (uint8_t *)&tx_data, strlen(tx_data),
-                           LORAWAN_MSG_UNCONFIRMED);
-    if (ret == -EAGAIN) {
-      LOG_ERR("lorawan_send failed: %d. Continuing...", ret);
-      k_sleep(K_MSEC(500));
-      continue;
-    } else if (ret < 0) {
-      LOG_ERR("lorawan_send failed: %d", ret);
-      if (retries > 5) {
-        break;
-      }
-      k_sleep(K_MSEC(500));
-      retries++;
-      continue;
-    } else {
-      LOG_INF("Data sent!");
-      break;
+    LOG_HEXDUMP_INF(tx_data, sizeof(tx_data), "packet: ");
+  }
+
+  int ret = lorawan_send(FPORT, (uint8_t *)tx_data, strlen(tx_data),
+                         LORAWAN_MSG_UNCONFIRMED);
+  if (ret == -EAGAIN) {
+    LOG_ERR("lorawan_send failed: %d. Continuing...", ret);
+    return msg_defer(&p_ctrl->send_pending, p_msg, SEND_RETRY_DELAY, retries);
+  } else if (ret < 0) {
+    LOG_ERR("lorawan_send failed: %d", ret);
+    if (retries <= SEND_MAX_RETRIES) {
+      return msg_defer(&p_ctrl->send_pending, p_msg, SEND_RETRY_DELAY,
+                       retries + 1);
     }
+  } else {
+    LOG_INF("Data sent!");
   }
 
   memset(tx_data, 0x00, sizeof(tx_data));
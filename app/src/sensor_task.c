@@ -9,18 +9,16 @@
 #include <framework/events.h>
 #include <framework/sys_cfg.h>
 #include <framework/msg_ids.h>
+#include <framework/msg_topic.h>
 #include <framework/sys_msg_macros.h>
 #include <framework/sys_msg_types.h>
 
 #include "adc.h"
 #include "bsp.h"
-#include "sensor_task.h"
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(sensor_task, LOG_LEVEL_DBG);
 
-#define THIS_FILE "Sensor"
-
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
 /******************************************************************************/
@@ -37,7 +35,8 @@ LOG_MODULE_REGISTER(sensor_task, LOG_LEVEL_DBG);
 #endif
 
 typedef struct {
-  msg_task_t msg_task;
+  static_msg_t power_msg;
+  static_msg_t sensor_read_msg;
 } sensor_ctx_t;
 
 /******************************************************************************/
@@ -49,22 +48,21 @@ static struct k_timer sensor_read_timer;
 
 // static int32_t water_flow;
 
-K_THREAD_STACK_DEFINE(sensor_task_stack, SENSOR_TASK_STACK_DEPTH);
-
-K_MSGQ_DEFINE(sensor_task_queue, MSG_QUEUE_ENTRY_SIZE, SENSOR_TASK_QUEUE_DEPTH,
-              MSG_QUEUE_ALIGNMENT);
-
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
-static void sensor_task_thread(void *, void *, void *);
+static dispatch_result_t sensor_start_msg_handler(msg_recv_t *p_msg_rxer,
+                                                  msg_t *p_msg);
 static dispatch_result_t value_changed_msg_handler(msg_recv_t *p_msg_rxer,
                                                    msg_t *p_msg);
 static dispatch_result_t sensor_measure_msg_handler(msg_recv_t *p_msg_rxer,
                                                     msg_t *p_msg);
 static dispatch_result_t sensor_check_msg_handler(msg_recv_t *p_msg_rxer,
                                                   msg_t *p_msg);
+static dispatch_result_t sensor_read_msg_handler(msg_recv_t *p_msg_rxer,
+                                                 msg_t *p_msg);
 
+static uint32_t read_water_flow(void);
 static void send_sensor_event(event_type_t type, event_data_t data);
 
 static void init_interval_timers(void);
@@ -77,38 +75,27 @@ static void sensor_read_timer_callback(struct k_timer *timer_id);
 /******************************************************************************/
 /* System Message Dispatcher                                                  */
 /******************************************************************************/
-static msg_handler_t *sensor_task_msg_dispatcher(msg_code_t msg_code) {
-  /* clang-format off */
-  switch (msg_code) {
-    case SMC_INVALID: return sys_unknown_msg_handler;
-    case SMC_SENSOR_CHECK: return sensor_check_msg_handler;
-    case SMC_VALUE_CHANGED: return value_changed_msg_handler;
-    case SMC_SENSOR_MEASURE: return sensor_measure_msg_handler;
-    default: return NULL;
-  }
-  /* clang-format on */
-}
+/* clang-format off */
+MSG_DISPATCHER_DEFINE(sensor_task_msg_dispatcher,
+  MSG_HANDLER(SMC_INVALID, sys_unknown_msg_handler),
+  MSG_HANDLER(SMC_TASK_START, sensor_start_msg_handler),
+  MSG_HANDLER(SMC_SENSOR_CHECK, sensor_check_msg_handler),
+  MSG_HANDLER(SMC_VALUE_CHANGED, value_changed_msg_handler),
+  MSG_HANDLER(SMC_SENSOR_MEASURE, sensor_measure_msg_handler),
+  MSG_HANDLER(SMC_SENSOR_READ, sensor_read_msg_handler));
+
+#ifdef CONFIG_SYS_MSG_SCHED
+/* Periodic measurements are housekeeping, a read is waited for by a caller */
+MSG_SCHED_DEFINE(sensor_task_sched, MSG_SCHED_CLASS_BACKGROUND, 0,
+  MSG_SCHED(SMC_VALUE_CHANGED, MSG_SCHED_CLASS_NORMAL, 10 * USEC_PER_MSEC),
+  MSG_SCHED(SMC_SENSOR_READ, MSG_SCHED_CLASS_NORMAL, 50 * USEC_PER_MSEC));
+#endif
+/* clang-format on */
 
-/******************************************************************************/
-/* Global Function Definitions                                                */
-/******************************************************************************/
-void sensor_task_init(void) {
-  sensor_ctx.msg_task.rxer.id = MSG_ID_SENSOR_TASK;
-  sensor_ctx.msg_task.rxer.rx_block_ticks = K_FOREVER;
-  sensor_ctx.msg_task.rxer.p_msg_dispatcher = sensor_task_msg_dispatcher;
-  sensor_ctx.msg_task.timer_duration_ticks = K_MSEC(1000);
-  sensor_ctx.msg_task.timer_period_ticks = K_MSEC(0); /* One shot */
-  sensor_ctx.msg_task.rxer.p_queue = &sensor_task_queue;
-
-  /* Register the sensor task for system messaging services */
-  msg_register_task(&sensor_ctx.msg_task);
-
-  sensor_ctx.msg_task.p_tid = k_thread_create(
-      &sensor_ctx.msg_task.data, sensor_task_stack,
-      K_THREAD_STACK_SIZEOF(sensor_task_stack), sensor_task_thread, &sensor_ctx,
-      NULL, NULL, SENSOR_TASK_PRIORITY, 0, K_NO_WAIT);
-  k_thread_name_set(sensor_ctx.msg_task.p_tid, THIS_FILE);
-}
+/* Registered and started by the framework */
+MSG_TASK_DEFINE_SCHED(sensor_task, MSG_ID_SENSOR_TASK, SENSOR_TASK_PRIORITY,
+                      SENSOR_TASK_STACK_DEPTH, SENSOR_TASK_QUEUE_DEPTH,
+                      sensor_task_msg_dispatcher, &sensor_task_sched);
 
 /******************************************************************************/
 /* Local Function Definitions                                                 */
@@ -127,15 +114,30 @@ static float battery_calculate_percentage(float voltage) {
   return percent;
 }
 
-static void sensor_task_thread(void *p_arg1, void *p_arg2, void *p_arg3) {
-  sensor_ctx_t *p_sensor = (sensor_ctx_t *)p_arg1;
+static dispatch_result_t sensor_start_msg_handler(msg_recv_t *p_msg_rxer,
+                                                  msg_t *p_msg) {
+  ARG_UNUSED(p_msg);
+  ARG_UNUSED(p_msg_rxer);
+
+  /* Interval timer messages are preallocated so the timers don't allocate */
+  msg_static_init(&sensor_ctx.power_msg, SMC_READ_POWER, MSG_ID_SENSOR_TASK);
+  msg_static_init(&sensor_ctx.sensor_read_msg, SMC_SENSOR_MEASURE,
+                  MSG_ID_SENSOR_TASK);
+
+#ifdef CONFIG_SYS_MSG_COALESCE
+  /* One pending measurement is enough, the reading is taken when it runs */
+  msg_coalesce_set(SMC_SENSOR_MEASURE, true);
+#endif
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+  /* Every flow meter pulse is published, report a change once a minute */
+  msg_event_filter_set(SENSOR_EVENT_WATER_FLOW, 1, 60 * MSEC_PER_SEC);
+#endif
 
   /* Initiaiize interval timers to check the power and sensor data */
   init_interval_timers();
 
-  while (true) {
-    msg_receiver(&p_sensor->msg_task.rxer);
-  }
+  return DISPATCH_OK;
 }
 
 static dispatch_result_t sensor_check_msg_handler(msg_recv_t *p_msg_rxer,
@@ -186,20 +188,36 @@ static dispatch_result_t sensor_measure_msg_handler(msg_recv_t *p_msg_rxer,
   ARG_UNUSED(p_msg);
   ARG_UNUSED(p_msg_rxer);
 
+  send_sensor_event(SENSOR_EVENT_WATER_FLOW, (event_data_t)read_water_flow());
+
+  /* Start sensor interval timer */
+  start_sensor_interval();
+
+  return DISPATCH_OK;
+}
+
+/* Request (an event_msg_t) for a fresh reading that is answered with a reply */
+static dispatch_result_t sensor_read_msg_handler(msg_recv_t *p_msg_rxer,
+                                                 msg_t *p_msg) {
+  ARG_UNUSED(p_msg_rxer);
+
+  event_msg_t *p_event_msg = (event_msg_t *)p_msg;
+
+  p_event_msg->event_type = SENSOR_EVENT_WATER_FLOW;
+  p_event_msg->event_data = (event_data_t)read_water_flow();
+  SYSMSG_REPLY(p_event_msg, SMC_SENSOR_EVENT);
+
+  return DISPATCH_DO_NOT_FREE;
+}
+
+static uint32_t read_water_flow(void) {
   char water_flow[12] = {0};
-  uint32_t water_flow_cnt = 0;
 
   syscfg_get(WATER_FLOW, water_flow, sizeof(water_flow));
 
   LOG_INF("Send sensor flow data = [%s]", water_flow);
 
-  water_flow_cnt = atoi(water_flow);
-  send_sensor_event(SENSOR_EVENT_WATER_FLOW, (event_data_t)water_flow_cnt);
-
-  /* Start sensor interval timer */
-  start_sensor_interval();
-
-  return DISPATCH_OK;
+  return atoi(water_flow);
 }
 
 static void init_interval_timers(void) {
@@ -232,17 +250,22 @@ static void start_sensor_interval(void) {
 }
 
 static void send_sensor_event(event_type_t type, event_data_t data) {
-  event_msg_t *p_event_msg =
-      (event_msg_t *)buffer_pool_take(sizeof(event_msg_t));
+#ifdef CONFIG_SYS_MSG_TOPIC
+  /* Only the subscribers of the event type get it */
+  sysmsg_publish(MSG_ID_SENSOR_TASK, type, data);
+#else
+  event_msg_t *p_event_msg = MSG_NEW(event_msg_t, SMC_EVENT_TRIGGER, MSG_ID_SENSOR_TASK, MSG_ID_EVENT_TASK);
 
   if (p_event_msg != NULL) {
-    p_event_msg->header.msg_code = SMC_EVENT_TRIGGER;
-    p_event_msg->header.tx_id = MSG_ID_SENSOR_TASK;
-    p_event_msg->header.rx_id = MSG_ID_EVENT_TASK;
+    /* The buffer isn't zeroed, so every field is written. */
     p_event_msg->event_type = type;
     p_event_msg->event_data = data;
-    SYSMSG_SEND(p_event_msg);
+    p_event_msg->id = 0;
+    p_event_msg->timestamp = 0;
+    /* A newer reading is more useful than the oldest queued one. */
+    SYSMSG_SEND_DROP_OLDEST(p_event_msg);
   }
+#endif
 }
 
 /******************************************************************************/
@@ -250,12 +273,10 @@ static void send_sensor_event(event_type_t type, event_data_t data) {
 /******************************************************************************/
 static void power_timer_callback(struct k_timer *timer_id) {
   UNUSED_PARAMETER(timer_id);
-  SYSMSG_CREATE_AND_SEND(MSG_ID_SENSOR_TASK, MSG_ID_SENSOR_TASK,
-                         SMC_READ_POWER);
+  msg_static_send(&sensor_ctx.power_msg, MSG_ID_SENSOR_TASK);
 }
 
 static void sensor_read_timer_callback(struct k_timer *timer_id) {
   UNUSED_PARAMETER(timer_id);
-  SYSMSG_CREATE_AND_SEND(MSG_ID_SENSOR_TASK, MSG_ID_SENSOR_TASK,
-                         SMC_SENSOR_MEASURE);
+  msg_static_send(&sensor_ctx.sensor_read_msg, MSG_ID_SENSOR_TASK);
 }
@@ -6,13 +6,25 @@ extern "C" {
 #endif
 
 #include <zephyr/kernel.h>
+#include <zephyr/sys/iterable_sections.h>
 #include <stddef.h>
 
 /*******************************************************************/
 /* Global Function Prototypes                                      */
 /*******************************************************************/
+#ifdef CONFIG_BUFFER_POOL_SLAB
+/* Size classes of the slab backend: blocks of 8, 16, 32, 64 and 128 bytes
+ * (the buffer pool header is part of the block). */
+#define BP_SLAB_CLASSES 5
+#define BP_SLAB_BLOCK_SIZE(_class) (8U << (_class))
+#endif
+
+/* Pool of CONFIG_BUFFER_POOL_SIZE bytes that is always present */
+#define BP_POOL_DEFAULT 0
+
 struct bp_stats {
   bool initialized;
+  const char *name;
   int space_available;
   int min_space_available;
   int max_size;
@@ -22,17 +34,75 @@ struct bp_stats {
   int max_allocs;
   int take_failures;
   int last_fail_size;
+#ifdef CONFIG_BUFFER_POOL_SLAB
+  int slab_used[BP_SLAB_CLASSES];  /* blocks in use in each class */
+  int slab_free[BP_SLAB_CLASSES];  /* free blocks in each class */
+  int heap_fallbacks;              /* takes that fit a class but were served by the heap */
+#endif
 #if CONFIG_BUFFER_POOL_WINDOW_SIZE > 0
   size_t windex;
   uint16_t window[CONFIG_BUFFER_POOL_WINDOW_SIZE];
 #endif
 };
 
+/**
+ * @brief A buffer pool of its own heap.
+ * Pools other than the default one are defined with BUFFER_POOL_DEFINE.
+ */
+struct buffer_pool {
+  uint8_t id;
+  const char *p_name;
+  struct k_heap *p_heap;
+  size_t size;
+#ifdef CONFIG_BUFFER_POOL_STATS
+  struct bp_stats stats;
+#endif
+};
+
+/**
+ * @brief Statically define a buffer pool.
+ *
+ * Buffers taken from the pool can't use up the space of other pools,
+ * so a pool can be reserved for messages that must not be starved by a
+ * flood of other messages. The pool is registered when the buffer pool is
+ * initialized.
+ *
+ * Example:
+ * BUFFER_POOL_DEFINE(control_pool, CONTROL_BUFFER_POOL, 512);
+ * void *p = buffer_pool_try_to_take_from(CONTROL_BUFFER_POOL, size, K_NO_WAIT, __func__);
+ *
+ * @param _name name of the pool object (a struct buffer_pool)
+ * @param _id pool index (1 to CONFIG_BUFFER_POOL_COUNT - 1)
+ * @param _size heap size in bytes
+ */
+#define BUFFER_POOL_DEFINE(_name, _id, _size)                                                                          \
+  BUILD_ASSERT((_id) > BP_POOL_DEFAULT && (_id) < CONFIG_BUFFER_POOL_COUNT, "Invalid buffer pool id");                 \
+  static K_HEAP_DEFINE(_name##_heap, _size);                                                                           \
+  STRUCT_SECTION_ITERABLE(buffer_pool, _name) = {                                                                      \
+      .id = (_id),                                                                                                     \
+      .p_name = #_name,                                                                                                \
+      .p_heap = &_name##_heap,                                                                                         \
+      .size = (_size),                                                                                                 \
+  }
+
 #define BP_CONTEXT_UNUSED "NA"
 #define BP_TRY_TO_TAKE(s) buffer_pool_try_to_take(s, __func__)
 
+/**
+ * @brief Take an uninitialized buffer for an object of a type.
+ * The object isn't set to zero (see buffer_pool_take_uninit).
+ *
+ * @note Don't use it for messages, use MSG_NEW, which also initializes
+ * the whole header (and takes the buffer from the pool of the sender).
+ *
+ * Example:
+ * struct sample *p_sample = BP_NEW(struct sample);
+ */
+#define BP_NEW(_type) ((_type *)buffer_pool_take_uninit(sizeof(_type)))
+
 /**
  * @brief Prepares sys buffer pool for use.
+ * Registers the pools defined with BUFFER_POOL_DEFINE.
  */
 void buffer_pool_init(void);
 
@@ -60,6 +130,20 @@ void *buffer_pool_try_to_take_timeout(size_t size, k_timeout_t timeout, const ch
  */
 void *buffer_pool_try_to_take(size_t size, const char *const context);
 
+/**
+ * @brief Waits up to timeout to allocate a buffer of at least
+ * size bytes from a pool and return a pointer.
+ * The buffer is set to zero.
+ * This function won't assert if a buffer can't be taken.
+ *
+ * @param pool index of the pool (BP_POOL_DEFAULT or a BUFFER_POOL_DEFINE id)
+ * @param size in bytes
+ * @param timeout zephyr timeout
+ * @param context for printing warning when buffer can't be allocated
+ * @return void *
+ */
+void *buffer_pool_try_to_take_from(uint8_t pool, size_t size, k_timeout_t timeout, const char *const context);
+
 /**
  * @brief Allocates a buffer of at least size bytes and returns a pointer.
  * The buffer is set to zero.
@@ -67,18 +151,57 @@ void *buffer_pool_try_to_take(size_t size, const char *const context);
  */
 void *buffer_pool_take(size_t size);
 
+/**
+ * @brief Allocates a buffer of at least size bytes and returns a pointer.
+ * Only the buffer pool header is initialized. The buffer isn't set to
+ * zero, so the caller must write every field that is read later.
+ * This function will assert if a buffer can't be taken.
+ */
+void *buffer_pool_take_uninit(size_t size);
+
+/**
+ * @brief Allocates a buffer of at least size bytes from a pool.
+ * Only the buffer pool header is initialized.
+ * This function will assert if a buffer can't be taken.
+ *
+ * @param pool index of the pool (BP_POOL_DEFAULT or a BUFFER_POOL_DEFINE id)
+ * @param size in bytes
+ */
+void *buffer_pool_take_uninit_from(uint8_t pool, size_t size);
+
 /**
  * @brief Put a buffer back into the free pool.
+ * If references were added to the buffer, then one reference is dropped and
+ * the buffer is only freed when the last reference is released.
  */
 void buffer_pool_free(void *p_buffer);
 
+/**
+ * @brief Add references to a buffer so that it can be shared.
+ * Each reference must be released with buffer_pool_free.
+ *
+ * @param p_buffer a buffer taken from the pool
+ * @param count number of references to add
+ */
+void buffer_pool_add_ref(void *p_buffer, uint8_t count);
+
+/**
+ * @brief Get the size that was requested when a buffer was taken.
+ */
+size_t buffer_pool_size(const void *p_buffer);
+
+/**
+ * @brief Get the index of the pool that a buffer was taken from.
+ */
+uint8_t buffer_pool_index(const void *p_buffer);
+
 /**
  * @brief Get pointer to buffer pool statistics
  *
- * @param index of buffer pool.  Only 0 is valid at this time.
+ * @param index of buffer pool (less than CONFIG_BUFFER_POOL_COUNT).
  * @param stats pointer to stats that will be copied into by this function.
  *
- * @return 0 on success, otherwise negative
+ * @return 0 on success, otherwise negative (-EINVAL if the pool isn't defined)
  */
 int buffer_pool_get_stats(uint8_t index, struct bp_stats *stats);
 
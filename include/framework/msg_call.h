@@ -0,0 +1,123 @@
+#ifndef __MSG_CALL_H__
+#define __MSG_CALL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+#include <stdbool.h>
+
+#include "sys_core.h"
+
+/*******************************************************************/
+/* Global Constants, Macros and Type Definitions                   */
+/*******************************************************************/
+/**
+ * Reply of a call made with sysmsg_call_async.
+ * The signal is raised when the reply arrives, so a future can be waited on
+ * with k_poll together with other events.
+ */
+typedef struct msg_future {
+  struct k_poll_signal signal;
+  msg_t *p_reply;
+  uint16_t seq;
+} msg_future_t;
+
+/* A reply callback is called like a handler in the context of the caller. */
+typedef msg_handler_t msg_reply_cb_t;
+
+/*******************************************************************/
+/* Global Function Prototypes                                      */
+/*******************************************************************/
+/**
+ * @brief Sends a request and waits for the reply.
+ *
+ * A sequence number is stamped in the header of the request. The receiver
+ * answers with sysmsg_reply, which hands the reply directly to the caller
+ * (it isn't queued to the caller).
+ *
+ * @note Can't be called from interrupt context or by the receiver of the
+ * request. A reply that arrives after the timeout is freed.
+ *
+ * @param rx_id receiver of the request
+ * @param p_msg request (tx_id must be set). The message is freed if it can't
+ * be sent.
+ * @param pp_reply reply. The caller must release it with msg_release.
+ * @param timeout to wait for the reply
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR (including timeout)
+ */
+BaseType_t sysmsg_call(mid_t rx_id, msg_t *p_msg, msg_t **pp_reply, TickType_t timeout);
+
+/**
+ * @brief Sends a request without waiting. The reply is delivered to
+ * the future (see msg_future_wait).
+ *
+ * @param rx_id receiver of the request
+ * @param p_msg request (tx_id must be set)
+ * @param p_future must stay valid until the reply is taken or the call is
+ * cancelled
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t sysmsg_call_async(mid_t rx_id, msg_t *p_msg, msg_future_t *p_future);
+
+/**
+ * @brief Sends a request. The reply is queued to the caller (tx_id of the
+ * request) and dispatched to reply_cb instead of the dispatcher of the
+ * caller.
+ *
+ * @note The call is given up after CONFIG_SYS_MSG_CALL_CB_TIMEOUT_MS
+ * and a reply that arrives later isn't given to reply_cb.
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t sysmsg_call_cb(mid_t rx_id, msg_t *p_msg, msg_reply_cb_t *reply_cb);
+
+/**
+ * @brief Waits for the reply of a call. The call is cancelled on timeout.
+ *
+ * @param p_future future of the call
+ * @param pp_reply reply. The caller must release it with msg_release.
+ * @param timeout
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t msg_future_wait(msg_future_t *p_future, msg_t **pp_reply, TickType_t timeout);
+
+/**
+ * @brief Cancels a call. A reply that arrives later is freed.
+ *
+ * @retval true if the call was pending, false if the reply already arrived
+ * (and is in the future).
+ */
+bool msg_future_cancel(msg_future_t *p_future);
+
+/**
+ * @brief Delivers a reply to a waiting caller. Called by sysmsg_reply.
+ *
+ * @retval true if the reply was consumed (given to a future, or freed because
+ * nothing is waiting for it). false if the reply is queued to the caller.
+ */
+bool msg_call_complete(msg_t *p_reply);
+
+/**
+ * @brief Forgets the call of a reply that couldn't be queued to the caller.
+ * Called by sysmsg_reply.
+ */
+void msg_call_drop(const msg_t *p_reply);
+
+/**
+ * @brief Callback of a reply that was queued to the caller.
+ * Called by the framework when the reply is dispatched.
+ *
+ * @retval reply callback or NULL if the call isn't pending
+ */
+msg_reply_cb_t *msg_call_reply_handler(const msg_t *p_reply);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MSG_CALL_H__ */
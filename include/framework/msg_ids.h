@@ -5,6 +5,7 @@ typedef enum {
   MSG_ID_CONTROL_TASK = 1,
   MSG_ID_SENSOR_TASK,
   MSG_ID_EVENT_TASK,
+  MSG_ID_EVENT_FILTER,
 } msg_task_id;
 
 #endif /* __MSG_IDS_H__ */
@@ -0,0 +1,77 @@
+#ifndef __MSG_ISR_H__
+#define __MSG_ISR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+
+#include "sys_core.h"
+#include "events.h"
+
+/*******************************************************************/
+/* Global Function Prototypes                                      */
+/*******************************************************************/
+/**
+ * Messages sent by interrupt handlers are deferred.
+ *
+ * Each send pushes a fixed-size record into a lock-free ring (any number of
+ * producers, one consumer) and submits a work item. The work item drains the
+ * ring in thread context and sends the messages with the sysmsg functions,
+ * so an interrupt handler doesn't allocate, take a lock or visit the
+ * registry and returns in bounded time.
+ *
+ * The messages are header-only (see sysmsg_create_and_send), except for
+ * msg_isr_publish. If the ring is full, then the message is dropped and
+ * counted (see msg_isr_drops).
+ *
+ * All of them can also be called from thread context.
+ */
+
+/**
+ * @brief Deferred sysmsg_create_and_send.
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR if the ring is full
+ */
+BaseType_t msg_isr_send(mid_t tx_id, mid_t rx_id, msg_code_t code);
+
+/**
+ * @brief Deferred sysmsg_unicast_create_and_send.
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR if the ring is full
+ */
+BaseType_t msg_isr_unicast(mid_t tx_id, msg_code_t code);
+
+/**
+ * @brief Deferred sysmsg_create_and_broadcast.
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR if the ring is full
+ */
+BaseType_t msg_isr_broadcast(mid_t tx_id, msg_code_t code);
+
+#ifdef CONFIG_SYS_MSG_TOPIC
+/**
+ * @brief Deferred sysmsg_publish.
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR if the ring is full
+ */
+BaseType_t msg_isr_publish(mid_t tx_id, event_type_t type, event_data_t data);
+#endif
+
+/**
+ * @brief Get the number of messages dropped because the ring was full,
+ * and of the published events that couldn't be allocated or queued.
+ */
+uint32_t msg_isr_drops(void);
+
+/**
+ * @brief Prepares the ring. Called by the framework during initialization.
+ */
+void msg_isr_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MSG_ISR_H__ */
@@ -0,0 +1,115 @@
+#ifndef __MSG_RECORD_H__
+#define __MSG_RECORD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+#include <stddef.h>
+
+#include "sys_core.h"
+
+/*******************************************************************/
+/* Global Constants, Macros and Type Definitions                   */
+/*******************************************************************/
+/**
+ * One message offered to a receiver. The payload (the bytes after the
+ * header) is truncated to CONFIG_SYS_MSG_RECORD_PAYLOAD bytes.
+ */
+struct msg_record {
+  uint32_t time_us; /** uptime when the message was sent */
+  uint16_t size;    /** size of the payload of the message */
+  mid_t rx_id;
+  msg_code_t msg_code;
+  mid_t tx_id;
+  uint8_t options;
+  uint8_t payload[CONFIG_SYS_MSG_RECORD_PAYLOAD];
+};
+
+/**
+ * Result of a replay.
+ */
+struct msg_replay_report {
+  uint32_t sent;                                    /** messages queued */
+  uint32_t failed;                                  /** messages that couldn't be allocated or queued */
+  uint32_t duration_us;                             /** from the first send until the queues were drained */
+  uint32_t max_queued[CONFIG_SYS_MAX_MSG_RECEIVES]; /** largest number of queued messages of each receiver */
+  uint32_t max_allocs;                              /** largest number of buffers taken from the pool */
+  uint32_t min_space_available;                     /** smallest free space of the pool (needs pool stats) */
+#ifdef CONFIG_SYS_MSG_STATS
+  uint32_t max_residency_us; /** longest time a message spent in a queue */
+  uint32_t max_handler_us;   /** longest time a handler ran */
+#endif
+};
+
+/*******************************************************************/
+/* Global Function Prototypes                                      */
+/*******************************************************************/
+/**
+ * @brief Write a message to the record ring if recording is on.
+ * Called by the framework for every message that is offered to a receiver.
+ * Safe to call from ISRs. The oldest record is overwritten when the ring
+ * is full.
+ */
+void msg_record(mid_t rx_id, const msg_header_t *p_header, const void *p_payload, size_t size);
+
+/**
+ * @brief Start or stop recording.
+ * Recording starts at boot with CONFIG_SYS_MSG_RECORD_AT_BOOT.
+ */
+void msg_record_start(void);
+void msg_record_stop(void);
+
+/**
+ * @brief Copy the records in the ring, oldest first.
+ *
+ * @param p_records destination
+ * @param max_records size of destination
+ * @param p_lost number of records written since the ring was cleared
+ * that weren't copied (can be NULL)
+ *
+ * @return number of records copied
+ */
+size_t msg_record_snapshot(struct msg_record *p_records, size_t max_records, uint32_t *p_lost);
+
+/**
+ * @brief Remove all records from the ring.
+ */
+void msg_record_clear(void);
+
+/**
+ * @brief Send a recorded stream to the registered receivers again.
+ *
+ * Each record is sent as a new buffer pool message with its header and
+ * recorded payload (the rest of the payload is zero). Only
+ * MSG_OPTION_URGENT is kept, callbacks and call sequence numbers aren't
+ * replayed. Recording is stopped while the stream is replayed.
+ *
+ * The queue depths and pool usage are sampled after every send. With
+ * CONFIG_SYS_MSG_STATS the message statistics are reset first, so that
+ * the latencies of the report are those of the replay.
+ *
+ * @param p_records stream (from msg_record_snapshot)
+ * @param count number of records
+ * @param speed 1 for the original timing, n to replay n times faster,
+ * 0 to send the messages back to back
+ * @param drain_ms time to wait for the queues to be empty after the last send
+ * @param p_report result
+ *
+ * @return 0 on success, otherwise negative
+ */
+int msg_replay(const struct msg_record *p_records, size_t count, uint32_t speed, uint32_t drain_ms,
+               struct msg_replay_report *p_report);
+
+/**
+ * @brief Prepares the ring. Called by the framework during initialization.
+ * A ring that was kept in noinit memory through a warm reboot is kept.
+ */
+void msg_record_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MSG_RECORD_H__ */
@@ -0,0 +1,80 @@
+#ifndef __MSG_REMOTE_H__
+#define __MSG_REMOTE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+#include <stddef.h>
+
+#include "sys_core.h"
+
+/*******************************************************************/
+/* Global Constants, Macros and Type Definitions                   */
+/*******************************************************************/
+/**
+ * Counters of the link (see 'sys remote').
+ */
+struct msg_remote_stats {
+  uint32_t frames_sent;     /** data frames written to the UART */
+  uint32_t frames_received; /** data frames with a valid CRC */
+  uint32_t msgs_sent;       /** messages forwarded to the far side */
+  uint32_t msgs_received;   /** messages queued to a local receiver */
+  uint32_t crc_errors;      /** frames with a bad CRC or length */
+  uint32_t lost_frames;     /** gaps in the sequence of data frames */
+  uint32_t overruns;        /** bytes the UART interrupt couldn't buffer */
+  uint32_t drops;           /** messages that were too large, unroutable or couldn't be allocated */
+  uint32_t credit_timeouts; /** times the far side didn't return credits */
+};
+
+/*******************************************************************/
+/* Global Function Prototypes                                      */
+/*******************************************************************/
+/**
+ * @brief Route the messages of a receiver id to the far side of the link.
+ *
+ * A proxy receiver is registered for local_id. Messages sent to it
+ * (unicast, inline, static or with msg_multicast) are queued on the proxy,
+ * written to the UART in batched frames and sent by the far side to its
+ * receiver remote_id. The payload is the part of the buffer after the
+ * header, so pointers in it (callbacks) aren't meaningful on the far side.
+ * Only MSG_OPTION_URGENT is forwarded. A proxy can't be removed.
+ *
+ * @param local_id id that the local tasks send to
+ * @param remote_id id of the receiver on the far side
+ *
+ * @return 0 on success, -EINVAL if an id is invalid or local_id already has
+ * a receiver, -ENOMEM if CONFIG_SYS_MSG_REMOTE_PROXIES are already registered
+ */
+int msg_remote_register(mid_t local_id, mid_t remote_id);
+
+/**
+ * @brief Check if the messages of a receiver id are sent over the link.
+ */
+bool msg_remote_is_proxy(mid_t rx_id);
+
+/**
+ * @brief Get the remote id of a proxy.
+ *
+ * @return remote id or MSG_ID_RESERVED if rx_id isn't a proxy
+ */
+mid_t msg_remote_id(mid_t rx_id);
+
+/**
+ * @brief Feed bytes received from the far side into the link.
+ * Called by the UART interrupt. Other transports can use it too.
+ * Safe to call from ISRs.
+ */
+void msg_remote_receive(const uint8_t *p_data, size_t length);
+
+/**
+ * @brief Copy the link counters.
+ */
+void msg_remote_stats_get(struct msg_remote_stats *p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MSG_REMOTE_H__ */
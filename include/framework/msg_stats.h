@@ -0,0 +1,76 @@
+#ifndef __MSG_STATS_H__
+#define __MSG_STATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+#include <stddef.h>
+
+#include "sys_core.h"
+
+/*******************************************************************/
+/* Global Constants, Macros and Type Definitions                   */
+/*******************************************************************/
+/* Residency isn't known (the message has no timestamp) */
+#define MSG_STATS_NO_RESIDENCY UINT32_MAX
+
+/**
+ * Log2 histograms of one message code handled by one receiver.
+ * Bucket 0 counts times below 1 us and bucket n counts times in
+ * [2^(n-1), 2^n) us. The last bucket also counts everything above it.
+ * Bucket counts saturate.
+ */
+struct msg_code_stats {
+  msg_code_t msg_code;
+  uint32_t count;
+  uint32_t max_residency_us; /** time spent in the queue */
+  uint32_t max_handler_us;   /** time spent in the handler */
+  uint16_t residency[CONFIG_SYS_MSG_STATS_BUCKETS];
+  uint16_t handler[CONFIG_SYS_MSG_STATS_BUCKETS];
+};
+
+/*******************************************************************/
+/* Global Function Prototypes                                      */
+/*******************************************************************/
+/**
+ * @brief Add a handled message to the statistics of a receiver.
+ * Called by the framework in receiver context after a handler returns.
+ *
+ * @param rx_id receiver that handled the message
+ * @param msg_code message type
+ * @param residency_cycles cycles from enqueue to dispatch or
+ * MSG_STATS_NO_RESIDENCY
+ * @param handler_cycles cycles spent in the handler
+ */
+void msg_stats_record(mid_t rx_id, msg_code_t msg_code, uint32_t residency_cycles, uint32_t handler_cycles);
+
+/**
+ * @brief Copy the statistics of a message code handled by a receiver.
+ *
+ * @param rx_id receiver id
+ * @param index of tracked message code (0 to CONFIG_SYS_MSG_STATS_CODES - 1)
+ * @param stats pointer to stats that will be copied into by this function.
+ *
+ * @return 0 on success, -ENOENT if nothing is tracked at index,
+ * otherwise negative
+ */
+int msg_stats_get(mid_t rx_id, size_t index, struct msg_code_stats *stats);
+
+/**
+ * @brief Number of messages handled by a receiver that weren't tracked
+ * because CONFIG_SYS_MSG_STATS_CODES codes were already tracked.
+ */
+uint32_t msg_stats_untracked(mid_t rx_id);
+
+/**
+ * @brief Clear the statistics of all receivers.
+ */
+void msg_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MSG_STATS_H__ */
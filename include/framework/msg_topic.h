@@ -0,0 +1,105 @@
+#ifndef __MSG_TOPIC_H__
+#define __MSG_TOPIC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+
+#include "sys_core.h"
+#include "sys_msg_types.h"
+
+/*******************************************************************/
+/* Global Constants, Macros and Type Definitions                   */
+/*******************************************************************/
+/* The topics of a sensor event are the values of event_type_t. */
+#define MSG_TOPIC(_type) BIT(_type)
+#define MSG_TOPIC_ALL BIT_MASK(NUMBER_OF_EVENTS)
+
+/*******************************************************************/
+/* Global Function Prototypes                                      */
+/*******************************************************************/
+/**
+ * @brief Adds topics to the subscriptions of a receiver.
+ *
+ * Events are delivered to the subscribers with the code SMC_SENSOR_EVENT,
+ * so the receiver must have a handler for it.
+ *
+ * @param rx_id receiver
+ * @param topics mask of topics (MSG_TOPIC(type))
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t msg_topic_subscribe(mid_t rx_id, uint32_t topics);
+
+/**
+ * @brief Removes topics from the subscriptions of a receiver.
+ */
+BaseType_t msg_topic_unsubscribe(mid_t rx_id, uint32_t topics);
+
+/**
+ * @brief Get the subscribers of a topic.
+ *
+ * @retval mask of receiver ids (BIT(id))
+ */
+uint32_t msg_topic_subscribers(event_type_t type);
+
+/**
+ * @brief Publishes a sensor event to the subscribers of its event type.
+ *
+ * The message is shared by the subscribers (see msg_multicast) and the code is
+ * set to SMC_SENSOR_EVENT. With CONFIG_SYS_MSG_EVENT_FILTER the event is
+ * sent to the event filter task first, which publishes it if it passes the
+ * filter of its event type.
+ *
+ * @param p_event_msg event (tx_id, event_type and event_data must be set)
+ *
+ * @retval Caller is responsible for freeing memory, if status isn't success.
+ * Success is returned when the event was queued to the subscribers (or to the
+ * filter). An event without subscribers is freed and also returns success.
+ */
+BaseType_t msg_publish(event_msg_t *p_event_msg);
+
+/**
+ * @brief Allocates a sensor event from the buffer pool and publishes it.
+ * The message is freed if it can't be published. The event is dropped
+ * without an assertion when the pool of tx_id is empty.
+ *
+ * @param tx_id source of event
+ * @param type topic
+ * @param data
+ *
+ * @retval SYS_SUCCESS, -ENOMEM if a buffer can't be taken, otherwise the
+ * error of msg_publish
+ */
+BaseType_t sysmsg_publish(mid_t tx_id, event_type_t type, event_data_t data);
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+/**
+ * @brief Sets the filter of an event type.
+ *
+ * An event is dropped when its value (event_data.s32) differs from the last
+ * published value by less than the threshold, or when less than the minimum
+ * interval has elapsed since the last published event. The first event is
+ * always published. A filter of 0, 0 publishes every event (the default).
+ *
+ * @param type topic
+ * @param threshold minimum change of the value
+ * @param min_interval_ms minimum time between events
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t msg_event_filter_set(event_type_t type, uint32_t threshold, uint32_t min_interval_ms);
+
+/**
+ * @brief Get the number of events dropped by the filter of an event type.
+ */
+uint32_t msg_event_filter_drops(event_type_t type);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MSG_TOPIC_H__ */
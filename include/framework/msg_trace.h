@@ -0,0 +1,86 @@
+#ifndef __MSG_TRACE_H__
+#define __MSG_TRACE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+#include <stddef.h>
+
+#include "sys_core.h"
+
+/*******************************************************************/
+/* Global Constants, Macros and Type Definitions                   */
+/*******************************************************************/
+typedef enum msg_trace_event_enum {
+  MSG_TRACE_QUEUE = 0,      /* arg: queue depth after the put */
+  MSG_TRACE_DROP,           /* arg: 1 if discarded from the queue, 0 if rejected */
+  MSG_TRACE_DISPATCH,       /* arg: dispatch result */
+  MSG_TRACE_FREE,           /* arg: unused */
+  MSG_TRACE_UNKNOWN,        /* arg: unused */
+  MSG_TRACE_TIMER_START,    /* arg: period in ms */
+  MSG_TRACE_TIMER_STOP,     /* arg: unused */
+  MSG_TRACE_STATIC_OVERRUN, /* arg: overruns of the static message */
+  MSG_TRACE_COALESCE,       /* arg: queue depth (unchanged) */
+  MSG_TRACE_EXPIRE,         /* arg: ms since the message expired */
+  MSG_TRACE_EVENT_COUNT,
+} msg_trace_event_t;
+
+/**
+ * One trace record. Records are written without a lock, so a record that
+ * is overwritten while it is being read may be inconsistent.
+ */
+struct msg_trace_record {
+  uint32_t cycles; /** k_cycle_get_32() when the record was written */
+  uint32_t arg;
+  uint8_t event;
+  mid_t task;
+  msg_code_t msg_code;
+  uint8_t reserved;
+};
+
+#ifdef CONFIG_SYS_MSG_TRACE
+#define MSG_TRACE(_event, _task, _code, _arg) msg_trace((_event), (_task), (_code), (_arg))
+#else
+#define MSG_TRACE(_event, _task, _code, _arg)
+#endif
+
+/*******************************************************************/
+/* Global Function Prototypes                                      */
+/*******************************************************************/
+/**
+ * @brief Write a record to the trace ring. Safe to call from ISRs.
+ * The oldest record is overwritten when the ring is full.
+ *
+ * @note Use MSG_TRACE so that nothing is compiled when tracing is disabled.
+ */
+void msg_trace(msg_trace_event_t event, mid_t task, msg_code_t msg_code, uint32_t arg);
+
+/**
+ * @brief Copy the records in the ring, oldest first.
+ *
+ * @param p_records destination
+ * @param max_records size of destination
+ * @param p_lost number of records written since the ring was cleared
+ * that weren't copied (can be NULL)
+ *
+ * @return number of records copied
+ */
+size_t msg_trace_snapshot(struct msg_trace_record *p_records, size_t max_records, uint32_t *p_lost);
+
+/**
+ * @brief Remove all records from the ring.
+ */
+void msg_trace_clear(void);
+
+/**
+ * @brief Name of a trace event.
+ */
+const char *msg_trace_event_name(uint8_t event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MSG_TRACE_H__ */
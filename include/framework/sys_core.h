@@ -5,6 +5,7 @@
 
 #include <zephyr/init.h>
 #include <zephyr/kernel.h>
+#include <zephyr/sys/iterable_sections.h>
 #include <zephyr/sys/reboot.h>
 
 #ifdef __cplusplus
@@ -66,6 +67,7 @@ enum sys_status {
 #define SMC_WTD_RESPOSE         4
 #define SMC_VALUE_CHANGED       5
 #define SMC_FACTORY_RESET       6
+#define SMC_TASK_START          7
 #define SMC_APP_SPECIFIC_START  8
 #define SMC_JOIN_LORAWAN        9
 #define SMC_SEND_DATA_LORAWAN   10
@@ -74,6 +76,8 @@ enum sys_status {
 #define SMC_SENSOR_EVENT        13
 #define SMC_EVENT_TRIGGER       14
 #define SMC_SENSOR_CHECK        15
+#define SMC_SENSOR_READ         16
+#define SMC_EVENT_PUBLISH       17
 /* clang-format on */
 
 typedef uint8_t msg_code_t;
@@ -85,12 +89,35 @@ typedef uint8_t mid_t;
 enum msg_option {
   MSG_OPTION_NONE = 0,
   MSG_OPTION_CALLBACK = BIT(0),
+  /* A single read-only buffer is queued to several receivers (broadcast). */
+  MSG_OPTION_SHARED = BIT(1),
+  /* Use the urgent lane of the receiver, if it has one. */
+  MSG_OPTION_URGENT = BIT(2),
+  /* Preallocated message (static_msg_t) that isn't from the buffer pool. */
+  MSG_OPTION_STATIC = BIT(3),
+  /* Header-only message that was carried in the queue entry. The handler gets
+   * a copy on the stack, so it can't be kept (DISPATCH_DO_NOT_FREE). */
+  MSG_OPTION_INLINE = BIT(4),
+  /* Resume message of a handler that returned DISPATCH_PENDING (msg_defer). */
+  MSG_OPTION_RESUME = BIT(5),
+  /* Reply to a call (see sysmsg_call). */
+  MSG_OPTION_REPLY = BIT(6),
 };
 
+/* What a sender does when the destination queue is full */
+typedef enum msg_policy_enum {
+  MSG_POLICY_FAIL_FAST = 0, /* return an error without waiting */
+  MSG_POLICY_BLOCK,         /* wait up to a timeout for space (not in ISR) */
+  MSG_POLICY_DROP_OLDEST,   /* discard the oldest queued message */
+  MSG_POLICY_REPLACE,       /* replace a queued message that has the same code */
+} msg_policy_t;
+
 typedef enum dispatch_result_enum {
   DISPATCH_OK = 0,
   DISPATCH_ERROR,
   DISPATCH_DO_NOT_FREE,
+  /* The handler isn't done and will be called again (see msg_defer). */
+  DISPATCH_PENDING,
 } dispatch_result_t;
 
 typedef struct msg_header {
@@ -98,6 +125,15 @@ typedef struct msg_header {
   mid_t rx_id;
   mid_t tx_id;
   uint8_t options;
+#ifdef CONFIG_SYS_MSG_CALL
+  uint16_t seq; /* matches a reply to its call, 0 if the message isn't a call */
+#endif
+#ifdef CONFIG_SYS_MSG_TIMESTAMP
+  uint32_t timestamp; /* cycle count when the message was queued */
+#endif
+#ifdef CONFIG_SYS_MSG_TTL
+  uint32_t expiry; /* uptime (ms) at which the message is discarded, 0 if it doesn't expire */
+#endif
 } msg_header_t;
 
 typedef struct msg {
@@ -113,6 +149,33 @@ typedef struct msg_buf {
   uint8_t buffer[]; /** size is determined by allocator */
 } msg_buf_t;
 
+/* Preallocated message that is reused instead of taken from the buffer pool.
+ * At most one copy can be queued at a time. A send that finds the previous
+ * one still queued (or being handled) is counted as an overrun.
+ * Sending doesn't allocate, so it can be used from interrupt context.
+ */
+typedef struct static_msg {
+#ifdef CONFIG_SYS_MSG_FIFO
+  void *link; /* see MSG_QUEUE_LINK */
+#endif
+  msg_t msg;
+  atomic_t in_flight;
+  atomic_t overruns;
+} static_msg_t;
+
+/* Continuation of a handler that returned DISPATCH_PENDING.
+ * The delay starts when the handler returns. When it expires, the resume
+ * message (with the code of the deferred message and MSG_OPTION_RESUME) is
+ * sent to the receiver without allocating.
+ */
+typedef struct msg_pending {
+  static_msg_t resume_msg;
+  struct k_timer timer;
+  TickType_t delay;
+  mid_t rx_id;
+  uint32_t state; /* saved by the handler, see msg_resume_state */
+} msg_pending_t;
+
 /* system callback message
  * Callback occurs in msg receiver context.
  * Receiver may not know about callback.
@@ -129,23 +192,188 @@ typedef struct cb_msg {
  * Each message task ahs a message handler or dispatcher.
  * The dispatcher should be implemented using a case statement
  * so that the number of messages doesn't affect the time to determine
- * what handler to call.
+ * what handler to call, or with MSG_DISPATCHER_DEFINE.
+ *
+ * The dispatcher is also sampled for every message code when the receiver is
+ * registered to build the routing index. The mapping of codes to handlers
+ * must not change after registration.
  */
 typedef struct msg_recv msg_recv_t;
 typedef dispatch_result_t msg_handler_t(msg_recv_t *p_msg_rxer, msg_t *p_msg);
 
+/*
+ * Handler table of a dispatcher defined with MSG_DISPATCHER_DEFINE.
+ * The tables are constant and placed in an iterable section in flash.
+ */
+struct msg_handler_table {
+  const char *p_name;
+  msg_handler_t *(*p_dispatcher)(msg_code_t msg_code);
+  msg_handler_t *const *p_handlers; /* indexed by message code */
+  uint16_t count;
+};
+
+/**
+ * @brief Entry of MSG_DISPATCHER_DEFINE.
+ */
+#define MSG_HANDLER(_code, _handler) [(_code)] = (_handler)
+
+/**
+ * @brief Define a dispatcher from a table of handlers.
+ *
+ * The handlers are declared once as a constant table indexed by message
+ * code, and a dispatcher function that reads the table is defined for the
+ * receiver (p_msg_dispatcher). When the receiver is registered the framework
+ * finds the table of its dispatcher, so routing reads the table without
+ * calling the dispatcher for every code and dispatch is an indexed load.
+ *
+ * The tables are in the msg_handler_table section, so the codes handled
+ * by each dispatcher can be listed from the image ('sys handlers').
+ *
+ * Example:
+ * MSG_DISPATCHER_DEFINE(task_msg_dispatcher,
+ *                       MSG_HANDLER(SMC_TASK_START, start_msg_handler),
+ *                       MSG_HANDLER(SMC_PERIODIC, periodic_msg_handler));
+ *
+ * @param _name name of the dispatcher function
+ * @param ... MSG_HANDLER entries
+ */
+#define MSG_DISPATCHER_DEFINE(_name, ...)                                                                              \
+  static msg_handler_t *_name(msg_code_t msg_code);                                                                    \
+  static msg_handler_t *const _name##_handlers[] = {__VA_ARGS__};                                                      \
+  BUILD_ASSERT(ARRAY_SIZE(_name##_handlers) <= BIT(8 * sizeof(msg_code_t)), "Message code is out of range");           \
+  static const STRUCT_SECTION_ITERABLE(msg_handler_table, _name##_table) = {                                           \
+      .p_name = #_name,                                                                                                \
+      .p_dispatcher = _name,                                                                                           \
+      .p_handlers = _name##_handlers,                                                                                  \
+      .count = ARRAY_SIZE(_name##_handlers),                                                                           \
+  };                                                                                                                   \
+  static msg_handler_t *_name(msg_code_t msg_code) {                                                                   \
+    return (msg_code < ARRAY_SIZE(_name##_handlers)) ? _name##_handlers[msg_code] : NULL;                              \
+  }
+
+/*
+ * Message queue of a receiver.
+ *
+ * By default a queue is a k_msgq of message pointers with a fixed depth.
+ * With CONFIG_SYS_MSG_FIFO a queue is a k_fifo that links the messages through
+ * the word that precedes every message (the last word of the buffer pool
+ * header or the link of a static_msg_t), so queuing is a pointer splice and
+ * the number of queued messages is only limited by the buffer pool.
+ * Queues must be defined with MSG_QUEUE_DEFINE.
+ */
+#ifdef CONFIG_SYS_MSG_FIFO
+typedef struct msg_fifo {
+  struct k_fifo fifo;
+  atomic_t count;
+} msgq_t;
+
+#define MSG_QUEUE_LINK(_p_msg) ((void *)((uint8_t *)(_p_msg) - sizeof(void *)))
+#define MSG_QUEUE_FROM_LINK(_p_link) ((msg_t *)((uint8_t *)(_p_link) + sizeof(void *)))
+
+#define MSG_QUEUE_DEFINE(_name, _depth)                                                                                \
+  BUILD_ASSERT((_depth) > 0, "Queue depth must be positive");                                                          \
+  msgq_t _name = {.fifo = Z_FIFO_INITIALIZER(_name.fifo)}
+
+/* k_poll event type and object of a queue (CONFIG_POLL) */
+#define MSG_QUEUE_POLL_TYPE K_POLL_TYPE_FIFO_DATA_AVAILABLE
+#define MSG_QUEUE_POLL_OBJ(_p_queue) (&(_p_queue)->fifo)
+#else
+typedef struct k_msgq msgq_t;
+
+#define MSG_QUEUE_DEFINE(_name, _depth) K_MSGQ_DEFINE(_name, MSG_QUEUE_ENTRY_SIZE, _depth, MSG_QUEUE_ALIGNMENT)
+
+#define MSG_QUEUE_POLL_TYPE K_POLL_TYPE_MSGQ_DATA_AVAILABLE
+#define MSG_QUEUE_POLL_OBJ(_p_queue) (_p_queue)
+#endif
+
 /*
  * System Message Receiver Object
  * The dispatcher determines what function should handle each message.
  */
-typedef struct k_msgq msgq_t;
+
+#ifdef CONFIG_SYS_MSG_SCHED
+/* The priority of each class is set with CONFIG_SYS_MSG_SCHED_*_PRIORITY. */
+typedef enum msg_sched_class {
+  MSG_SCHED_CLASS_DEFAULT = 0, /* priority of the thread (or of the receiver for a code) */
+  MSG_SCHED_CLASS_CRITICAL,    /* actuation and control */
+  MSG_SCHED_CLASS_NORMAL,      /* requests and uplinks */
+  MSG_SCHED_CLASS_BACKGROUND,  /* housekeeping */
+  MSG_SCHED_CLASS_COUNT,
+} msg_sched_class_t;
+
+struct msg_sched_entry {
+  uint8_t sched_class;  /* msg_sched_class_t */
+  uint32_t deadline_us; /* relative to the start of dispatch, 0 if none (or the one of the receiver) */
+};
+
+/*
+ * Scheduling of a receiver defined with MSG_SCHED_DEFINE.
+ */
+struct msg_sched {
+  struct msg_sched_entry receiver; /* used for codes that aren't in the table */
+  const struct msg_sched_entry *p_entries; /* indexed by message code */
+  uint16_t count;
+};
+
+/**
+ * @brief Entry of MSG_SCHED_DEFINE.
+ */
+#define MSG_SCHED(_code, _class, _deadline_us) [(_code)] = {.sched_class = (_class), .deadline_us = (_deadline_us)}
+
+/**
+ * @brief Define the scheduling of a receiver (msg_recv_t p_sched).
+ *
+ * While a message is dispatched, the thread runs at the priority of the
+ * class of its code and with its deadline (k_thread_deadline_set). Both are
+ * restored after the handler returns. A message without a deadline is
+ * scheduled after any message with one, so between tasks of the same
+ * priority the earliest deadline is handled first.
+ *
+ * Example:
+ * MSG_SCHED_DEFINE(sensor_sched, MSG_SCHED_CLASS_BACKGROUND, 0,
+ *                  MSG_SCHED(SMC_SENSOR_READ, MSG_SCHED_CLASS_NORMAL, 100 * USEC_PER_MSEC));
+ *
+ * @param _name name of the msg_sched object
+ * @param _class class of the receiver
+ * @param _deadline_us deadline of the receiver, 0 if none
+ * @param ... MSG_SCHED entries of the codes that are scheduled differently
+ */
+#define MSG_SCHED_DEFINE(_name, _class, _deadline_us, ...)                                                             \
+  static const struct msg_sched_entry _name##_entries[] = {__VA_ARGS__};                                               \
+  static const struct msg_sched _name = {                                                                              \
+      .receiver = {.sched_class = (_class), .deadline_us = (_deadline_us)},                                            \
+      .p_entries = _name##_entries,                                                                                    \
+      .count = ARRAY_SIZE(_name##_entries),                                                                            \
+  }
+#endif
 
 struct msg_recv {
   mid_t id;
   msgq_t *p_queue;
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+  /* Optional queue for MSG_OPTION_URGENT messages that is always served
+   * before p_queue. NULL if the receiver has a single lane. */
+  msgq_t *p_urgent_queue;
+#endif
   TickType_t rx_block_ticks;
   msg_handler_t *(*p_msg_dispatcher)(msg_code_t msg_code);
+  /* Set by the framework if the dispatcher has a table */
+  const struct msg_handler_table *p_msg_handlers;
   bool (*accept_broadcast)(const msg_t *p_msg);
+  /* Buffer pool of the messages created by the receiver (see BUFFER_POOL_DEFINE) */
+  uint8_t pool;
+  /* Continuation deferred by the handler being dispatched (see msg_defer) */
+  msg_pending_t *p_deferred;
+#ifdef CONFIG_SYS_MSG_SCHED
+  /* Optional scheduling class and deadlines (see MSG_SCHED_DEFINE) */
+  const struct msg_sched *p_sched;
+#endif
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+  /* Serviced by the executor instead of a thread of its own */
+  bool actor;
+  /* Set while the receiver is in the run queue or being serviced */
+  atomic_t scheduled;
+#endif
 };
 
 /**
@@ -160,8 +388,83 @@ typedef struct msg_task {
   struct k_timer timer;
   TickType_t timer_duration_ticks;
   TickType_t timer_period_ticks;
+  static_msg_t timer_msg; /* SMC_PERIODIC sent by the timer */
+  /* Thread parameters of a task created with MSG_TASK_DEFINE */
+  const char *p_name;
+  k_thread_stack_t *p_stack;
+  size_t stack_size;
+  int priority;
 } msg_task_t;
 
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+#define MSG_TASK_STACK_DEFINE(_name, _size) BUILD_ASSERT((_size) > 0, "Task stack size must be positive")
+#define MSG_TASK_STACK(_name) NULL
+#define MSG_TASK_STACK_SIZE(_name) 0
+#else
+#define MSG_TASK_STACK_DEFINE(_name, _size) K_THREAD_STACK_DEFINE(_name##_stack, _size)
+#define MSG_TASK_STACK(_name) (_name##_stack)
+#define MSG_TASK_STACK_SIZE(_name) K_THREAD_STACK_SIZEOF(_name##_stack)
+#endif
+
+#ifdef CONFIG_SYS_MSG_SCHED
+#define MSG_TASK_SCHED(_sched) .p_sched = (_sched),
+#else
+/* The table isn't referenced, so it may be defined under CONFIG_SYS_MSG_SCHED only */
+#define MSG_TASK_SCHED(_sched)
+#endif
+
+/**
+ * @brief Statically define a message task.
+ *
+ * The queue, stack and task object are allocated at build time and the task
+ * object is placed in an iterable section. The framework registers every
+ * defined task and creates its thread during system initialization,
+ * so msg_register_task and k_thread_create aren't called by the application.
+ *
+ * The thread calls the SMC_TASK_START handler of the dispatcher (if there is
+ * one) and then services the queue using msg_receiver_batch.
+ *
+ * With CONFIG_SYS_MSG_EXECUTOR the task doesn't get a thread or a stack.
+ * It is an actor that is serviced by the executor worker threads
+ * (see msg_register_actor) and _prio and _stack_size are unused.
+ *
+ * @param _name name of the task object (a msg_task_t)
+ * @param _id receiver id (must be less than CONFIG_SYS_MAX_MSG_RECEIVES)
+ * @param _prio thread priority
+ * @param _stack_size stack size in bytes
+ * @param _depth queue depth (unused with CONFIG_SYS_MSG_FIFO)
+ * @param _dispatcher message dispatcher
+ */
+#define MSG_TASK_DEFINE(_name, _id, _prio, _stack_size, _depth, _dispatcher)                                           \
+  MSG_TASK_DEFINE_SCHED(_name, _id, _prio, _stack_size, _depth, _dispatcher, NULL)
+
+/**
+ * @brief Statically define a message task with a scheduling table.
+ *
+ * Same as MSG_TASK_DEFINE, but the receiver is scheduled with _sched
+ * (see MSG_SCHED_DEFINE) from its first message on. Without
+ * CONFIG_SYS_MSG_SCHED _sched is ignored.
+ *
+ * @param _sched pointer to the msg_sched object of the task
+ */
+#define MSG_TASK_DEFINE_SCHED(_name, _id, _prio, _stack_size, _depth, _dispatcher, _sched)                             \
+  MSG_QUEUE_DEFINE(_name##_queue, _depth);                                                                             \
+  MSG_TASK_STACK_DEFINE(_name, _stack_size);                                                                           \
+  STRUCT_SECTION_ITERABLE(msg_task, _name) = {                                                                         \
+      .rxer =                                                                                                          \
+          {                                                                                                            \
+              .id = (_id),                                                                                             \
+              .p_queue = &_name##_queue,                                                                               \
+              .rx_block_ticks = K_FOREVER,                                                                             \
+              .p_msg_dispatcher = (_dispatcher),                                                                       \
+              MSG_TASK_SCHED(_sched)                                                                                   \
+          },                                                                                                           \
+      .p_name = #_name,                                                                                                \
+      .p_stack = MSG_TASK_STACK(_name),                                                                                \
+      .stack_size = MSG_TASK_STACK_SIZE(_name),                                                                        \
+      .priority = (_prio),                                                                                             \
+  }
+
 /**
  * @brief Get pointer to object containing task (in dispatcher context).
  *
@@ -193,6 +496,8 @@ typedef struct msg_task {
  * However, the task should be registered before the task is created so that
  * the periodic timer can be created before the task starts.
  *
+ * @note Tasks defined with MSG_TASK_DEFINE are registered by the framework.
+ *
  * @param p_rxer A message receiver.
  * @param p_msgtask Pointer to a message task (which contains a rxer).
  */
@@ -204,9 +509,43 @@ void msg_register_task(msg_task_t *p_msg_task);
  * rx_block_ticks for a message to arrive in a task's queue.
  * When a message is received the appropriate message handler
  * function is called by the dispatcher.
+ *
+ * @note If the receiver has an urgent lane, then both queues are waited on
+ * and the urgent lane is always served first.
  */
 void msg_receiver(msg_recv_t *p_msg_rxer);
 
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+/**
+ * @brief Register a receiver that is serviced by the executor.
+ *
+ * The executor has a run queue of receivers that have messages and a pool of
+ * CONFIG_SYS_MSG_EXECUTOR_THREADS worker threads. A receiver is put on the
+ * run queue when a message is queued to it. A worker then dispatches up to
+ * CONFIG_SYS_MSG_RECEIVER_BATCH_SIZE of its messages before it moves on.
+ * A receiver is never serviced by two workers at the same time.
+ *
+ * @note Handlers of an actor share the worker stack and must not block.
+ * msg_receiver must not be called for an actor.
+ *
+ * @param p_rxer receiver object
+ */
+void msg_register_actor(msg_recv_t *p_rxer);
+#endif
+
+/**
+ * @brief Waits for rx_block_ticks for a message like msg_receiver and then
+ * dispatches the messages that are already queued without blocking again.
+ * A burst of messages is handled in a single wakeup of the task.
+ *
+ * @param p_msg_rxer A message receiver.
+ * @param budget Maximum number of messages to dispatch.
+ * 0 selects CONFIG_SYS_MSG_RECEIVER_BATCH_SIZE.
+ *
+ * @retval Number of messages dispatched.
+ */
+size_t msg_receiver_batch(msg_recv_t *p_msg_rxer, size_t budget);
+
 /**
  * @brief Sends a message to a single task based on task ID.
  *
@@ -217,6 +556,63 @@ void msg_receiver(msg_recv_t *p_msg_rxer);
  */
 BaseType_t msg_send(mid_t rx_id, msg_t *p_msg);
 
+/**
+ * @brief Sends a message to a single task based on task ID and selects what
+ * happens when the queue of the task is full.
+ *
+ * MSG_POLICY_DROP_OLDEST frees the oldest message in the queue to make room.
+ * MSG_POLICY_REPLACE frees a queued message that has the same code and puts
+ * the new message in its place (the queue doesn't grow). If there isn't one,
+ * then the message is queued like MSG_POLICY_FAIL_FAST.
+ *
+ * @param rx_id
+ * @param p_msg
+ * @param policy backpressure policy
+ * @param timeout used by MSG_POLICY_BLOCK
+ * @return BaseType_t
+ * @note Caller is responsile for freeing memory, if status isn't success.
+ */
+BaseType_t msg_send_with_policy(mid_t rx_id, msg_t *p_msg, msg_policy_t policy, TickType_t timeout);
+
+#ifdef CONFIG_SYS_MSG_COALESCE
+/**
+ * @brief Selects whether messages with a code are coalesced.
+ *
+ * When a coalesced message is sent to a receiver that already has a message
+ * with the same code pending, the new message takes the place of the pending
+ * one (which is freed) instead of being queued behind it. Whatever the send
+ * policy, the send succeeds and the queue doesn't grow. Use it for requests
+ * where only the latest one matters, such as a measurement or a periodic job.
+ *
+ * @note The setting applies to every receiver of the code, so it is made by
+ * the task that handles the code. Static and resume messages (such as
+ * SMC_PERIODIC) are never coalesced.
+ *
+ * @param msg_code
+ * @param enable
+ */
+void msg_coalesce_set(msg_code_t msg_code, bool enable);
+
+/**
+ * @brief Get whether messages with a code are coalesced.
+ */
+bool msg_coalesce_get(msg_code_t msg_code);
+#endif
+
+#ifdef CONFIG_SYS_MSG_TTL
+/**
+ * @brief Sets the time to live of a message.
+ *
+ * A message that is still queued when its time to live has elapsed is
+ * discarded by the receiver without calling its handler. Set it just before
+ * the message is sent. Inline messages don't expire.
+ *
+ * @param p_msg
+ * @param ttl_ms time to live from now, 0 to clear it
+ */
+void msg_set_ttl(msg_t *p_msg, uint32_t ttl_ms);
+#endif
+
 /**
  * @brief Blocks on queue waiting for a message.
  *
@@ -229,18 +625,26 @@ BaseType_t msg_send(mid_t rx_id, msg_t *p_msg);
  *
  * @note Only needed in special cases.
  * This function is called by msg_receiver.
+ * @note With CONFIG_SYS_MSG_INLINE the entry may be an inline message
+ * instead of a pointer. Only use this on queues that are sent buffers.
  */
 BaseType_t msg_recv(msgq_t *p_queue, void *pp_data, TickType_t block_ticks);
 
 /**
- * @brief Sends a single message to a single task by searching the
- * dispatcher of each message receiver.
+ * @brief Copy the header of a queue entry (from msg_recv).
+ * The header of an inline message is decoded and its rx_id is MSG_ID_RESERVED.
+ */
+void msg_entry_header(const msg_t *p_entry, msg_header_t *p_header);
+
+/**
+ * @brief Sends a single message to the task that has a handler for the
+ * message code in its dispatcher.
  *
  * @note Prevents indirect coupling of tasks by message IDs.
  * @note This should not be used for messages that can go to more than
- * one destination.
- * @note As the number of tasks increases, the amount of time to find the
- * rx_id increases.
+ * one destination. The receiver with the lowest id is selected.
+ * @note The destination is found in the routing index built at registration,
+ * so the time to find the rx_id doesn't depend on the number of tasks.
  *
  * @param p_msg
  * @return BaseType_t Caller is responsible for freeing memory, if status isn't
@@ -249,17 +653,73 @@ BaseType_t msg_recv(msgq_t *p_queue, void *pp_data, TickType_t block_ticks);
 BaseType_t msg_unicast(msg_t *p_msg);
 
 /**
- * @brief Copies a message and sends it to all tasks that have the message
- * code in their dispatcher.
+ * @brief Sends a message to all tasks that have the message code in their
+ * dispatcher.
+ *
+ * The message isn't copied. It is marked with MSG_OPTION_SHARED and the same
+ * buffer is queued to every subscriber using the buffer pool reference count.
+ * The buffer is freed when the last receiver is done with it.
+ * Handlers must treat a shared message as read-only, and rx_id is left as
+ * MSG_ID_RESERVED.
  *
- * @param msg_size required to copy message.
+ * @param msg_size unused, kept for compatibility.
  *
  * @note Currently an assertion fires if this is called in interrupt context.
  *
  * @retval Caller is responsible for freeing memory, if status isn't success.
+ * Success is returned when at least one subscriber received the message,
+ * SYS_ERROR when there isn't any subscriber and -ENOMSG when the queues of
+ * all subscribers are full.
  */
 BaseType_t msg_broadcast(msg_t *p_msg, size_t msg_size);
 
+/**
+ * @brief Sends a message to a set of tasks.
+ *
+ * The message is shared like a broadcast (see msg_broadcast), but the
+ * receivers are given by the caller instead of the dispatchers.
+ *
+ * @param p_msg
+ * @param targets mask of receiver ids (BIT(id)), ids that aren't registered
+ * are ignored
+ *
+ * @retval Caller is responsible for freeing memory, if status isn't success.
+ * Success is returned when at least one receiver received the message,
+ * SYS_ERROR when no target is registered and -ENOMSG when the queues of
+ * all targets are full.
+ */
+BaseType_t msg_multicast(msg_t *p_msg, uint32_t targets);
+
+#ifdef CONFIG_SYS_MSG_INLINE
+/**
+ * @brief Sends a header-only message to a single task without allocating.
+ * The header is encoded in the queue entry and the receiver dispatches a
+ * copy of it. Can be called from interrupt context.
+ *
+ * @param rx_id
+ * @param tx_id source of message
+ * @param code message type
+ * @param options MSG_OPTION_NONE or MSG_OPTION_URGENT
+ * @return BaseType_t
+ */
+BaseType_t msg_send_inline(mid_t rx_id, mid_t tx_id, msg_code_t code, uint8_t options);
+
+/**
+ * @brief Sends a header-only message without allocating to the task that
+ * has a handler for the message code (see msg_unicast).
+ */
+BaseType_t msg_unicast_inline(mid_t tx_id, msg_code_t code);
+
+/**
+ * @brief Sends a header-only message without allocating to all tasks that
+ * have the message code in their dispatcher (see msg_broadcast).
+ * Every subscriber gets its own copy of the header.
+ *
+ * @retval same as msg_broadcast
+ */
+BaseType_t msg_broadcast_inline(mid_t tx_id, msg_code_t code);
+#endif
+
 /**
  * @brief Bypasses message router and puts a message directly on a queue.
  *
@@ -267,11 +727,130 @@ BaseType_t msg_broadcast(msg_t *p_msg, size_t msg_size);
  */
 BaseType_t msg_queue(msgq_t *p_queue, void *pp_data, TickType_t block_ticks);
 
+/**
+ * @brief Prepares a preallocated message.
+ *
+ * @param p_static_msg message to prepare
+ * @param code message type
+ * @param tx_id source of message
+ */
+void msg_static_init(static_msg_t *p_static_msg, msg_code_t code, mid_t tx_id);
+
+/**
+ * @brief Sends a preallocated message to a single task without allocating.
+ * Can be called from interrupt context.
+ *
+ * @note If the previous send is still queued or being handled, or the
+ * queue is full, then the overrun counter is incremented instead.
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t msg_static_send(static_msg_t *p_static_msg, mid_t rx_id);
+
+/**
+ * @brief Take a message from the buffer pool and initialize its header.
+ * The buffer is taken from the pool of the sender (the pool of the
+ * receiver registered as tx_id, otherwise the default pool).
+ * The payload isn't set to zero, so the caller must write every field
+ * that the receiver reads. Asserts if a buffer can't be taken.
+ *
+ * @param size of the message including the header
+ *
+ * @retval pointer to the message, NULL if a buffer can't be taken and
+ * assertions are disabled (or the assertion handler returns), so callers
+ * check for NULL.
+ */
+void *msg_new(size_t size, msg_code_t code, mid_t tx_id, mid_t rx_id);
+
+/**
+ * @brief Get the buffer pool of the messages created by a receiver.
+ *
+ * @retval pool index (BP_POOL_DEFAULT if the receiver isn't registered)
+ */
+uint8_t msg_pool(mid_t id);
+
+/**
+ * @brief Type-safe wrapper for msg_new. The type must begin with a header.
+ *
+ * Example:
+ * event_msg_t *p_msg = MSG_NEW(event_msg_t, SMC_EVENT_TRIGGER, MSG_ID_SENSOR_TASK, MSG_ID_EVENT_TASK);
+ */
+#define MSG_NEW(_type, _code, _tx_id, _rx_id)                                                                \
+  ((void)sizeof(((_type *)0)->header.msg_code), (_type *)msg_new(sizeof(_type), (_code), (_tx_id), (_rx_id)))
+
+/**
+ * @brief Releases a message after it has been handled.
+ * Buffer pool messages are freed and preallocated messages can be sent again.
+ *
+ * @note Must be called by a handler that returned DISPATCH_DO_NOT_FREE
+ * when it is done with the message.
+ */
+void msg_release(msg_t *p_msg);
+
+/**
+ * @brief Prepares a continuation for the handlers of a receiver.
+ *
+ * @param p_pending continuation (usually in the object of the task)
+ * @param rx_id receiver that resumes
+ */
+void msg_pending_init(msg_pending_t *p_pending, mid_t rx_id);
+
+/**
+ * @brief Defers the rest of a handler instead of blocking the task.
+ * After delay the handler of the message code is called again with a
+ * resume message, so the queue keeps draining while a long operation waits.
+ *
+ * Example:
+ * if (lorawan_join(&cfg) < 0) {
+ *   return msg_defer(&p_obj->join_pending, p_msg, K_SECONDS(5), attempt + 1);
+ * }
+ *
+ * @note The deferred message is released as usual. Anything the handler
+ * needs when it resumes must be saved in state or in the task object.
+ * @note The delay starts after the handler has returned and the message
+ * was released, so a resume handler can defer again with any delay.
+ * Deferring again restarts the delay.
+ * @note Called from a handler of the receiver rx_id of msg_pending_init.
+ *
+ * @param p_pending continuation
+ * @param p_msg message that is being handled
+ * @param delay until the handler is resumed
+ * @param state given back by msg_resume_state
+ * @retval DISPATCH_PENDING (DISPATCH_ERROR if a parameter is invalid)
+ */
+dispatch_result_t msg_defer(msg_pending_t *p_pending, const msg_t *p_msg, TickType_t delay, uint32_t state);
+
+/**
+ * @brief Cancels a deferred handler. A resume message that is already
+ * queued is still handled.
+ */
+void msg_pending_cancel(msg_pending_t *p_pending);
+
+/**
+ * @retval true if the message resumes a deferred handler.
+ */
+bool msg_is_resume(const msg_t *p_msg);
+
+/**
+ * @retval state saved by msg_defer or 0 if the message isn't a resume message
+ */
+uint32_t msg_resume_state(const msg_t *p_msg);
+
+/**
+ * @retval true if a receiver is registered for rx_id
+ */
+bool msg_is_registered(mid_t rx_id);
+
 /**
  * @retval 0 if not empty
  */
 BaseType_t msg_queue_is_empty(mid_t rx_id);
 
+/**
+ * @brief Get the number of messages queued to a receiver (both lanes).
+ */
+uint32_t msg_queue_count(mid_t rx_id);
+
 /**
  * @brief Free all messages in a receiver's queue.
  *
@@ -294,6 +873,32 @@ void msg_stop_timer(msg_task_t *p_mgs_task);
  */
 void msg_change_timer_period(msg_task_t *p_msg_task, TickType_t duration, TickType_t period);
 
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+struct msg_queue_stats {
+  uint32_t high_water;       /** largest number of queued messages */
+  uint32_t enqueue_failures; /** messages that couldn't be queued */
+  uint32_t drops;            /** queued messages discarded by a send policy */
+  uint32_t coalesced;        /** pending messages replaced by coalescing */
+  uint32_t expired;          /** messages discarded because their time to live elapsed */
+};
+
+/**
+ * @brief Get the queue statistics of a receiver.
+ *
+ * @param rx_id receiver id
+ * @param p_stats pointer to stats that will be copied into by this function.
+ *
+ * @return 0 on success, otherwise negative
+ */
+int msg_queue_stats_get(mid_t rx_id, struct msg_queue_stats *p_stats);
+
+/**
+ * @brief Number of messages with a code that were rejected by a full queue
+ * or discarded by a send policy.
+ */
+uint16_t msg_queue_drops_by_code(msg_code_t msg_code);
+#endif
+
 /* Define in application or weak inplementation will be used */
 extern void sys_assertion_handler(char *file, int line);
 extern bool sys_interrupt_context(void);
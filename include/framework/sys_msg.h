@@ -15,15 +15,23 @@ extern "C" {
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
 /******************************************************************************/
+/* The whole header is assigned (seq, timestamp and expiry are cleared),
+ * so the message may come from an uninitialized buffer. */
 #define SYS_MSG_HEADER_INIT(p, c, i)                                           \
   do {                                                                         \
     SYSCORE_ASSERT((p) != NULL);                                               \
-    p->header.msg_code = (c);                                                  \
-    p->header.rx_id = MSG_ID_RESERVED;                                         \
-    p->header.tx_id = (i);                                                     \
-    p->header.options = MSG_OPTION_NONE;                                       \
+    (p)->header = (msg_header_t){                                              \
+        .msg_code = (c),                                                       \
+        .rx_id = MSG_ID_RESERVED,                                              \
+        .tx_id = (i),                                                          \
+        .options = MSG_OPTION_NONE,                                            \
+    };                                                                         \
   } while (0)
 
+/* A full queue is counted by the framework and the message is freed.
+ * Only routing errors (SYS_ERROR) fire an assertion. */
+#define SYSMSG_ASSERT_ROUTED(r) SYSCORE_ASSERT((r) != SYS_ERROR)
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -33,6 +41,10 @@ extern "C" {
  *
  * @param p_msg pointer to a sys message
  *
+ * @note The sysmsg functions free the message when it can't be sent.
+ * An assertion only fires when the message can't be routed,
+ * not when the destination queue is full.
+ *
  * @retval SYS_SUCCESS or SYS_ERROR
  */
 BaseType_t sysmsg_send(msg_t *p_msg);
@@ -46,6 +58,17 @@ BaseType_t sysmsg_send(msg_t *p_msg);
  */
 BaseType_t sysmsg_try_to_send(msg_t *p_msg);
 
+/**
+ * @brief Wrapper for msg_send_with_policy.
+ *
+ * @param p_msg pointer to a sys message
+ * @param policy what happens when the destination queue is full
+ * @param timeout used by MSG_POLICY_BLOCK
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t sysmsg_send_with_policy(msg_t *p_msg, msg_policy_t policy, TickType_t timeout);
+
 /**
  * @brief Wrapper for sysmsg_send when used with SYS_MSG_HEADER_INIT.
  *
@@ -67,6 +90,8 @@ BaseType_t sysmsg_unicast(msg_t *p_msg);
 
 /**
  * @brief Allocates message from buffer pool and sends it using sysmsg_send.
+ * With CONFIG_SYS_MSG_INLINE the message is sent inline instead (see
+ * msg_send_inline) and nothing is allocated.
  *
  * @param tx_id source of message
  * @param rx_id destination of message
@@ -76,9 +101,38 @@ BaseType_t sysmsg_unicast(msg_t *p_msg);
  */
 BaseType_t sysmsg_create_and_send(mid_t tx_id, mid_t rx_id, msg_code_t code);
 
+/**
+ * @brief Allocates message from buffer pool, sets the header options and
+ * sends it using sysmsg_send.
+ * Inline is used when the only option is MSG_OPTION_URGENT.
+ *
+ * @param tx_id source of message
+ * @param rx_id destination of message
+ * @param code message type
+ * @param options msg_option flags (for example MSG_OPTION_URGENT)
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t sysmsg_create_and_send_with_options(mid_t tx_id, mid_t rx_id, msg_code_t code, uint8_t options);
+
+#ifdef CONFIG_SYS_MSG_TTL
+/**
+ * @brief Allocates message from buffer pool, sets its time to live (see
+ * msg_set_ttl) and sends it using sysmsg_send. It is never sent inline.
+ *
+ * @param tx_id source of message
+ * @param rx_id destination of message
+ * @param code message type
+ * @param ttl_ms time to live
+ *
+ * @retval SYS_SUCCESS or SYS_ERROR
+ */
+BaseType_t sysmsg_create_and_send_ttl(mid_t tx_id, mid_t rx_id, msg_code_t code, uint32_t ttl_ms);
+#endif
+
 /**
  * @brief Shorter form of sysmsg_create_and_send that can be used by a task to
- * send a message to itself.
+ * send a message to itself. Inline like sysmsg_create_and_send.
  *
  * @param id source and destination of message
  * @param code message type
@@ -89,7 +143,7 @@ BaseType_t sysmsg_create_and_sendto_self(mid_t id, msg_code_t code);
 
 /**
  * @brief Allocates message from buffer pool and sends it using
- * sysmsg_unicast.
+ * sysmsg_unicast. Inline like sysmsg_create_and_send.
  *
  * @param tx_dd source of message
  * @param code message type
@@ -100,7 +154,7 @@ BaseType_t sysmsg_unicast_create_and_send(mid_t tx_id, msg_code_t code);
 
 /**
  * @brief Allocates message from buffer pool and broadcasts it using
- * sysmsg_broadcast.
+ * sysmsg_broadcast. Inline like sysmsg_create_and_send.
  *
  * @param tx_id source of message
  * @param code message type
@@ -115,6 +169,10 @@ BaseType_t sysmsg_create_and_broadcast(mid_t tx_id, msg_code_t code);
  *
  * @note Often used with DISPATCH_DO_NOT_FREE.
  * @note The original sender must populate the tx_id.
+ * @note A shared (broadcast) message can't be used for a reply.
+ * @note A reply to an inline message is a new inline message.
+ * @note The reply to a call (sysmsg_call) keeps the sequence number of the
+ * request and is delivered to the caller's future or reply callback.
  *
  * @param p_msg pointer to a sys message
  * @param code message type
@@ -140,8 +198,12 @@ BaseType_t sysmsg_cb_create_and_send(mid_t tx_id, mid_t rx_id, msg_code_t code,
 
 /**
  * @brief Sends a targeted sys message to a specific target or if no
- * target is provided, the event filter (or broadcast if event filter is not
- * enabled)
+ * target is provided, publishes it (or broadcasts it if CONFIG_SYS_MSG_TOPIC
+ * isn't enabled)
+ *
+ * @note A message that is published must be an event_msg_t (see msg_publish).
+ * Published events go through the event filter task if
+ * CONFIG_SYS_MSG_EVENT_FILTER is enabled.
  *
  * @param p_msg pointer to a sys message
  * @param target_id pointer to target if sending a targeted message, NULL
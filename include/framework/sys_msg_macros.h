@@ -27,6 +27,12 @@ extern "C" {
 
 #define SYSMSG_TRY_TO_SEND(pMacroMsg) sysmsg_try_to_send((msg_t *)pMacroMsg)
 
+#define SYSMSG_SEND_DROP_OLDEST(pMacroMsg)                                     \
+  sysmsg_send_with_policy((msg_t *)pMacroMsg, MSG_POLICY_DROP_OLDEST, K_NO_WAIT)
+
+#define SYSMSG_SEND_REPLACE(pMacroMsg)                                         \
+  sysmsg_send_with_policy((msg_t *)pMacroMsg, MSG_POLICY_REPLACE, K_NO_WAIT)
+
 #define SYSMSG_SEND_TO(destId, pMacroMsg)                                      \
   sysmsg_sendto((msg_t *)pMacroMsg, destId)
 
@@ -38,6 +44,12 @@ extern "C" {
 #define SYSMSG_CREATE_AND_SEND(txId, rxId, code)                               \
   sysmsg_create_and_send(txId, rxId, code)
 
+#define SYSMSG_CREATE_AND_SEND_URGENT(txId, rxId, code)                        \
+  sysmsg_create_and_send_with_options(txId, rxId, code, MSG_OPTION_URGENT)
+
+#define SYSMSG_CREATE_AND_SEND_TTL(txId, rxId, code, ttlMs)                    \
+  sysmsg_create_and_send_ttl(txId, rxId, code, ttlMs)
+
 #define SYSMSG_CREATE_AND_BROADCAST(id, code)                                  \
   sysmsg_create_and_broadcast(id, code)
 
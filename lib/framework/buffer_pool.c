@@ -15,64 +15,145 @@ struct bph {
 #endif
   uint16_t size;
   uint8_t pool;
-  uint8_t reserved;
+  uint8_t refs; /* references held in addition to the owner */
+#ifdef CONFIG_SYS_MSG_FIFO
+#ifdef CONFIG_64BIT
+  uint32_t reserved;
+#endif
+  /* Used by the kernel while a message is queued, must be last (see MSG_QUEUE_LINK) */
+  void *link;
+#endif
 } __packed;
 
 #define BPH_SIZE sizeof(struct bph)
 
+#ifdef CONFIG_SYS_MSG_FIFO
+BUILD_ASSERT(BPH_SIZE % sizeof(void *) == 0, "Message queue link isn't aligned");
+#endif
+
+#ifdef CONFIG_BUFFER_POOL_SLAB
+/* A slab size class. Blocks are found by address when they are freed. */
+struct slab_class {
+  struct k_mem_slab *p_slab;
+  uint8_t *p_buffer;
+  uint32_t count;
+};
+
+#define SLAB_ALIGNMENT sizeof(void *)
+
+#define SLAB_CLASS_DEFINE(_size)                                                                                       \
+  static uint8_t __aligned(SLAB_ALIGNMENT) slab_buffer_##_size[CONFIG_BUFFER_POOL_SLAB_##_size##_COUNT * (_size)];     \
+  static struct k_mem_slab slab_##_size
+
+#define SLAB_CLASS(_size)                                                                                              \
+  { .p_slab = &slab_##_size, .p_buffer = slab_buffer_##_size, .count = CONFIG_BUFFER_POOL_SLAB_##_size##_COUNT }
+
+#define SLAB_CLASS_BYTES(_size) (CONFIG_BUFFER_POOL_SLAB_##_size##_COUNT * (_size))
+
+#define BUFFER_POOL_CAPACITY                                                                                           \
+  (CONFIG_BUFFER_POOL_SIZE + SLAB_CLASS_BYTES(8) + SLAB_CLASS_BYTES(16) + SLAB_CLASS_BYTES(32) +                       \
+   SLAB_CLASS_BYTES(64) + SLAB_CLASS_BYTES(128))
+#else
+#define BUFFER_POOL_CAPACITY CONFIG_BUFFER_POOL_SIZE
+#endif
+
 /**************************************************************/
 /* Local Data Definitions                                     */
 /**************************************************************/
-static K_HEAP_DEFINE(buffer_pool, CONFIG_BUFFER_POOL_SIZE);
+static K_HEAP_DEFINE(default_heap, CONFIG_BUFFER_POOL_SIZE);
+
+static struct buffer_pool default_pool = {
+    .id = BP_POOL_DEFAULT,
+    .p_name = "default",
+    .p_heap = &default_heap,
+    .size = BUFFER_POOL_CAPACITY,
+};
+
+/* Indexed by pool id, the others are set when the pool is initialized */
+static struct buffer_pool *pools[CONFIG_BUFFER_POOL_COUNT] = {&default_pool};
+
+#ifdef CONFIG_BUFFER_POOL_SLAB
+SLAB_CLASS_DEFINE(8);
+SLAB_CLASS_DEFINE(16);
+SLAB_CLASS_DEFINE(32);
+SLAB_CLASS_DEFINE(64);
+SLAB_CLASS_DEFINE(128);
+
+static const struct slab_class slab_classes[BP_SLAB_CLASSES] = {
+    SLAB_CLASS(8), SLAB_CLASS(16), SLAB_CLASS(32), SLAB_CLASS(64), SLAB_CLASS(128),
+};
+
+static atomic_t slabs_initialized = ATOMIC_INIT(0);
+#endif
 
 static atomic_t take_failed = ATOMIC_INIT(0);
 
-#ifdef CONFIG_BUFFER_POOL_STATS
-static struct bp_stats bps;
-#endif
-
 /**************************************************************/
 /* Local Function Prototypes                                  */
 /**************************************************************/
 #ifdef CONFIG_BUFFER_POOL_STATS
-static void take_stat_handler(struct bph *p_bph, size_t size);
-static void take_fail_stat_handler(size_t size);
-static void give_stat_handler(struct bph *p_bph);
+static void init_stats(struct buffer_pool *p_pool);
+static void take_stat_handler(struct buffer_pool *p_pool, struct bph *p_bph, size_t size);
+static void take_fail_stat_handler(struct buffer_pool *p_pool, size_t size);
+static void give_stat_handler(struct buffer_pool *p_pool, struct bph *p_bph);
 #endif
 
+static struct buffer_pool *pool_get(uint8_t index);
+static uint8_t *take_buffer(uint8_t pool, size_t size, k_timeout_t timeout, const char *const context);
+static void assert_take_failed(void);
+static bool release_ref(struct buffer_pool *p_pool, struct bph *p_bph);
+static uint8_t *pool_alloc(struct buffer_pool *p_pool, size_t size_with_header, k_timeout_t timeout);
+static void pool_free(struct buffer_pool *p_pool, uint8_t *p);
+
 /**************************************************************/
 /* Global Function Definitions                                */
 /**************************************************************/
 void buffer_pool_init(void) {
-#ifdef CONFIG_BUFFER_POOL_STATS
-  if (!bps.initialized) {
-    bps.initialized = true;
-    bps.space_available = CONFIG_BUFFER_POOL_SIZE;
-    bps.min_space_available = CONFIG_BUFFER_POOL_SIZE;
-    bps.min_size = CONFIG_BUFFER_POOL_SIZE;
+#ifdef CONFIG_BUFFER_POOL_SLAB
+  /* Until the slabs are initialized, buffers are taken from the heap. */
+  if (atomic_cas(&slabs_initialized, 0, 1)) {
+    for (size_t i = 0; i < BP_SLAB_CLASSES; i++) {
+      if (slab_classes[i].count != 0) {
+        k_mem_slab_init(slab_classes[i].p_slab, slab_classes[i].p_buffer, BP_SLAB_BLOCK_SIZE(i),
+                        slab_classes[i].count);
+      }
+    }
   }
 #endif
+#ifdef CONFIG_BUFFER_POOL_STATS
+  init_stats(&default_pool);
+#endif
+
+  STRUCT_SECTION_FOREACH(buffer_pool, p_pool) {
+    if (p_pool->id >= CONFIG_BUFFER_POOL_COUNT || p_pool->id == BP_POOL_DEFAULT) {
+      LOG_ERR("Invalid buffer pool id %u", p_pool->id);
+      SYSCORE_ASSERT(FORCED);
+      continue;
+    }
+    if (pools[p_pool->id] != NULL && pools[p_pool->id] != p_pool) {
+      LOG_ERR("Duplicate buffer pool id %u", p_pool->id);
+      SYSCORE_ASSERT(FORCED);
+      continue;
+    }
+#ifdef CONFIG_BUFFER_POOL_STATS
+    init_stats(p_pool);
+#endif
+    pools[p_pool->id] = p_pool;
+  }
 }
 
 void *buffer_pool_try_to_take_timeout(size_t size, k_timeout_t timeout,
                                       const char *const context) {
-  size_t size_with_header = size + BPH_SIZE;
-  uint8_t *p = k_heap_alloc(&buffer_pool, size_with_header, timeout);
+  return buffer_pool_try_to_take_from(BP_POOL_DEFAULT, size, timeout, context);
+}
+
+void *buffer_pool_try_to_take_from(uint8_t pool, size_t size, k_timeout_t timeout, const char *const context) {
+  uint8_t *p = take_buffer(pool, size, timeout, context);
 
   if (p != NULL) {
-    memset(p, 0, size_with_header);
-#ifdef CONFIG_BUFFER_POOL_STATS
-    take_stat_handler((struct bph *)p, size);
-#endif
-    return p + BPH_SIZE;
-  } else {
-    /* A timeout can occur even when there is space available. */
-    LOG_WRN("Allocate failure size: %d context: %s", size, context);
-#ifdef CONFIG_BUFFER_POOL_STATS
-    take_fail_stat_handler(size);
-#endif
-    return p;
+    memset(p, 0, size);
   }
+  return p;
 }
 
 void *buffer_pool_try_to_take(size_t size, const char *const context) {
@@ -83,12 +164,20 @@ void *buffer_pool_take(size_t size) {
   void *ptr = buffer_pool_try_to_take(size, BP_CONTEXT_UNUSED);
 
   if (ptr == NULL) {
-    /* Prevent recursive entry */
-    if (atomic_get(&take_failed) == 0) {
-      atomic_set(&take_failed, 1);
-      LOG_ERR("Buffer pool too small");
-      SYSCORE_ASSERT(FORCED);
-    }
+    assert_take_failed();
+  }
+  return ptr;
+}
+
+void *buffer_pool_take_uninit(size_t size) {
+  return buffer_pool_take_uninit_from(BP_POOL_DEFAULT, size);
+}
+
+void *buffer_pool_take_uninit_from(uint8_t pool, size_t size) {
+  void *ptr = take_buffer(pool, size, K_NO_WAIT, BP_CONTEXT_UNUSED);
+
+  if (ptr == NULL) {
+    assert_take_failed();
   }
   return ptr;
 }
@@ -103,21 +192,84 @@ void buffer_pool_free(void *p_buffer) {
 
   p -= BPH_SIZE;
 
+  struct buffer_pool *p_pool = pool_get(((struct bph *)p)->pool);
+  if (p_pool == NULL) {
+    LOG_ERR("Attempt to free buffer of unknown pool");
+    return;
+  }
+
+  if (!release_ref(p_pool, (struct bph *)p)) {
+    return;
+  }
+
 #ifdef CONFIG_BUFFER_POOL_STATS
-  give_stat_handler((struct bph *)p);
+  give_stat_handler(p_pool, (struct bph *)p);
 #endif
 
-  k_heap_free(&buffer_pool, p);
+  pool_free(p_pool, p);
+}
+
+void buffer_pool_add_ref(void *p_buffer, uint8_t count) {
+  uint8_t *p = p_buffer;
+
+  if (p == NULL) {
+    LOG_ERR("Attempt to reference NULL buffer");
+    return;
+  }
+
+  struct bph *p_bph = (struct bph *)(p - BPH_SIZE);
+  struct buffer_pool *p_pool = pool_get(p_bph->pool);
+  if (p_pool == NULL) {
+    LOG_ERR("Attempt to reference buffer of unknown pool");
+    return;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&p_pool->p_heap->lock);
+  SYSCORE_ASSERT(p_bph->refs <= (UINT8_MAX - count));
+  p_bph->refs += count;
+  k_spin_unlock(&p_pool->p_heap->lock, key);
+}
+
+size_t buffer_pool_size(const void *p_buffer) {
+  const uint8_t *p = p_buffer;
+
+  if (p == NULL) {
+    return 0;
+  }
+  return ((const struct bph *)(p - BPH_SIZE))->size;
+}
+
+uint8_t buffer_pool_index(const void *p_buffer) {
+  const uint8_t *p = p_buffer;
+
+  if (p == NULL) {
+    return BP_POOL_DEFAULT;
+  }
+  return ((const struct bph *)(p - BPH_SIZE))->pool;
 }
 
 int buffer_pool_get_stats(uint8_t index, struct bp_stats *stats) {
 #ifdef CONFIG_BUFFER_POOL_STATS
-  if (index == 0 && stats != NULL) {
-    k_spinlock_key_t key = k_spin_lock(&buffer_pool.lock);
-    memcpy(stats, &bps, sizeof(struct bp_stats));
-    k_spin_unlock(&buffer_pool.lock, key);
+  struct buffer_pool *p_pool = pool_get(index);
+
+  if (p_pool != NULL && stats != NULL) {
+    k_spinlock_key_t key = k_spin_lock(&p_pool->p_heap->lock);
+    memcpy(stats, &p_pool->stats, sizeof(struct bp_stats));
+    k_spin_unlock(&p_pool->p_heap->lock, key);
+    stats->name = p_pool->p_name;
+#ifdef CONFIG_BUFFER_POOL_SLAB
+    /* The slabs belong to the default pool */
+    for (size_t i = 0; i < BP_SLAB_CLASSES; i++) {
+      bool ready = p_pool == &default_pool && atomic_get(&slabs_initialized) != 0 && slab_classes[i].count != 0;
+      stats->slab_used[i] = ready ? k_mem_slab_num_used_get(slab_classes[i].p_slab) : 0;
+      stats->slab_free[i] = ready ? k_mem_slab_num_free_get(slab_classes[i].p_slab) : 0;
+    }
+#endif
     return 0;
   }
+#else
+  ARG_UNUSED(index);
+  ARG_UNUSED(stats);
 #endif
 
   return -EINVAL;
@@ -126,46 +278,186 @@ int buffer_pool_get_stats(uint8_t index, struct bp_stats *stats) {
 /**************************************************************/
 /* Local Function Definitions                                 */
 /**************************************************************/
+/**
+ * @brief Get a pool by index.
+ *
+ * @retval NULL if the pool isn't defined
+ */
+static struct buffer_pool *pool_get(uint8_t index) {
+  if (index >= CONFIG_BUFFER_POOL_COUNT) {
+    return NULL;
+  }
+  return pools[index];
+}
+
+/**
+ * @brief Allocate a buffer from a pool and initialize its header.
+ * The buffer itself isn't initialized.
+ *
+ * @retval pointer to the buffer (after the header) or NULL
+ */
+static uint8_t *take_buffer(uint8_t pool, size_t size, k_timeout_t timeout, const char *const context) {
+  struct buffer_pool *p_pool = pool_get(pool);
+  uint8_t *p = NULL;
+
+  if (p_pool == NULL) {
+    LOG_ERR("Buffer pool %u isn't defined context: %s", pool, context);
+    return NULL;
+  }
+
+  p = pool_alloc(p_pool, size + BPH_SIZE, timeout);
+  if (p != NULL) {
+    memset(p, 0, BPH_SIZE);
+    ((struct bph *)p)->size = size;
+    ((struct bph *)p)->pool = pool;
+#ifdef CONFIG_BUFFER_POOL_STATS
+    take_stat_handler(p_pool, (struct bph *)p, size);
+#endif
+    return p + BPH_SIZE;
+  } else {
+    /* A timeout can occur even when there is space available. */
+    LOG_WRN("Allocate failure pool: %s size: %d context: %s", p_pool->p_name, size, context);
+#ifdef CONFIG_BUFFER_POOL_STATS
+    take_fail_stat_handler(p_pool, size);
+#endif
+    return p;
+  }
+}
+
+static void assert_take_failed(void) {
+  /* Prevent recursive entry */
+  if (atomic_get(&take_failed) == 0) {
+    atomic_set(&take_failed, 1);
+    LOG_ERR("Buffer pool too small");
+    SYSCORE_ASSERT(FORCED);
+  }
+}
+
+/**
+ * @brief Drop one reference to a buffer.
+ *
+ * @retval true if the caller held the last reference and must free the buffer.
+ */
+static bool release_ref(struct buffer_pool *p_pool, struct bph *p_bph) {
+  bool last = true;
+
+  /* A buffer without extra references has a single owner,
+   * so the count can't change while it is read here. */
+  if (p_bph->refs != 0) {
+    k_spinlock_key_t key = k_spin_lock(&p_pool->p_heap->lock);
+    if (p_bph->refs != 0) {
+      p_bph->refs -= 1;
+      last = false;
+    }
+    k_spin_unlock(&p_pool->p_heap->lock, key);
+  }
+
+  return last;
+}
+
+/**
+ * @brief Allocate a block for a buffer and its header.
+ *
+ * With the slab backend a block of the default pool is taken from the
+ * smallest class that fits it without waiting. A block that doesn't fit a
+ * class, or whose class is empty, is allocated from the heap (which waits up
+ * to timeout). The other pools only have a heap.
+ */
+static uint8_t *pool_alloc(struct buffer_pool *p_pool, size_t size_with_header, k_timeout_t timeout) {
+#ifdef CONFIG_BUFFER_POOL_SLAB
+  for (size_t i = 0; i < BP_SLAB_CLASSES && p_pool == &default_pool; i++) {
+    if (size_with_header <= BP_SLAB_BLOCK_SIZE(i) && slab_classes[i].count != 0) {
+      void *p_block;
+      if (atomic_get(&slabs_initialized) != 0 &&
+          k_mem_slab_alloc(slab_classes[i].p_slab, &p_block, K_NO_WAIT) == 0) {
+        return p_block;
+      }
+#ifdef CONFIG_BUFFER_POOL_STATS
+      k_spinlock_key_t key = k_spin_lock(&default_heap.lock);
+      default_pool.stats.heap_fallbacks += 1;
+      k_spin_unlock(&default_heap.lock, key);
+#endif
+      break;
+    }
+  }
+#endif
+
+  return k_heap_alloc(p_pool->p_heap, size_with_header, timeout);
+}
+
+/**
+ * @brief Return a block to the slab class that contains it or to the heap.
+ */
+static void pool_free(struct buffer_pool *p_pool, uint8_t *p) {
+#ifdef CONFIG_BUFFER_POOL_SLAB
+  for (size_t i = 0; i < BP_SLAB_CLASSES && p_pool == &default_pool; i++) {
+    const struct slab_class *p_class = &slab_classes[i];
+    if (p >= p_class->p_buffer && p < (p_class->p_buffer + (p_class->count * BP_SLAB_BLOCK_SIZE(i)))) {
+      k_mem_slab_free(p_class->p_slab, p);
+      return;
+    }
+  }
+#endif
+
+  k_heap_free(p_pool->p_heap, p);
+}
+
 #ifdef CONFIG_BUFFER_POOL_STATS
 
-static void take_stat_handler(struct bph *bph, size_t size) {
-  k_spinlock_key_t key = k_spin_lock(&buffer_pool.lock);
+static void init_stats(struct buffer_pool *p_pool) {
+  struct bp_stats *p_stats = &p_pool->stats;
+
+  if (!p_stats->initialized) {
+    p_stats->initialized = true;
+    p_stats->space_available = p_pool->size;
+    p_stats->min_space_available = p_pool->size;
+    p_stats->min_size = p_pool->size;
+  }
+}
+
+static void take_stat_handler(struct buffer_pool *p_pool, struct bph *bph, size_t size) {
+  struct bp_stats *p_stats = &p_pool->stats;
+  k_spinlock_key_t key = k_spin_lock(&p_pool->p_heap->lock);
 
-  bph->size = size;
 #ifdef CONFIG_BUFFER_POOL_CHECK_DOUBLE_FREE
   bph->ptr = bph;
+#else
+  ARG_UNUSED(bph);
 #endif
 
-  bps.space_available -= size;
-  bps.min_space_available = MIN(bps.min_space_available, bps.space_available);
-  bps.min_size = MIN(bps.min_size, size);
-  bps.max_size = MAX(bps.max_size, size);
-  bps.allocs += 1;
-  bps.cur_allocs += 1;
-  bps.max_allocs = MAX(bps.max_allocs, bps.cur_allocs);
+  /* The stats are ints, so the size is converted before it is compared. */
+  p_stats->space_available -= (int)size;
+  p_stats->min_space_available = MIN(p_stats->min_space_available, p_stats->space_available);
+  p_stats->min_size = MIN(p_stats->min_size, (int)size);
+  p_stats->max_size = MAX(p_stats->max_size, (int)size);
+  p_stats->allocs += 1;
+  p_stats->cur_allocs += 1;
+  p_stats->max_allocs = MAX(p_stats->max_allocs, p_stats->cur_allocs);
 #if CONFIG_BUFFER_POOL_WINDOW_SIZE > 0
-  bps.window[bps.windex++] = size;
-  if (bps.windex >= CONFIG_BUFFER_POOL_WINDOW_SIZE) {
-    bps.windex = 0;
+  p_stats->window[p_stats->windex++] = size;
+  if (p_stats->windex >= CONFIG_BUFFER_POOL_WINDOW_SIZE) {
+    p_stats->windex = 0;
   }
 #endif
 
-  k_spin_unlock(&buffer_pool.lock, key);
+  k_spin_unlock(&p_pool->p_heap->lock, key);
 }
 
-static void take_fail_stat_handler(size_t size) {
-  k_spinlock_key_t key = k_spin_lock(&buffer_pool.lock);
+static void take_fail_stat_handler(struct buffer_pool *p_pool, size_t size) {
+  struct bp_stats *p_stats = &p_pool->stats;
+  k_spinlock_key_t key = k_spin_lock(&p_pool->p_heap->lock);
 
-  bps.take_failures += 1;
-  bps.last_fail_size = size;
-  bps.min_space_available =
-      MIN(bps.min_space_available, (bps.space_available - size));
+  p_stats->take_failures += 1;
+  p_stats->last_fail_size = size;
+  p_stats->min_space_available =
+      MIN(p_stats->min_space_available, (p_stats->space_available - (int)size));
 
-  k_spin_unlock(&buffer_pool.lock, key);
+  k_spin_unlock(&p_pool->p_heap->lock, key);
 }
 
-static void give_stat_handler(struct bph *bph) {
-  k_spinlock_key_t key = k_spin_lock(&buffer_pool.lock);
+static void give_stat_handler(struct buffer_pool *p_pool, struct bph *bph) {
+  struct bp_stats *p_stats = &p_pool->stats;
+  k_spinlock_key_t key = k_spin_lock(&p_pool->p_heap->lock);
 
 #ifdef CONFIG_BUFFER_POOL_CHECK_DOUBLE_FREE
   if (bph->ptr == 0) {
@@ -182,10 +474,10 @@ static void give_stat_handler(struct bph *bph) {
   }
 #endif
 
-  bps.space_available += bph->size;
-  bps.cur_allocs -= 1;
+  p_stats->space_available += bph->size;
+  p_stats->cur_allocs -= 1;
 
-  k_spin_unlock(&buffer_pool.lock, key);
+  k_spin_unlock(&p_pool->p_heap->lock, key);
 }
 
 #endif /* CONFIG_BUFFER_POOL_STATS */
@@ -18,12 +18,13 @@
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
 static int bp_stats(const struct shell *shell, size_t argc, char **argv);
+static void bp_print_stats(const struct shell *shell, uint8_t index, const struct bp_stats *p_stats);
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
 SHELL_STATIC_SUBCMD_SET_CREATE(sub_bp,
-                               SHELL_CMD(stats, NULL, "Print buffer pool stats",
+                               SHELL_CMD(stats, NULL, "Print stats of each buffer pool",
                                          bp_stats),
                                SHELL_SUBCMD_SET_END);
 
@@ -36,34 +37,49 @@ static int bp_stats(const struct shell *shell, size_t argc, char **argv) {
   ARG_UNUSED(argc);
   ARG_UNUSED(argv);
 
-  const uint8_t POOL_INDEX = 0;
   struct bp_stats stats;
   int r;
 
-  r = buffer_pool_get_stats(POOL_INDEX, &stats);
-  if (r == 0) {
-    shell_print(shell, "Buffer Pool %u", POOL_INDEX);
-    shell_print(shell, "stats initialized     %u", stats.initialized);
-    shell_print(shell, "space available       %d", stats.space_available);
-    shell_print(shell, "min space available   %d", stats.min_space_available);
-    shell_print(shell, "min alloced size      %d", stats.min_size);
-    shell_print(shell, "max alloced size      %d", stats.max_size);
-    shell_print(shell, "total allocs          %d", stats.allocs);
-    shell_print(shell, "current allocations   %d", stats.cur_allocs);
-    shell_print(shell, "max allocations       %d", stats.max_allocs);
-    shell_print(shell, "take failures         %d", stats.take_failures);
-    shell_print(shell, "last fail size        %d", stats.last_fail_size);
+  for (uint8_t index = 0; index < CONFIG_BUFFER_POOL_COUNT; index++) {
+    r = buffer_pool_get_stats(index, &stats);
+    if (r == 0) {
+      bp_print_stats(shell, index, &stats);
+    } else if (index == BP_POOL_DEFAULT) {
+      shell_error(shell, "Buffer pool stats not available: %d", r);
+    }
+  }
+  return 0;
+}
 
-#if CONFIG_BUFFER_POOL_WINDOW_SIZE > 0
-    shell_print(shell, "List of recently allocated sizes:");
-    size_t i;
-    for (i = 0; i < CONFIG_BUFFER_POOL_WINDOW_SIZE - 1; i++) {
-      shell_fprintf(shell, SHELL_NORMAL, "%u, ", stats.window[i]);
+static void bp_print_stats(const struct shell *shell, uint8_t index, const struct bp_stats *p_stats) {
+  shell_print(shell, "Buffer Pool %u (%s)", index, p_stats->name);
+  shell_print(shell, "stats initialized     %u", p_stats->initialized);
+  shell_print(shell, "space available       %d", p_stats->space_available);
+  shell_print(shell, "min space available   %d", p_stats->min_space_available);
+  shell_print(shell, "min alloced size      %d", p_stats->min_size);
+  shell_print(shell, "max alloced size      %d", p_stats->max_size);
+  shell_print(shell, "total allocs          %d", p_stats->allocs);
+  shell_print(shell, "current allocations   %d", p_stats->cur_allocs);
+  shell_print(shell, "max allocations       %d", p_stats->max_allocs);
+  shell_print(shell, "take failures         %d", p_stats->take_failures);
+  shell_print(shell, "last fail size        %d", p_stats->last_fail_size);
+#ifdef CONFIG_BUFFER_POOL_SLAB
+  /* The slabs belong to the default pool */
+  if (index == BP_POOL_DEFAULT) {
+    shell_print(shell, "heap fallbacks        %d", p_stats->heap_fallbacks);
+    for (size_t i = 0; i < BP_SLAB_CLASSES; i++) {
+      shell_print(shell, "slab %3u used/free    %d/%d", BP_SLAB_BLOCK_SIZE(i), p_stats->slab_used[i],
+                  p_stats->slab_free[i]);
     }
-    shell_fprintf(shell, SHELL_NORMAL, "%u\n", stats.window[i]);
+  }
 #endif
-  } else {
-    shell_error(shell, "Buffer pool stats not available: %d", r);
+
+#if CONFIG_BUFFER_POOL_WINDOW_SIZE > 0
+  shell_print(shell, "List of recently allocated sizes:");
+  size_t i;
+  for (i = 0; i < CONFIG_BUFFER_POOL_WINDOW_SIZE - 1; i++) {
+    shell_fprintf(shell, SHELL_NORMAL, "%u, ", p_stats->window[i]);
   }
-  return 0;
+  shell_fprintf(shell, SHELL_NORMAL, "%u\n", p_stats->window[i]);
+#endif
 }
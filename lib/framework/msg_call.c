@@ -0,0 +1,245 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(msg_call, LOG_LEVEL_WRN);
+
+#include <framework/msg_call.h>
+#include <framework/sys_msg.h>
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+struct msg_call_entry {
+  uint16_t seq; /** 0 when the entry is free */
+  msg_future_t *p_future;
+  msg_reply_cb_t *reply_cb;
+  int64_t deadline; /** uptime (ms) when a callback call is given up */
+};
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+static struct msg_call_entry msg_calls[CONFIG_SYS_MSG_CALL_MAX_PENDING];
+static struct k_spinlock msg_call_lock;
+static atomic_t msg_call_seq;
+
+/**************************************************************/
+/* Local Function Prototypes                                  */
+/**************************************************************/
+static BaseType_t call_send(mid_t rx_id, msg_t *p_msg, msg_future_t *p_future, msg_reply_cb_t *reply_cb);
+static bool call_remove(uint16_t seq, struct msg_call_entry *p_entry);
+static bool call_entry_free(const struct msg_call_entry *p_entry, int64_t now);
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+BaseType_t sysmsg_call(mid_t rx_id, msg_t *p_msg, msg_t **pp_reply, TickType_t timeout) {
+  msg_future_t future;
+
+  if (pp_reply == NULL || sys_interrupt_context()) {
+    SYSCORE_ASSERT(FORCED);
+    msg_release(p_msg);
+    return SYS_ERROR;
+  }
+
+  if (sysmsg_call_async(rx_id, p_msg, &future) != SYS_SUCCESS) {
+    return SYS_ERROR;
+  }
+  return msg_future_wait(&future, pp_reply, timeout);
+}
+
+BaseType_t sysmsg_call_async(mid_t rx_id, msg_t *p_msg, msg_future_t *p_future) {
+  if (p_future == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    msg_release(p_msg);
+    return SYS_ERROR;
+  }
+
+  k_poll_signal_init(&p_future->signal);
+  p_future->p_reply = NULL;
+  return call_send(rx_id, p_msg, p_future, NULL);
+}
+
+BaseType_t sysmsg_call_cb(mid_t rx_id, msg_t *p_msg, msg_reply_cb_t *reply_cb) {
+  if (reply_cb == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    msg_release(p_msg);
+    return SYS_ERROR;
+  }
+
+  return call_send(rx_id, p_msg, NULL, reply_cb);
+}
+
+BaseType_t msg_future_wait(msg_future_t *p_future, msg_t **pp_reply, TickType_t timeout) {
+  if (p_future == NULL || pp_reply == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return SYS_ERROR;
+  }
+
+  struct k_poll_event event =
+      K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &p_future->signal);
+
+  /* The reply can arrive between the timeout and the cancel. */
+  if (k_poll(&event, 1, timeout) != 0 && msg_future_cancel(p_future)) {
+    LOG_WRN("No reply to call %u", p_future->seq);
+    *pp_reply = NULL;
+    return SYS_ERROR;
+  }
+
+  *pp_reply = p_future->p_reply;
+  return SYS_SUCCESS;
+}
+
+bool msg_future_cancel(msg_future_t *p_future) {
+  if (p_future == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return false;
+  }
+
+  return call_remove(p_future->seq, NULL);
+}
+
+bool msg_call_complete(msg_t *p_reply) {
+  struct msg_call_entry entry;
+  size_t i;
+
+  k_spinlock_key_t key = k_spin_lock(&msg_call_lock);
+  for (i = 0; i < ARRAY_SIZE(msg_calls); i++) {
+    if (msg_calls[i].seq == p_reply->header.seq) {
+      break;
+    }
+  }
+  if (i == ARRAY_SIZE(msg_calls)) {
+    k_spin_unlock(&msg_call_lock, key);
+    /* The caller gave up waiting. */
+    msg_release(p_reply);
+    return true;
+  }
+  entry = msg_calls[i];
+  if (entry.p_future != NULL) {
+    /* The reply is set and the signal raised before the entry is removed,
+     * so a caller whose cancel fails always finds the reply and the
+     * future isn't used after the caller returns. */
+    entry.p_future->p_reply = p_reply;
+    k_poll_signal_raise(&entry.p_future->signal, 0);
+    msg_calls[i].seq = 0;
+  }
+  k_spin_unlock(&msg_call_lock, key);
+
+  /* Otherwise queued to the caller and handled by msg_call_reply_handler. */
+  return entry.p_future != NULL;
+}
+
+void msg_call_drop(const msg_t *p_reply) {
+  if (p_reply == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return;
+  }
+
+  call_remove(p_reply->header.seq, NULL);
+}
+
+msg_reply_cb_t *msg_call_reply_handler(const msg_t *p_reply) {
+  struct msg_call_entry entry;
+
+  if (!call_remove(p_reply->header.seq, &entry)) {
+    return NULL;
+  }
+  return entry.reply_cb;
+}
+
+/**************************************************************/
+/* Local Function Definitions                                 */
+/**************************************************************/
+/**
+ * @brief Add a pending call, stamp its sequence number in the request and
+ * send the request.
+ */
+static BaseType_t call_send(mid_t rx_id, msg_t *p_msg, msg_future_t *p_future, msg_reply_cb_t *reply_cb) {
+  BaseType_t result = SYS_ERROR;
+  int64_t now = k_uptime_get();
+  uint16_t expired = 0;
+  uint16_t seq;
+  size_t i;
+
+  if (p_msg == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return result;
+  }
+
+  /* 0 marks a message that isn't a call. */
+  do {
+    seq = (uint16_t)atomic_inc(&msg_call_seq);
+  } while (seq == 0);
+
+  k_spinlock_key_t key = k_spin_lock(&msg_call_lock);
+  for (i = 0; i < ARRAY_SIZE(msg_calls); i++) {
+    if (call_entry_free(&msg_calls[i], now)) {
+      expired = msg_calls[i].seq;
+      msg_calls[i].seq = seq;
+      msg_calls[i].p_future = p_future;
+      msg_calls[i].reply_cb = reply_cb;
+      msg_calls[i].deadline = now + CONFIG_SYS_MSG_CALL_CB_TIMEOUT_MS;
+      break;
+    }
+  }
+  k_spin_unlock(&msg_call_lock, key);
+
+  if (expired != 0) {
+    LOG_WRN("No reply to call %u", expired);
+  }
+
+  if (i == ARRAY_SIZE(msg_calls)) {
+    LOG_ERR("Too many pending calls");
+    msg_release(p_msg);
+    return result;
+  }
+
+  if (p_future != NULL) {
+    p_future->seq = seq;
+  }
+  p_msg->header.seq = seq;
+  p_msg->header.options &= ~MSG_OPTION_REPLY;
+
+  /* A full queue fails with a negative errno and only fails the call. */
+  result = msg_send(rx_id, p_msg);
+  SYSMSG_ASSERT_ROUTED(result);
+  if (result != SYS_SUCCESS) {
+    call_remove(seq, NULL);
+    msg_release(p_msg);
+    result = SYS_ERROR;
+  }
+
+  return result;
+}
+
+/**
+ * @brief A callback call has no caller that cancels it, so it is given up
+ * when its reply didn't arrive before the deadline.
+ */
+static bool call_entry_free(const struct msg_call_entry *p_entry, int64_t now) {
+  return p_entry->seq == 0 || (p_entry->p_future == NULL && now >= p_entry->deadline);
+}
+
+/**
+ * @brief Remove a pending call.
+ *
+ * @retval true if the call was pending
+ */
+static bool call_remove(uint16_t seq, struct msg_call_entry *p_entry) {
+  bool found = false;
+  size_t i;
+
+  k_spinlock_key_t key = k_spin_lock(&msg_call_lock);
+  for (i = 0; i < ARRAY_SIZE(msg_calls); i++) {
+    if (seq != 0 && msg_calls[i].seq == seq) {
+      if (p_entry != NULL) {
+        *p_entry = msg_calls[i];
+      }
+      msg_calls[i].seq = 0;
+      found = true;
+      break;
+    }
+  }
+  k_spin_unlock(&msg_call_lock, key);
+
+  return found;
+}
@@ -0,0 +1,195 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(msg_isr, LOG_LEVEL_WRN);
+
+#include <framework/msg_isr.h>
+#include <framework/sys_msg.h>
+
+#ifdef CONFIG_SYS_MSG_TOPIC
+#include <framework/msg_topic.h>
+#endif
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+#define MSG_ISR_ENTRIES CONFIG_SYS_MSG_ISR_QUEUE_ENTRIES
+#define MSG_ISR_MASK (MSG_ISR_ENTRIES - 1)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(MSG_ISR_ENTRIES), "ISR queue entries must be a power of two");
+
+enum msg_isr_kind {
+  MSG_ISR_SEND,
+  MSG_ISR_UNICAST,
+  MSG_ISR_BROADCAST,
+  MSG_ISR_PUBLISH,
+};
+
+struct msg_isr_record {
+  msg_code_t msg_code; /* event type of MSG_ISR_PUBLISH */
+  mid_t tx_id;
+  mid_t rx_id;
+  uint8_t kind;
+  uint32_t data;
+};
+
+/* The sequence number of a slot is its position in the ring while it is free
+ * and the position + 1 when it holds a record (see msg_isr_push).
+ */
+struct msg_isr_slot {
+  atomic_t seq;
+  struct msg_isr_record record;
+};
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+static struct msg_isr_slot msg_isr_ring[MSG_ISR_ENTRIES];
+static atomic_t msg_isr_head;
+static uint32_t msg_isr_tail; /* only used by the work item */
+static atomic_t msg_isr_dropped;
+
+/**************************************************************/
+/* Local Function Prototypes                                  */
+/**************************************************************/
+static BaseType_t msg_isr_push(const struct msg_isr_record *p_record);
+static bool msg_isr_pop(struct msg_isr_record *p_record);
+static void msg_isr_work_handler(struct k_work *p_work);
+
+static K_WORK_DEFINE(msg_isr_work, msg_isr_work_handler);
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+BaseType_t msg_isr_send(mid_t tx_id, mid_t rx_id, msg_code_t code) {
+  struct msg_isr_record record = {.msg_code = code, .tx_id = tx_id, .rx_id = rx_id, .kind = MSG_ISR_SEND};
+
+  return msg_isr_push(&record);
+}
+
+BaseType_t msg_isr_unicast(mid_t tx_id, msg_code_t code) {
+  struct msg_isr_record record = {.msg_code = code, .tx_id = tx_id, .kind = MSG_ISR_UNICAST};
+
+  return msg_isr_push(&record);
+}
+
+BaseType_t msg_isr_broadcast(mid_t tx_id, msg_code_t code) {
+  struct msg_isr_record record = {.msg_code = code, .tx_id = tx_id, .kind = MSG_ISR_BROADCAST};
+
+  return msg_isr_push(&record);
+}
+
+#ifdef CONFIG_SYS_MSG_TOPIC
+BaseType_t msg_isr_publish(mid_t tx_id, event_type_t type, event_data_t data) {
+  struct msg_isr_record record = {.msg_code = type, .tx_id = tx_id, .kind = MSG_ISR_PUBLISH, .data = data.u32};
+
+  return msg_isr_push(&record);
+}
+#endif
+
+uint32_t msg_isr_drops(void) {
+  return (uint32_t)atomic_get(&msg_isr_dropped);
+}
+
+void msg_isr_init(void) {
+  uint32_t i;
+
+  for (i = 0; i < MSG_ISR_ENTRIES; i++) {
+    atomic_set(&msg_isr_ring[i].seq, i);
+  }
+}
+
+/**************************************************************/
+/* Local Function Definitions                                 */
+/**************************************************************/
+/**
+ * @brief Claim the slot at the head of the ring, fill it and publish it to
+ * the work item. Producers only contend for the head index, so an interrupt
+ * that preempts another producer doesn't wait for it.
+ */
+static BaseType_t msg_isr_push(const struct msg_isr_record *p_record) {
+  struct msg_isr_slot *p_slot;
+  atomic_val_t pos;
+  int32_t diff;
+
+  pos = atomic_get(&msg_isr_head);
+  for (;;) {
+    p_slot = &msg_isr_ring[pos & MSG_ISR_MASK];
+    /* Positions wrap, so they are compared as a difference. */
+    diff = (int32_t)((uint32_t)atomic_get(&p_slot->seq) - (uint32_t)pos);
+    if (diff == 0) {
+      if (atomic_cas(&msg_isr_head, pos, pos + 1)) {
+        break;
+      }
+      pos = atomic_get(&msg_isr_head);
+    } else if (diff < 0) {
+      /* The slot still holds the record of the previous lap. */
+      atomic_inc(&msg_isr_dropped);
+      return SYS_ERROR;
+    } else {
+      /* Another producer claimed the slot. */
+      pos = atomic_get(&msg_isr_head);
+    }
+  }
+
+  p_slot->record = *p_record;
+  atomic_set(&p_slot->seq, pos + 1);
+
+  k_work_submit(&msg_isr_work);
+  return SYS_SUCCESS;
+}
+
+/**
+ * @brief Take the record at the tail of the ring (work item only).
+ *
+ * @retval false if the ring is empty or the producer of the next record
+ * hasn't finished writing it
+ */
+static bool msg_isr_pop(struct msg_isr_record *p_record) {
+  struct msg_isr_slot *p_slot = &msg_isr_ring[msg_isr_tail & MSG_ISR_MASK];
+
+  if ((uint32_t)atomic_get(&p_slot->seq) != msg_isr_tail + 1) {
+    return false;
+  }
+
+  *p_record = p_slot->record;
+  atomic_set(&p_slot->seq, msg_isr_tail + MSG_ISR_ENTRIES);
+  msg_isr_tail++;
+  return true;
+}
+
+/**
+ * @brief Send the deferred messages in thread context.
+ * At most one ring of records is drained before the work item yields.
+ */
+static void msg_isr_work_handler(struct k_work *p_work) {
+  struct msg_isr_record record;
+  uint32_t count;
+
+  for (count = 0; count < MSG_ISR_ENTRIES && msg_isr_pop(&record); count++) {
+    switch (record.kind) {
+      case MSG_ISR_SEND:
+        sysmsg_create_and_send(record.tx_id, record.rx_id, record.msg_code);
+        break;
+      case MSG_ISR_UNICAST:
+        sysmsg_unicast_create_and_send(record.tx_id, record.msg_code);
+        break;
+      case MSG_ISR_BROADCAST:
+        sysmsg_create_and_broadcast(record.tx_id, record.msg_code);
+        break;
+#ifdef CONFIG_SYS_MSG_TOPIC
+      case MSG_ISR_PUBLISH:
+        if (sysmsg_publish(record.tx_id, (event_type_t)record.msg_code, (event_data_t)record.data) != SYS_SUCCESS) {
+          atomic_inc(&msg_isr_dropped);
+        }
+        break;
+#endif
+      default:
+        SYSCORE_ASSERT(FORCED);
+        break;
+    }
+  }
+
+  /* A record that is still being written is handled by the next submit. */
+  if (count == MSG_ISR_ENTRIES) {
+    k_work_submit(p_work);
+  }
+}
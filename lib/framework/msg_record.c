@@ -0,0 +1,245 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(msg_record, LOG_LEVEL_WRN);
+
+#include <string.h>
+
+#include <framework/buffer_pool.h>
+#include <framework/msg_record.h>
+#include <framework/sys_msg.h>
+
+#ifdef CONFIG_SYS_MSG_STATS
+#include <framework/msg_stats.h>
+#endif
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+#define RECORD_ENTRIES CONFIG_SYS_MSG_RECORD_ENTRIES
+#define RECORD_MAGIC 0x4d524543 /* "MREC" */
+
+BUILD_ASSERT(IS_POWER_OF_TWO(RECORD_ENTRIES), "Record ring size must be a power of two");
+
+/* Like the trace ring, the slot of a record is its index modulo the ring
+ * size. The magic tells whether a ring in noinit memory is valid.
+ */
+struct msg_record_ring {
+  uint32_t magic;
+  atomic_t head; /* total number of records written */
+  atomic_t tail; /* value of head when the ring was last cleared */
+  struct msg_record records[RECORD_ENTRIES];
+};
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+#ifdef CONFIG_SYS_MSG_RECORD_NOINIT
+static __noinit struct msg_record_ring record_ring;
+#else
+static struct msg_record_ring record_ring;
+#endif
+
+static atomic_t record_on;
+
+/**************************************************************/
+/* Local Function Prototypes                                  */
+/**************************************************************/
+static uint32_t record_time_us(void);
+static bool replay_send(const struct msg_record *p_record);
+static void replay_sample(struct msg_replay_report *p_report);
+static bool replay_drained(void);
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+void msg_record(mid_t rx_id, const msg_header_t *p_header, const void *p_payload, size_t size) {
+  if (!atomic_get(&record_on)) {
+    return;
+  }
+
+  atomic_val_t index = atomic_inc(&record_ring.head);
+  struct msg_record *p_record = &record_ring.records[index & (RECORD_ENTRIES - 1)];
+  size_t length = MIN(size, sizeof(p_record->payload));
+
+  p_record->time_us = record_time_us();
+  p_record->size = (uint16_t)MIN(size, UINT16_MAX);
+  p_record->rx_id = rx_id;
+  p_record->msg_code = p_header->msg_code;
+  p_record->tx_id = p_header->tx_id;
+  p_record->options = p_header->options;
+  if (length != 0) {
+    memcpy(p_record->payload, p_payload, length);
+  }
+  memset(&p_record->payload[length], 0, sizeof(p_record->payload) - length);
+}
+
+void msg_record_start(void) {
+  atomic_set(&record_on, 1);
+}
+
+void msg_record_stop(void) {
+  atomic_clear(&record_on);
+}
+
+size_t msg_record_snapshot(struct msg_record *p_records, size_t max_records, uint32_t *p_lost) {
+  if (p_records == NULL) {
+    return 0;
+  }
+
+  uint32_t head = atomic_get(&record_ring.head);
+  uint32_t tail = atomic_get(&record_ring.tail);
+  uint32_t count = MIN(head - tail, RECORD_ENTRIES);
+  uint32_t first;
+  size_t i;
+
+  count = MIN(count, max_records);
+  first = head - count;
+  for (i = 0; i < count; i++) {
+    memcpy(&p_records[i], &record_ring.records[(first + i) & (RECORD_ENTRIES - 1)], sizeof(struct msg_record));
+  }
+
+  if (p_lost != NULL) {
+    *p_lost = first - tail;
+  }
+  return count;
+}
+
+void msg_record_clear(void) {
+  atomic_set(&record_ring.tail, atomic_get(&record_ring.head));
+}
+
+int msg_replay(const struct msg_record *p_records, size_t count, uint32_t speed, uint32_t drain_ms,
+               struct msg_replay_report *p_report) {
+  if ((p_records == NULL && count != 0) || p_report == NULL) {
+    return -EINVAL;
+  }
+
+  /* The replayed messages aren't recorded. */
+  bool recording = atomic_clear(&record_on);
+  uint32_t start_us;
+  uint32_t offset_us;
+  uint32_t elapsed_us;
+  size_t i;
+
+  memset(p_report, 0, sizeof(*p_report));
+  p_report->min_space_available = UINT32_MAX;
+#ifdef CONFIG_SYS_MSG_STATS
+  msg_stats_reset();
+#endif
+
+  start_us = record_time_us();
+  for (i = 0; i < count; i++) {
+    if (speed != 0) {
+      /* Records of a previous boot can go back in time. */
+      offset_us = p_records[i].time_us - p_records[0].time_us;
+      offset_us = (offset_us > INT32_MAX) ? 0 : offset_us / speed;
+      elapsed_us = record_time_us() - start_us;
+      if (offset_us > elapsed_us) {
+        k_sleep(K_USEC(offset_us - elapsed_us));
+      }
+    }
+
+    if (replay_send(&p_records[i])) {
+      p_report->sent++;
+    } else {
+      p_report->failed++;
+    }
+    replay_sample(p_report);
+  }
+
+  while (!replay_drained() && (record_time_us() - start_us) < (drain_ms * USEC_PER_MSEC)) {
+    k_sleep(K_MSEC(1));
+  }
+  p_report->duration_us = record_time_us() - start_us;
+
+#ifdef CONFIG_SYS_MSG_STATS
+  struct msg_code_stats stats;
+  mid_t rx_id;
+  size_t index;
+
+  for (rx_id = MSG_ID_APP_START; rx_id < CONFIG_SYS_MAX_MSG_RECEIVES; rx_id++) {
+    for (index = 0; msg_stats_get(rx_id, index, &stats) == 0; index++) {
+      p_report->max_residency_us = MAX(p_report->max_residency_us, stats.max_residency_us);
+      p_report->max_handler_us = MAX(p_report->max_handler_us, stats.max_handler_us);
+    }
+  }
+#endif
+
+  if (recording) {
+    msg_record_start();
+  }
+  return 0;
+}
+
+void msg_record_init(void) {
+  bool kept = false;
+
+#ifdef CONFIG_SYS_MSG_RECORD_NOINIT
+  kept = (record_ring.magic == RECORD_MAGIC) &&
+         ((uint32_t)atomic_get(&record_ring.head) != (uint32_t)atomic_get(&record_ring.tail));
+#endif
+  if (!kept) {
+    memset(&record_ring, 0, sizeof(record_ring));
+    record_ring.magic = RECORD_MAGIC;
+  }
+
+  /* A stream kept through a reboot isn't overwritten until recording is
+   * started again. */
+  if (IS_ENABLED(CONFIG_SYS_MSG_RECORD_AT_BOOT) && !kept) {
+    msg_record_start();
+  }
+}
+
+/**************************************************************/
+/* Local Function Definitions                                 */
+/**************************************************************/
+static uint32_t record_time_us(void) {
+  return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/**
+ * @brief Send a recorded message as a new buffer pool message.
+ */
+static bool replay_send(const struct msg_record *p_record) {
+  msg_t *p_msg = (msg_t *)buffer_pool_try_to_take(sizeof(msg_header_t) + p_record->size, __func__);
+
+  if (p_msg == NULL) {
+    return false;
+  }
+
+  SYS_MSG_HEADER_INIT(p_msg, p_record->msg_code, p_record->tx_id);
+  p_msg->header.rx_id = p_record->rx_id;
+  p_msg->header.options = p_record->options & MSG_OPTION_URGENT;
+  memcpy((uint8_t *)p_msg + sizeof(msg_header_t), p_record->payload,
+         MIN(p_record->size, sizeof(p_record->payload)));
+
+  if (msg_send(p_record->rx_id, p_msg) != SYS_SUCCESS) {
+    msg_release(p_msg);
+    return false;
+  }
+  return true;
+}
+
+static void replay_sample(struct msg_replay_report *p_report) {
+  struct bp_stats stats;
+  mid_t rx_id;
+
+  for (rx_id = MSG_ID_APP_START; rx_id < CONFIG_SYS_MAX_MSG_RECEIVES; rx_id++) {
+    p_report->max_queued[rx_id] = MAX(p_report->max_queued[rx_id], msg_queue_count(rx_id));
+  }
+
+  if (buffer_pool_get_stats(BP_POOL_DEFAULT, &stats) == 0) {
+    p_report->max_allocs = MAX(p_report->max_allocs, (uint32_t)stats.cur_allocs);
+    p_report->min_space_available = MIN(p_report->min_space_available, (uint32_t)stats.space_available);
+  }
+}
+
+static bool replay_drained(void) {
+  mid_t rx_id;
+
+  for (rx_id = MSG_ID_APP_START; rx_id < CONFIG_SYS_MAX_MSG_RECEIVES; rx_id++) {
+    if (msg_queue_count(rx_id) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,611 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(msg_remote, LOG_LEVEL_WRN);
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include <framework/buffer_pool.h>
+#include <framework/msg_remote.h>
+#include <framework/sys_msg.h>
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+#define REMOTE_UART_NODE DT_CHOSEN(seedfic_msg_remote_uart)
+#define REMOTE_PROXIES CONFIG_SYS_MSG_REMOTE_PROXIES
+#define REMOTE_CREDITS CONFIG_SYS_MSG_REMOTE_CREDITS
+
+BUILD_ASSERT(DT_NODE_EXISTS(REMOTE_UART_NODE), "Choose the UART of the link with seedfic,msg-remote-uart");
+BUILD_ASSERT(CONFIG_SYS_MAX_MSG_RECEIVES <= 32, "Proxy mask is 32 bits");
+BUILD_ASSERT(sizeof(msg_code_t) == 1 && sizeof(mid_t) == 1, "Records hold 8 bit codes and ids");
+
+/* Frames are delimited by a flag byte. A flag or escape byte inside a frame
+ * is sent as the escape byte followed by the byte xor 0x20 (as in HDLC).
+ *
+ * Frame:  flags, seq, ack, count, records, CRC-16/CCITT (little endian)
+ * Record: rx_id, tx_id, msg_code, options, length, payload
+ *
+ * seq is the sequence number of a data frame (count > 0). A frame without
+ * records carries the sequence number of the next data frame. ack is the
+ * sequence number of the next data frame that the sender of the frame
+ * expects, so every frame returns the credits of the data frames that
+ * its sender has handled.
+ */
+#define FRAME_DELIMITER 0x7e
+#define FRAME_ESCAPE 0x7d
+#define FRAME_ESCAPE_XOR 0x20
+
+#define FRAME_HEADER_SIZE 4
+#define FRAME_CRC_SIZE 2
+#define RECORD_HEADER_SIZE 5
+#define FRAME_MAX_SIZE (FRAME_HEADER_SIZE + CONFIG_SYS_MSG_REMOTE_FRAME_SIZE + FRAME_CRC_SIZE)
+#define RECORD_MAX_PAYLOAD MIN(CONFIG_SYS_MSG_REMOTE_FRAME_SIZE - RECORD_HEADER_SIZE, UINT8_MAX)
+
+/* Every byte of a frame may be escaped */
+#define FRAME_MAX_WIRE_SIZE (2 * FRAME_MAX_SIZE + 2)
+#define FRAME_EMPTY_WIRE_SIZE (2 * (FRAME_HEADER_SIZE + FRAME_CRC_SIZE) + 2)
+
+/* The receive ring holds every data frame that the far side may send
+ * without waiting for credits, and a frame without records.
+ */
+#define RX_RING_SIZE (REMOTE_CREDITS * FRAME_MAX_WIRE_SIZE + FRAME_EMPTY_WIRE_SIZE)
+
+enum frame_flags {
+  FRAME_SYNC = BIT(0), /* the sequence of the sender restarts at seq (boot or lost credits) */
+};
+
+struct remote_proxy {
+  msg_recv_t rxer;
+  mid_t remote_id;
+};
+
+#define REMOTE_QUEUE_DEFINE(_i, _) MSG_QUEUE_DEFINE(msg_remote_queue_##_i, CONFIG_SYS_MSG_REMOTE_QUEUE_DEPTH)
+#define REMOTE_QUEUE(_i, _) &msg_remote_queue_##_i
+
+/**************************************************************/
+/* Local Function Prototypes                                  */
+/**************************************************************/
+static void remote_uart_isr(const struct device *p_dev, void *p_user_data);
+static void remote_rx_thread(void *p_arg1, void *p_arg2, void *p_arg3);
+static void remote_rx_byte(uint8_t byte);
+static void remote_rx_frame(const uint8_t *p_frame, size_t length);
+static void remote_rx_records(const uint8_t *p_records, size_t length, uint8_t count);
+static void remote_inject(const uint8_t *p_record);
+static void remote_tx_thread(void *p_arg1, void *p_arg2, void *p_arg3);
+static void remote_wait(void);
+static bool remote_pending(void);
+static void remote_take_credit(void);
+static void remote_send_data(void);
+static msg_t *remote_next_msg(struct remote_proxy **pp_proxy);
+static void remote_send_frame(uint8_t count, size_t length);
+static void remote_put_byte(uint8_t byte);
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+LISTIFY(REMOTE_PROXIES, REMOTE_QUEUE_DEFINE, (;));
+
+static msgq_t *const remote_queues[REMOTE_PROXIES] = {LISTIFY(REMOTE_PROXIES, REMOTE_QUEUE, (, ))};
+static struct remote_proxy remote_proxies[REMOTE_PROXIES];
+static atomic_t remote_proxy_count;
+static atomic_t remote_proxy_mask; /* local ids of the proxies */
+static K_MUTEX_DEFINE(remote_proxy_lock);
+
+static const struct device *const remote_uart = DEVICE_DT_GET(REMOTE_UART_NODE);
+
+RING_BUF_DECLARE(remote_rx_ring, RX_RING_SIZE);
+static K_SEM_DEFINE(remote_rx_sem, 0, 1);
+/* Wakes the transmit thread when credits or a frame to acknowledge arrive */
+static K_SEM_DEFINE(remote_tx_sem, 0, 1);
+
+/* Written by the receive thread */
+static atomic_t remote_peer_ack;    /* next data frame of ours that the far side expects */
+static atomic_t remote_rx_seq;      /* next data frame that we expect */
+static atomic_t remote_ack_pending; /* remote_rx_seq hasn't been sent yet */
+
+/* Receive thread */
+static uint8_t remote_rx_buffer[FRAME_MAX_SIZE];
+static size_t remote_rx_length;
+static bool remote_rx_escape;
+static bool remote_rx_overflow;
+
+/* Transmit thread */
+static uint8_t remote_tx_buffer[FRAME_MAX_SIZE];
+static uint8_t remote_tx_seq;
+static bool remote_tx_sync = true;
+static msg_t *p_remote_held; /* message that didn't fit in the previous frame */
+static struct remote_proxy *p_remote_held_proxy;
+static size_t remote_next_proxy;
+
+static struct {
+  atomic_t frames_sent;
+  atomic_t frames_received;
+  atomic_t msgs_sent;
+  atomic_t msgs_received;
+  atomic_t crc_errors;
+  atomic_t lost_frames;
+  atomic_t overruns;
+  atomic_t drops;
+  atomic_t credit_timeouts;
+} remote_stats;
+
+K_THREAD_DEFINE(msg_remote_rx, CONFIG_SYS_MSG_REMOTE_STACK_SIZE, remote_rx_thread, NULL, NULL, NULL,
+                CONFIG_SYS_MSG_REMOTE_PRIORITY, 0, 0);
+K_THREAD_DEFINE(msg_remote_tx, CONFIG_SYS_MSG_REMOTE_STACK_SIZE, remote_tx_thread, NULL, NULL, NULL,
+                CONFIG_SYS_MSG_REMOTE_PRIORITY, 0, 0);
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+int msg_remote_register(mid_t local_id, mid_t remote_id) {
+  if (local_id == MSG_ID_RESERVED || local_id >= CONFIG_SYS_MAX_MSG_RECEIVES || remote_id == MSG_ID_RESERVED) {
+    return -EINVAL;
+  }
+  if (msg_is_registered(local_id)) {
+    return -EINVAL;
+  }
+
+  k_mutex_lock(&remote_proxy_lock, K_FOREVER);
+  size_t index = atomic_get(&remote_proxy_count);
+  if (index >= REMOTE_PROXIES) {
+    k_mutex_unlock(&remote_proxy_lock);
+    return -ENOMEM;
+  }
+
+  struct remote_proxy *p_proxy = &remote_proxies[index];
+
+  p_proxy->remote_id = remote_id;
+  p_proxy->rxer.id = local_id;
+  p_proxy->rxer.p_queue = remote_queues[index];
+  p_proxy->rxer.rx_block_ticks = K_NO_WAIT;
+  msg_register_receiver(&p_proxy->rxer);
+  atomic_set_bit(&remote_proxy_mask, local_id);
+
+  /* The transmit thread only reads the proxies below the count. */
+  atomic_set(&remote_proxy_count, index + 1);
+  k_mutex_unlock(&remote_proxy_lock);
+
+  k_sem_give(&remote_tx_sem);
+  return 0;
+}
+
+bool msg_remote_is_proxy(mid_t rx_id) {
+  return (rx_id < CONFIG_SYS_MAX_MSG_RECEIVES) && atomic_test_bit(&remote_proxy_mask, rx_id);
+}
+
+mid_t msg_remote_id(mid_t rx_id) {
+  size_t count = atomic_get(&remote_proxy_count);
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    if (remote_proxies[i].rxer.id == rx_id) {
+      return remote_proxies[i].remote_id;
+    }
+  }
+  return MSG_ID_RESERVED;
+}
+
+void msg_remote_receive(const uint8_t *p_data, size_t length) {
+  uint32_t queued = ring_buf_put(&remote_rx_ring, p_data, length);
+
+  if (queued < length) {
+    atomic_add(&remote_stats.overruns, length - queued);
+  }
+  k_sem_give(&remote_rx_sem);
+}
+
+void msg_remote_stats_get(struct msg_remote_stats *p_stats) {
+  if (p_stats == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return;
+  }
+
+  p_stats->frames_sent = atomic_get(&remote_stats.frames_sent);
+  p_stats->frames_received = atomic_get(&remote_stats.frames_received);
+  p_stats->msgs_sent = atomic_get(&remote_stats.msgs_sent);
+  p_stats->msgs_received = atomic_get(&remote_stats.msgs_received);
+  p_stats->crc_errors = atomic_get(&remote_stats.crc_errors);
+  p_stats->lost_frames = atomic_get(&remote_stats.lost_frames);
+  p_stats->overruns = atomic_get(&remote_stats.overruns);
+  p_stats->drops = atomic_get(&remote_stats.drops);
+  p_stats->credit_timeouts = atomic_get(&remote_stats.credit_timeouts);
+}
+
+/**************************************************************/
+/* Local Function Definitions                                 */
+/**************************************************************/
+static void remote_uart_isr(const struct device *p_dev, void *p_user_data) {
+  ARG_UNUSED(p_user_data);
+
+  uint8_t buffer[16];
+  int length;
+
+  while (uart_irq_update(p_dev) && uart_irq_rx_ready(p_dev)) {
+    length = uart_fifo_read(p_dev, buffer, sizeof(buffer));
+    if (length <= 0) {
+      break;
+    }
+    msg_remote_receive(buffer, length);
+  }
+}
+
+static void remote_rx_thread(void *p_arg1, void *p_arg2, void *p_arg3) {
+  ARG_UNUSED(p_arg1);
+  ARG_UNUSED(p_arg2);
+  ARG_UNUSED(p_arg3);
+
+  uint8_t buffer[32];
+  uint32_t length;
+  uint32_t i;
+
+  if (!device_is_ready(remote_uart)) {
+    LOG_ERR("UART of the link isn't ready");
+    return;
+  }
+
+  uart_irq_callback_user_data_set(remote_uart, remote_uart_isr, NULL);
+  uart_irq_rx_enable(remote_uart);
+
+  while (1) {
+    k_sem_take(&remote_rx_sem, K_FOREVER);
+    while ((length = ring_buf_get(&remote_rx_ring, buffer, sizeof(buffer))) > 0) {
+      for (i = 0; i < length; i++) {
+        remote_rx_byte(buffer[i]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Remove the framing of the received bytes.
+ */
+static void remote_rx_byte(uint8_t byte) {
+  if (byte == FRAME_DELIMITER) {
+    if (remote_rx_overflow) {
+      atomic_inc(&remote_stats.crc_errors);
+    } else if (remote_rx_length > 0) {
+      remote_rx_frame(remote_rx_buffer, remote_rx_length);
+    }
+    remote_rx_length = 0;
+    remote_rx_escape = false;
+    remote_rx_overflow = false;
+    return;
+  }
+
+  if (byte == FRAME_ESCAPE) {
+    remote_rx_escape = true;
+    return;
+  }
+  if (remote_rx_escape) {
+    byte ^= FRAME_ESCAPE_XOR;
+    remote_rx_escape = false;
+  }
+
+  if (remote_rx_length < sizeof(remote_rx_buffer)) {
+    remote_rx_buffer[remote_rx_length++] = byte;
+  } else {
+    remote_rx_overflow = true;
+  }
+}
+
+static void remote_rx_frame(const uint8_t *p_frame, size_t length) {
+  if (length < FRAME_HEADER_SIZE + FRAME_CRC_SIZE ||
+      crc16_ccitt(0xffff, p_frame, length - FRAME_CRC_SIZE) != sys_get_le16(&p_frame[length - FRAME_CRC_SIZE])) {
+    atomic_inc(&remote_stats.crc_errors);
+    return;
+  }
+
+  uint8_t flags = p_frame[0];
+  uint8_t seq = p_frame[1];
+  uint8_t ack = p_frame[2];
+  uint8_t count = p_frame[3];
+  uint8_t expected = (flags & FRAME_SYNC) ? seq : (uint8_t)atomic_get(&remote_rx_seq);
+
+  /* Every frame returns credits. */
+  atomic_set(&remote_peer_ack, ack);
+
+  if (count == 0) {
+    atomic_set(&remote_rx_seq, expected);
+    k_sem_give(&remote_tx_sem);
+    return;
+  }
+
+  if (seq != expected) {
+    atomic_add(&remote_stats.lost_frames, (uint8_t)(seq - expected));
+  }
+  remote_rx_records(&p_frame[FRAME_HEADER_SIZE], length - FRAME_HEADER_SIZE - FRAME_CRC_SIZE, count);
+  atomic_inc(&remote_stats.frames_received);
+
+  /* The frame is handled, so its credit can be returned. */
+  atomic_set(&remote_rx_seq, (uint8_t)(seq + 1));
+  atomic_set(&remote_ack_pending, 1);
+  k_sem_give(&remote_tx_sem);
+}
+
+static void remote_rx_records(const uint8_t *p_records, size_t length, uint8_t count) {
+  size_t size;
+
+  while (count > 0) {
+    if (length < RECORD_HEADER_SIZE || length < RECORD_HEADER_SIZE + p_records[4]) {
+      atomic_inc(&remote_stats.crc_errors);
+      return;
+    }
+
+    remote_inject(p_records);
+    size = RECORD_HEADER_SIZE + p_records[4];
+    p_records += size;
+    length -= size;
+    count--;
+  }
+}
+
+/**
+ * @brief Send a received record to a local receiver.
+ */
+static void remote_inject(const uint8_t *p_record) {
+  mid_t rx_id = p_record[0];
+  mid_t tx_id = p_record[1];
+  msg_code_t msg_code = p_record[2];
+  uint8_t options = p_record[3] & MSG_OPTION_URGENT;
+  uint8_t size = p_record[4];
+  msg_t *p_msg;
+
+  /* A message for a proxy would be sent back over the link. */
+  if (rx_id == MSG_ID_RESERVED || !msg_is_registered(rx_id) || msg_remote_is_proxy(rx_id)) {
+    atomic_inc(&remote_stats.drops);
+    return;
+  }
+
+#ifdef CONFIG_SYS_MSG_INLINE
+  if (size == 0) {
+    if (msg_send_inline(rx_id, tx_id, msg_code, options) == SYS_SUCCESS) {
+      atomic_inc(&remote_stats.msgs_received);
+    } else {
+      atomic_inc(&remote_stats.drops);
+    }
+    return;
+  }
+#endif
+
+  p_msg = (msg_t *)buffer_pool_try_to_take(sizeof(msg_header_t) + size, __func__);
+  if (p_msg == NULL) {
+    atomic_inc(&remote_stats.drops);
+    return;
+  }
+
+  SYS_MSG_HEADER_INIT(p_msg, msg_code, tx_id);
+  p_msg->header.options = options;
+  memcpy((uint8_t *)p_msg + sizeof(msg_header_t), &p_record[RECORD_HEADER_SIZE], size);
+
+  if (msg_send(rx_id, p_msg) != SYS_SUCCESS) {
+    msg_release(p_msg);
+    atomic_inc(&remote_stats.drops);
+    return;
+  }
+  atomic_inc(&remote_stats.msgs_received);
+}
+
+static void remote_tx_thread(void *p_arg1, void *p_arg2, void *p_arg3) {
+  ARG_UNUSED(p_arg1);
+  ARG_UNUSED(p_arg2);
+  ARG_UNUSED(p_arg3);
+
+  if (!device_is_ready(remote_uart)) {
+    return;
+  }
+
+  /* Tell the far side where our sequence starts. */
+  remote_send_frame(0, FRAME_HEADER_SIZE);
+
+  while (1) {
+    remote_wait();
+
+    if (remote_pending()) {
+      remote_take_credit();
+      /* Let a burst accumulate so that it shares a frame. */
+      if (CONFIG_SYS_MSG_REMOTE_BATCH_MS > 0) {
+        k_sleep(K_MSEC(CONFIG_SYS_MSG_REMOTE_BATCH_MS));
+      }
+      remote_send_data();
+    } else if (atomic_get(&remote_ack_pending)) {
+      remote_send_frame(0, FRAME_HEADER_SIZE);
+    }
+  }
+}
+
+/**
+ * @brief Wait until a proxy has a message or the receive thread has
+ * something for the transmit thread.
+ */
+static void remote_wait(void) {
+  struct k_poll_event events[REMOTE_PROXIES + 1];
+  size_t count = atomic_get(&remote_proxy_count);
+  size_t i;
+
+  if (p_remote_held != NULL) {
+    return;
+  }
+
+  for (i = 0; i < count; i++) {
+    k_poll_event_init(&events[i], MSG_QUEUE_POLL_TYPE, K_POLL_MODE_NOTIFY_ONLY,
+                      MSG_QUEUE_POLL_OBJ(remote_proxies[i].rxer.p_queue));
+  }
+  k_poll_event_init(&events[count], K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, &remote_tx_sem);
+
+  (void)k_poll(events, count + 1, K_FOREVER);
+  (void)k_sem_take(&remote_tx_sem, K_NO_WAIT);
+}
+
+static bool remote_pending(void) {
+  size_t count = atomic_get(&remote_proxy_count);
+  size_t i;
+
+  if (p_remote_held != NULL) {
+    return true;
+  }
+  for (i = 0; i < count; i++) {
+    if (msg_queue_count(remote_proxies[i].rxer.id) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Wait until the far side has room for a data frame.
+ *
+ * Frames that return credits are still sent while waiting, otherwise two
+ * boards that both ran out of credits would wait for each other. If the
+ * credits don't come back in time the frames in flight are assumed lost and
+ * the next data frame restarts the sequence.
+ */
+static void remote_take_credit(void) {
+  int64_t deadline = k_uptime_get() + CONFIG_SYS_MSG_REMOTE_ACK_TIMEOUT_MS;
+  int64_t remaining;
+  uint8_t in_flight;
+
+  while (1) {
+    in_flight = remote_tx_seq - (uint8_t)atomic_get(&remote_peer_ack);
+    if (in_flight < REMOTE_CREDITS) {
+      return;
+    }
+    /* More than a window is in flight if the far side restarted. */
+    if (in_flight > REMOTE_CREDITS) {
+      break;
+    }
+
+    if (atomic_get(&remote_ack_pending)) {
+      remote_send_frame(0, FRAME_HEADER_SIZE);
+    }
+
+    remaining = deadline - k_uptime_get();
+    if (remaining <= 0) {
+      atomic_inc(&remote_stats.credit_timeouts);
+      break;
+    }
+    (void)k_sem_take(&remote_tx_sem, K_MSEC(remaining));
+  }
+
+  atomic_set(&remote_peer_ack, remote_tx_seq);
+  remote_tx_sync = true;
+}
+
+/**
+ * @brief Write the queued messages to the link in one frame.
+ */
+static void remote_send_data(void) {
+  struct remote_proxy *p_proxy;
+  msg_header_t header;
+  size_t length = FRAME_HEADER_SIZE;
+  size_t size;
+  uint8_t count = 0;
+  msg_t *p_msg;
+
+  while (count < UINT8_MAX && (p_msg = remote_next_msg(&p_proxy)) != NULL) {
+    msg_entry_header(p_msg, &header);
+
+    /* Only buffer pool messages have a payload. */
+    size = 0;
+    if (!(header.options & (MSG_OPTION_INLINE | MSG_OPTION_STATIC))) {
+      size = buffer_pool_size(p_msg) - sizeof(msg_header_t);
+    }
+    if (size > RECORD_MAX_PAYLOAD) {
+      LOG_WRN("Message %u is too large for the link", header.msg_code);
+      atomic_inc(&remote_stats.drops);
+      msg_release(p_msg);
+      continue;
+    }
+
+    if (length + RECORD_HEADER_SIZE + size > FRAME_HEADER_SIZE + CONFIG_SYS_MSG_REMOTE_FRAME_SIZE) {
+      p_remote_held = p_msg;
+      p_remote_held_proxy = p_proxy;
+      break;
+    }
+
+    remote_tx_buffer[length++] = p_proxy->remote_id;
+    remote_tx_buffer[length++] = header.tx_id;
+    remote_tx_buffer[length++] = header.msg_code;
+    remote_tx_buffer[length++] = header.options & MSG_OPTION_URGENT;
+    remote_tx_buffer[length++] = (uint8_t)size;
+    memcpy(&remote_tx_buffer[length], (const uint8_t *)p_msg + sizeof(msg_header_t), size);
+    length += size;
+    count++;
+
+    msg_release(p_msg);
+  }
+
+  if (count > 0) {
+    remote_send_frame(count, length);
+    atomic_inc(&remote_stats.frames_sent);
+    atomic_add(&remote_stats.msgs_sent, count);
+  }
+}
+
+/**
+ * @brief Take the next message from the proxies (round robin).
+ */
+static msg_t *remote_next_msg(struct remote_proxy **pp_proxy) {
+  size_t count = atomic_get(&remote_proxy_count);
+  msg_t *p_msg = NULL;
+  size_t i;
+
+  if (p_remote_held != NULL) {
+    p_msg = p_remote_held;
+    *pp_proxy = p_remote_held_proxy;
+    p_remote_held = NULL;
+    return p_msg;
+  }
+
+  for (i = 0; i < count; i++) {
+    *pp_proxy = &remote_proxies[remote_next_proxy];
+    remote_next_proxy = (remote_next_proxy + 1) % count;
+    if (msg_recv((*pp_proxy)->rxer.p_queue, &p_msg, K_NO_WAIT) == SYS_SUCCESS && p_msg != NULL) {
+      return p_msg;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Complete the frame in the transmit buffer and write it to the UART.
+ *
+ * @param count number of records (0 for a frame that only returns credits)
+ * @param length size of the header and records
+ */
+static void remote_send_frame(uint8_t count, size_t length) {
+  size_t i;
+
+  /* The frame acknowledges everything that was received until now. */
+  atomic_clear(&remote_ack_pending);
+
+  remote_tx_buffer[0] = remote_tx_sync ? FRAME_SYNC : 0;
+  remote_tx_buffer[1] = remote_tx_seq;
+  remote_tx_buffer[2] = (uint8_t)atomic_get(&remote_rx_seq);
+  remote_tx_buffer[3] = count;
+  sys_put_le16(crc16_ccitt(0xffff, remote_tx_buffer, length), &remote_tx_buffer[length]);
+  length += FRAME_CRC_SIZE;
+
+  uart_poll_out(remote_uart, FRAME_DELIMITER);
+  for (i = 0; i < length; i++) {
+    remote_put_byte(remote_tx_buffer[i]);
+  }
+  uart_poll_out(remote_uart, FRAME_DELIMITER);
+
+  if (count > 0) {
+    remote_tx_seq++;
+    remote_tx_sync = false;
+  }
+}
+
+static void remote_put_byte(uint8_t byte) {
+  if (byte == FRAME_DELIMITER || byte == FRAME_ESCAPE) {
+    uart_poll_out(remote_uart, FRAME_ESCAPE);
+    byte ^= FRAME_ESCAPE_XOR;
+  }
+  uart_poll_out(remote_uart, byte);
+}
@@ -0,0 +1,365 @@
+/**
+ * @file msg_shell.c
+ * @brief Command shell to show the state of the message framework.
+ *
+ * Copyright (c) 2022-2023 SEED FIC
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/printk.h>
+
+#include <framework/sys_core.h>
+
+#ifdef CONFIG_SYS_MSG_STATS
+#include <framework/msg_stats.h>
+#endif
+#ifdef CONFIG_SYS_MSG_TRACE
+#include <framework/msg_trace.h>
+#endif
+#ifdef CONFIG_SYS_MSG_TOPIC
+#include <framework/msg_topic.h>
+#endif
+#ifdef CONFIG_SYS_MSG_RECORD
+#include <stdlib.h>
+
+#include <framework/msg_record.h>
+#endif
+#ifdef CONFIG_SYS_MSG_REMOTE
+#include <framework/msg_remote.h>
+#endif
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#ifdef CONFIG_SYS_MSG_RECORD
+/* Time the replay waits for the receivers to handle the stream */
+#define REPLAY_DRAIN_MS 1000
+#endif
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int sys_handlers(const struct shell *shell, size_t argc, char **argv);
+
+#ifdef CONFIG_SYS_MSG_STATS
+static int sys_msgstats(const struct shell *shell, size_t argc, char **argv);
+static void print_histogram(const struct shell *shell, const char *name, const uint16_t *p_histogram,
+                            uint32_t max_us);
+#endif
+
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+static int sys_queues(const struct shell *shell, size_t argc, char **argv);
+#endif
+
+#ifdef CONFIG_SYS_MSG_TRACE
+static int sys_trace(const struct shell *shell, size_t argc, char **argv);
+#endif
+
+#ifdef CONFIG_SYS_MSG_TOPIC
+static int sys_topics(const struct shell *shell, size_t argc, char **argv);
+#endif
+
+#ifdef CONFIG_SYS_MSG_RECORD
+static int sys_record(const struct shell *shell, size_t argc, char **argv);
+static int sys_replay(const struct shell *shell, size_t argc, char **argv);
+#endif
+
+#ifdef CONFIG_SYS_MSG_REMOTE
+static int sys_remote(const struct shell *shell, size_t argc, char **argv);
+#endif
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+#ifdef CONFIG_SYS_MSG_RECORD
+/* Too big for the shell stack */
+static struct msg_record msg_records[CONFIG_SYS_MSG_RECORD_ENTRIES];
+#endif
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_sys,
+                               SHELL_CMD(handlers, NULL, "Print the codes of each dispatcher table", sys_handlers),
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+                               SHELL_CMD(queues, NULL, "Print message queue statistics", sys_queues),
+#endif
+#ifdef CONFIG_SYS_MSG_STATS
+                               SHELL_CMD_ARG(msgstats, NULL,
+                                             "Print message latency statistics\n"
+                                             "usage:\n"
+                                             "$ sys msgstats [reset]\n",
+                                             sys_msgstats, 1, 1),
+#endif
+#ifdef CONFIG_SYS_MSG_TRACE
+                               SHELL_CMD_ARG(trace, NULL,
+                                             "Print the message trace, oldest first\n"
+                                             "usage:\n"
+                                             "$ sys trace [clear]\n",
+                                             sys_trace, 1, 1),
+#endif
+#ifdef CONFIG_SYS_MSG_TOPIC
+                               SHELL_CMD(topics, NULL, "Print the subscribers of each event type", sys_topics),
+#endif
+#ifdef CONFIG_SYS_MSG_RECORD
+                               SHELL_CMD_ARG(record, NULL,
+                                             "Print the recorded messages, oldest first\n"
+                                             "usage:\n"
+                                             "$ sys record [start|stop|clear]\n",
+                                             sys_record, 1, 1),
+                               SHELL_CMD_ARG(replay, NULL,
+                                             "Send the recorded messages again and print the report\n"
+                                             "usage:\n"
+                                             "$ sys replay [speed]\n"
+                                             "speed: 1 original timing (default), n times faster, 0 back to back\n",
+                                             sys_replay, 1, 1),
+#endif
+#ifdef CONFIG_SYS_MSG_REMOTE
+                               SHELL_CMD(remote, NULL, "Print the remote receivers and link counters", sys_remote),
+#endif
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(sys, &sub_sys, "Message Framework", NULL);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int sys_handlers(const struct shell *shell, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  uint32_t code;
+
+  STRUCT_SECTION_FOREACH(msg_handler_table, p_table) {
+    shell_fprintf(shell, SHELL_NORMAL, "%s:", p_table->p_name);
+    for (code = 0; code < p_table->count; code++) {
+      if (p_table->p_handlers[code] != NULL) {
+        shell_fprintf(shell, SHELL_NORMAL, " %u", code);
+      }
+    }
+    shell_fprintf(shell, SHELL_NORMAL, "\n");
+  }
+  return 0;
+}
+
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+static int sys_queues(const struct shell *shell, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  struct msg_queue_stats stats;
+  mid_t rx_id;
+  uint32_t code;
+
+  shell_print(shell, "Task  high water  failures  drops  coalesced  expired");
+  for (rx_id = MSG_ID_APP_START; rx_id < CONFIG_SYS_MAX_MSG_RECEIVES; rx_id++) {
+    if (msg_queue_stats_get(rx_id, &stats) == 0) {
+      shell_print(shell, "%4u  %10u  %8u  %5u  %9u  %7u", rx_id, stats.high_water, stats.enqueue_failures,
+                  stats.drops, stats.coalesced, stats.expired);
+    }
+  }
+
+  shell_print(shell, "Dropped messages by code:");
+  for (code = 0; code <= UINT8_MAX; code++) {
+    if (msg_queue_drops_by_code(code) != 0) {
+      shell_print(shell, "code %3u  %u", code, msg_queue_drops_by_code(code));
+    }
+  }
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_STATS
+static int sys_msgstats(const struct shell *shell, size_t argc, char **argv) {
+  struct msg_code_stats stats;
+  mid_t rx_id;
+  size_t i;
+
+  if (argc > 1) {
+    if (strcmp(argv[1], "reset") != 0) {
+      shell_error(shell, "Unknown argument %s", argv[1]);
+      return -EINVAL;
+    }
+    msg_stats_reset();
+    return 0;
+  }
+
+  for (rx_id = MSG_ID_APP_START; rx_id < CONFIG_SYS_MAX_MSG_RECEIVES; rx_id++) {
+    for (i = 0; msg_stats_get(rx_id, i, &stats) == 0; i++) {
+      shell_print(shell, "Task %u code %u count %u", rx_id, stats.msg_code, stats.count);
+      print_histogram(shell, "queue  ", stats.residency, stats.max_residency_us);
+      print_histogram(shell, "handler", stats.handler, stats.max_handler_us);
+    }
+    if (msg_stats_untracked(rx_id) != 0) {
+      shell_print(shell, "Task %u untracked     %u", rx_id, msg_stats_untracked(rx_id));
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Print non-empty buckets as "<upper bound in us>:count".
+ * The last bucket also holds everything above it.
+ */
+static void print_histogram(const struct shell *shell, const char *name, const uint16_t *p_histogram,
+                            uint32_t max_us) {
+  size_t i;
+
+  shell_fprintf(shell, SHELL_NORMAL, "  %s max %u us |", name, max_us);
+  for (i = 0; i < CONFIG_SYS_MSG_STATS_BUCKETS - 1; i++) {
+    if (p_histogram[i] != 0) {
+      shell_fprintf(shell, SHELL_NORMAL, " <%u:%u", BIT(i), p_histogram[i]);
+    }
+  }
+  if (p_histogram[i] != 0) {
+    shell_fprintf(shell, SHELL_NORMAL, " >=%u:%u", BIT(i - 1), p_histogram[i]);
+  }
+  shell_fprintf(shell, SHELL_NORMAL, "\n");
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_TRACE
+static int sys_trace(const struct shell *shell, size_t argc, char **argv) {
+  /* Too big for the shell stack */
+  static struct msg_trace_record records[CONFIG_SYS_MSG_TRACE_ENTRIES];
+  uint32_t lost = 0;
+  size_t count;
+  size_t i;
+
+  if (argc > 1) {
+    if (strcmp(argv[1], "clear") != 0) {
+      shell_error(shell, "Unknown argument %s", argv[1]);
+      return -EINVAL;
+    }
+    msg_trace_clear();
+    return 0;
+  }
+
+  count = msg_trace_snapshot(records, ARRAY_SIZE(records), &lost);
+  if (lost != 0) {
+    shell_print(shell, "%u older records were overwritten", lost);
+  }
+
+  shell_print(shell, "      +us  event        task  code  arg");
+  for (i = 0; i < count; i++) {
+    shell_print(shell, "%9u  %-11s  %4u  %4u  %u", k_cyc_to_us_floor32(records[i].cycles - records[0].cycles),
+                msg_trace_event_name(records[i].event), records[i].task, records[i].msg_code, records[i].arg);
+  }
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_TOPIC
+static int sys_topics(const struct shell *shell, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  uint32_t type;
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+  shell_print(shell, "Event  subscribers  filtered");
+  for (type = 0; type < NUMBER_OF_EVENTS; type++) {
+    shell_print(shell, "%5u  0x%08x   %8u", type, msg_topic_subscribers(type), msg_event_filter_drops(type));
+  }
+#else
+  shell_print(shell, "Event  subscribers");
+  for (type = 0; type < NUMBER_OF_EVENTS; type++) {
+    shell_print(shell, "%5u  0x%08x", type, msg_topic_subscribers(type));
+  }
+#endif
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_RECORD
+static int sys_record(const struct shell *shell, size_t argc, char **argv) {
+  uint32_t lost = 0;
+  size_t count;
+  size_t i;
+
+  if (argc > 1) {
+    if (strcmp(argv[1], "start") == 0) {
+      msg_record_start();
+    } else if (strcmp(argv[1], "stop") == 0) {
+      msg_record_stop();
+    } else if (strcmp(argv[1], "clear") == 0) {
+      msg_record_clear();
+    } else {
+      shell_error(shell, "Unknown argument %s", argv[1]);
+      return -EINVAL;
+    }
+    return 0;
+  }
+
+  count = msg_record_snapshot(msg_records, ARRAY_SIZE(msg_records), &lost);
+  if (lost != 0) {
+    shell_print(shell, "%u older records were overwritten", lost);
+  }
+
+  shell_print(shell, "      +us  rx  tx  code  opt  size");
+  for (i = 0; i < count; i++) {
+    shell_print(shell, "%9u  %2u  %2u  %4u  0x%02x  %4u", msg_records[i].time_us - msg_records[0].time_us,
+                msg_records[i].rx_id, msg_records[i].tx_id, msg_records[i].msg_code, msg_records[i].options,
+                msg_records[i].size);
+  }
+  return 0;
+}
+
+static int sys_replay(const struct shell *shell, size_t argc, char **argv) {
+  struct msg_replay_report report;
+  uint32_t speed = 1;
+  size_t count;
+  mid_t rx_id;
+
+  if (argc > 1) {
+    speed = strtoul(argv[1], NULL, 0);
+  }
+
+  count = msg_record_snapshot(msg_records, ARRAY_SIZE(msg_records), NULL);
+  if (msg_replay(msg_records, count, speed, REPLAY_DRAIN_MS, &report) != 0) {
+    return -EINVAL;
+  }
+
+  shell_print(shell, "sent %u failed %u in %u us", report.sent, report.failed, report.duration_us);
+  shell_print(shell, "Task  max queued");
+  for (rx_id = MSG_ID_APP_START; rx_id < CONFIG_SYS_MAX_MSG_RECEIVES; rx_id++) {
+    shell_print(shell, "%4u  %10u", rx_id, report.max_queued[rx_id]);
+  }
+  shell_print(shell, "pool: max allocs %u min space %u", report.max_allocs, report.min_space_available);
+#ifdef CONFIG_SYS_MSG_STATS
+  shell_print(shell, "max residency %u us max handler %u us ('sys msgstats' for details)", report.max_residency_us,
+              report.max_handler_us);
+#endif
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_REMOTE
+static int sys_remote(const struct shell *shell, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  struct msg_remote_stats stats;
+  mid_t rx_id;
+
+  shell_print(shell, "Task  Remote  Queued");
+  for (rx_id = MSG_ID_APP_START; rx_id < CONFIG_SYS_MAX_MSG_RECEIVES; rx_id++) {
+    if (msg_remote_is_proxy(rx_id)) {
+      shell_print(shell, "%4u  %6u  %6u", rx_id, msg_remote_id(rx_id), msg_queue_count(rx_id));
+    }
+  }
+
+  msg_remote_stats_get(&stats);
+  shell_print(shell, "frames sent %u received %u, messages sent %u received %u", stats.frames_sent,
+              stats.frames_received, stats.msgs_sent, stats.msgs_received);
+  shell_print(shell, "crc errors %u lost frames %u overruns %u drops %u credit timeouts %u", stats.crc_errors,
+              stats.lost_frames, stats.overruns, stats.drops, stats.credit_timeouts);
+  return 0;
+}
+#endif
@@ -0,0 +1,107 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(msg_stats, LOG_LEVEL_WRN);
+
+#include <string.h>
+
+#include <framework/msg_stats.h>
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+struct msg_task_stats {
+  uint32_t untracked;
+  struct msg_code_stats codes[CONFIG_SYS_MSG_STATS_CODES];
+};
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+/* Each entry is only written by the thread of its receiver. */
+static struct msg_task_stats msg_stats[CONFIG_SYS_MAX_MSG_RECEIVES];
+
+/**************************************************************/
+/* Local Function Prototypes                                  */
+/**************************************************************/
+static struct msg_code_stats *find_code(struct msg_task_stats *p_task, msg_code_t msg_code);
+static void add_sample(uint16_t *p_histogram, uint32_t *p_max, uint32_t us);
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+void msg_stats_record(mid_t rx_id, msg_code_t msg_code, uint32_t residency_cycles, uint32_t handler_cycles) {
+  if (rx_id >= CONFIG_SYS_MAX_MSG_RECEIVES) {
+    return;
+  }
+
+  struct msg_task_stats *p_task = &msg_stats[rx_id];
+  struct msg_code_stats *p_code = find_code(p_task, msg_code);
+
+  if (p_code == NULL) {
+    p_task->untracked += 1;
+    return;
+  }
+
+  p_code->count += 1;
+  if (residency_cycles != MSG_STATS_NO_RESIDENCY) {
+    add_sample(p_code->residency, &p_code->max_residency_us, k_cyc_to_us_floor32(residency_cycles));
+  }
+  add_sample(p_code->handler, &p_code->max_handler_us, k_cyc_to_us_floor32(handler_cycles));
+}
+
+int msg_stats_get(mid_t rx_id, size_t index, struct msg_code_stats *stats) {
+  if (rx_id >= CONFIG_SYS_MAX_MSG_RECEIVES || stats == NULL) {
+    return -EINVAL;
+  }
+  if (index >= CONFIG_SYS_MSG_STATS_CODES || msg_stats[rx_id].codes[index].count == 0) {
+    return -ENOENT;
+  }
+
+  unsigned int key = irq_lock();
+  memcpy(stats, &msg_stats[rx_id].codes[index], sizeof(struct msg_code_stats));
+  irq_unlock(key);
+  return 0;
+}
+
+uint32_t msg_stats_untracked(mid_t rx_id) {
+  if (rx_id >= CONFIG_SYS_MAX_MSG_RECEIVES) {
+    return 0;
+  }
+  return msg_stats[rx_id].untracked;
+}
+
+void msg_stats_reset(void) {
+  unsigned int key = irq_lock();
+  memset(msg_stats, 0, sizeof(msg_stats));
+  irq_unlock(key);
+}
+
+/**************************************************************/
+/* Local Function Definitions                                 */
+/**************************************************************/
+/**
+ * @brief Find the entry of a message code or claim a free one.
+ */
+static struct msg_code_stats *find_code(struct msg_task_stats *p_task, msg_code_t msg_code) {
+  size_t i;
+
+  for (i = 0; i < CONFIG_SYS_MSG_STATS_CODES; i++) {
+    struct msg_code_stats *p_code = &p_task->codes[i];
+    if (p_code->count == 0) {
+      p_code->msg_code = msg_code;
+      return p_code;
+    }
+    if (p_code->msg_code == msg_code) {
+      return p_code;
+    }
+  }
+  return NULL;
+}
+
+static void add_sample(uint16_t *p_histogram, uint32_t *p_max, uint32_t us) {
+  size_t bucket = MIN(find_msb_set(us), CONFIG_SYS_MSG_STATS_BUCKETS - 1);
+
+  if (p_histogram[bucket] < UINT16_MAX) {
+    p_histogram[bucket] += 1;
+  }
+  *p_max = MAX(*p_max, us);
+}
@@ -0,0 +1,223 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(msg_topic, LOG_LEVEL_WRN);
+
+#include <stdlib.h>
+
+#include <framework/buffer_pool.h>
+#include <framework/msg_ids.h>
+#include <framework/msg_topic.h>
+#include <framework/sys_msg.h>
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+BUILD_ASSERT(NUMBER_OF_EVENTS <= 32, "Topic mask is 32 bits");
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+BUILD_ASSERT(MSG_ID_EVENT_FILTER < CONFIG_SYS_MAX_MSG_RECEIVES, "Event filter task id is too large");
+
+struct msg_event_filter {
+  uint32_t threshold;
+  uint32_t min_interval_ms;
+  int32_t last_value;
+  uint32_t last_ms;
+  bool published; /* last_value and last_ms are valid */
+  uint32_t drops;
+};
+#endif
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+/* Mask of the subscribers (BIT(id)) of each topic */
+static atomic_t msg_topic_route[NUMBER_OF_EVENTS];
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+static struct msg_event_filter msg_event_filters[NUMBER_OF_EVENTS];
+static struct k_spinlock msg_event_filter_lock;
+#endif
+
+/**************************************************************/
+/* Local Function Prototypes                                  */
+/**************************************************************/
+static BaseType_t topic_fan_out(event_msg_t *p_event_msg);
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+static bool event_filter_pass(const event_msg_t *p_event_msg);
+static dispatch_result_t event_filter_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg);
+
+MSG_DISPATCHER_DEFINE(event_filter_msg_dispatcher, MSG_HANDLER(SMC_EVENT_PUBLISH, event_filter_msg_handler));
+#endif
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+/* Registered and started by the framework */
+MSG_TASK_DEFINE(msg_event_filter_task, MSG_ID_EVENT_FILTER, CONFIG_SYS_MSG_EVENT_FILTER_PRIORITY,
+                CONFIG_SYS_MSG_EVENT_FILTER_STACK_SIZE, CONFIG_SYS_MSG_EVENT_FILTER_QUEUE_DEPTH,
+                event_filter_msg_dispatcher);
+#endif
+
+BaseType_t msg_topic_subscribe(mid_t rx_id, uint32_t topics) {
+  uint32_t type;
+
+  if (rx_id == MSG_ID_RESERVED || rx_id >= CONFIG_SYS_MAX_MSG_RECEIVES || (topics & ~MSG_TOPIC_ALL) != 0) {
+    SYSCORE_ASSERT(FORCED);
+    return SYS_ERROR;
+  }
+
+  while (topics != 0) {
+    type = find_lsb_set(topics) - 1;
+    topics &= topics - 1;
+    atomic_or(&msg_topic_route[type], BIT(rx_id));
+  }
+  return SYS_SUCCESS;
+}
+
+BaseType_t msg_topic_unsubscribe(mid_t rx_id, uint32_t topics) {
+  uint32_t type;
+
+  if (rx_id == MSG_ID_RESERVED || rx_id >= CONFIG_SYS_MAX_MSG_RECEIVES || (topics & ~MSG_TOPIC_ALL) != 0) {
+    SYSCORE_ASSERT(FORCED);
+    return SYS_ERROR;
+  }
+
+  while (topics != 0) {
+    type = find_lsb_set(topics) - 1;
+    topics &= topics - 1;
+    atomic_and(&msg_topic_route[type], ~BIT(rx_id));
+  }
+  return SYS_SUCCESS;
+}
+
+uint32_t msg_topic_subscribers(event_type_t type) {
+  if (type >= NUMBER_OF_EVENTS) {
+    return 0;
+  }
+  return (uint32_t)atomic_get(&msg_topic_route[type]);
+}
+
+BaseType_t msg_publish(event_msg_t *p_event_msg) {
+  if (p_event_msg == NULL || p_event_msg->event_type >= NUMBER_OF_EVENTS) {
+    SYSCORE_ASSERT(FORCED);
+    return SYS_ERROR;
+  }
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+  p_event_msg->header.msg_code = SMC_EVENT_PUBLISH;
+  p_event_msg->header.rx_id = MSG_ID_EVENT_FILTER;
+  return msg_send(MSG_ID_EVENT_FILTER, (msg_t *)p_event_msg);
+#else
+  return topic_fan_out(p_event_msg);
+#endif
+}
+
+BaseType_t sysmsg_publish(mid_t tx_id, event_type_t type, event_data_t data) {
+  BaseType_t result = -ENOMEM;
+  /* Taken from the pool of the publisher so that it can't starve other tasks.
+   * A burst that empties the pool is dropped (and counted by the pool). */
+  event_msg_t *p_event_msg =
+      (event_msg_t *)buffer_pool_try_to_take_from(msg_pool(tx_id), sizeof(event_msg_t), K_NO_WAIT, __func__);
+
+  if (p_event_msg != NULL) {
+    p_event_msg->header.tx_id = tx_id;
+    p_event_msg->event_type = type;
+    p_event_msg->event_data = data;
+    result = msg_publish(p_event_msg);
+    if (result != SYS_SUCCESS) {
+      msg_release((msg_t *)p_event_msg);
+    }
+  }
+
+  return result;
+}
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+BaseType_t msg_event_filter_set(event_type_t type, uint32_t threshold, uint32_t min_interval_ms) {
+  if (type >= NUMBER_OF_EVENTS) {
+    SYSCORE_ASSERT(FORCED);
+    return SYS_ERROR;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&msg_event_filter_lock);
+  msg_event_filters[type].threshold = threshold;
+  msg_event_filters[type].min_interval_ms = min_interval_ms;
+  k_spin_unlock(&msg_event_filter_lock, key);
+  return SYS_SUCCESS;
+}
+
+uint32_t msg_event_filter_drops(event_type_t type) {
+  if (type >= NUMBER_OF_EVENTS) {
+    return 0;
+  }
+  return msg_event_filters[type].drops;
+}
+#endif
+
+/**************************************************************/
+/* Local Function Definitions                                 */
+/**************************************************************/
+/**
+ * @brief Share an event with the subscribers of its topic.
+ */
+static BaseType_t topic_fan_out(event_msg_t *p_event_msg) {
+  uint32_t targets = (uint32_t)atomic_get(&msg_topic_route[p_event_msg->event_type]);
+
+  p_event_msg->header.msg_code = SMC_SENSOR_EVENT;
+  if (targets == 0) {
+    /* Nobody listens to the topic, the event is routed by dropping it */
+    LOG_DBG("No subscribers for event %u", p_event_msg->event_type);
+    msg_release((msg_t *)p_event_msg);
+    return SYS_SUCCESS;
+  }
+  return msg_multicast((msg_t *)p_event_msg, targets);
+}
+
+#ifdef CONFIG_SYS_MSG_EVENT_FILTER
+/**
+ * @brief Apply the threshold and rate limit of the event type.
+ * The event is recorded as the last published event if it passes.
+ */
+static bool event_filter_pass(const event_msg_t *p_event_msg) {
+  struct msg_event_filter *p_filter = &msg_event_filters[p_event_msg->event_type];
+  int32_t value = p_event_msg->event_data.s32;
+  uint32_t now_ms = k_uptime_get_32();
+  bool pass = true;
+
+  k_spinlock_key_t key = k_spin_lock(&msg_event_filter_lock);
+  if (p_filter->published) {
+    if ((uint32_t)abs(value - p_filter->last_value) < p_filter->threshold) {
+      pass = false;
+    } else if ((now_ms - p_filter->last_ms) < p_filter->min_interval_ms) {
+      pass = false;
+    }
+  }
+  if (pass) {
+    p_filter->last_value = value;
+    p_filter->last_ms = now_ms;
+    p_filter->published = true;
+  } else {
+    p_filter->drops++;
+  }
+  k_spin_unlock(&msg_event_filter_lock, key);
+
+  return pass;
+}
+
+static dispatch_result_t event_filter_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg) {
+  ARG_UNUSED(p_msg_rxer);
+
+  event_msg_t *p_event_msg = (event_msg_t *)p_msg;
+
+  if (p_event_msg->event_type >= NUMBER_OF_EVENTS || !event_filter_pass(p_event_msg)) {
+    return DISPATCH_OK;
+  }
+
+  /* The reference of the filter is given to the subscribers. */
+  if (topic_fan_out(p_event_msg) == SYS_SUCCESS) {
+    return DISPATCH_DO_NOT_FREE;
+  }
+  return DISPATCH_OK;
+}
+#endif
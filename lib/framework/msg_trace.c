@@ -0,0 +1,84 @@
+#include <string.h>
+
+#include <framework/msg_trace.h>
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+#define TRACE_ENTRIES CONFIG_SYS_MSG_TRACE_ENTRIES
+
+BUILD_ASSERT(IS_POWER_OF_TWO(TRACE_ENTRIES), "Trace ring size must be a power of two");
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+static struct msg_trace_record trace_ring[TRACE_ENTRIES];
+
+/* Total number of records written. The slot of a record is its index
+ * modulo the ring size, so writers only need an atomic increment.
+ */
+static atomic_t trace_head;
+
+/* Value of trace_head when the ring was last cleared */
+static atomic_t trace_tail;
+
+static const char *const trace_event_names[MSG_TRACE_EVENT_COUNT] = {
+    [MSG_TRACE_QUEUE] = "queue",
+    [MSG_TRACE_DROP] = "drop",
+    [MSG_TRACE_DISPATCH] = "dispatch",
+    [MSG_TRACE_FREE] = "free",
+    [MSG_TRACE_UNKNOWN] = "unknown",
+    [MSG_TRACE_TIMER_START] = "timer start",
+    [MSG_TRACE_TIMER_STOP] = "timer stop",
+    [MSG_TRACE_STATIC_OVERRUN] = "overrun",
+    [MSG_TRACE_COALESCE] = "coalesce",
+    [MSG_TRACE_EXPIRE] = "expire",
+};
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+void msg_trace(msg_trace_event_t event, mid_t task, msg_code_t msg_code, uint32_t arg) {
+  atomic_val_t index = atomic_inc(&trace_head);
+  struct msg_trace_record *p_record = &trace_ring[index & (TRACE_ENTRIES - 1)];
+
+  p_record->cycles = k_cycle_get_32();
+  p_record->arg = arg;
+  p_record->event = event;
+  p_record->task = task;
+  p_record->msg_code = msg_code;
+}
+
+size_t msg_trace_snapshot(struct msg_trace_record *p_records, size_t max_records, uint32_t *p_lost) {
+  if (p_records == NULL) {
+    return 0;
+  }
+
+  uint32_t head = atomic_get(&trace_head);
+  uint32_t tail = atomic_get(&trace_tail);
+  uint32_t count = MIN(head - tail, TRACE_ENTRIES);
+  uint32_t first;
+  size_t i;
+
+  count = MIN(count, max_records);
+  first = head - count;
+  for (i = 0; i < count; i++) {
+    memcpy(&p_records[i], &trace_ring[(first + i) & (TRACE_ENTRIES - 1)], sizeof(struct msg_trace_record));
+  }
+
+  if (p_lost != NULL) {
+    *p_lost = first - tail;
+  }
+  return count;
+}
+
+void msg_trace_clear(void) {
+  atomic_set(&trace_tail, atomic_get(&trace_head));
+}
+
+const char *msg_trace_event_name(uint8_t event) {
+  if (event >= MSG_TRACE_EVENT_COUNT) {
+    return "?";
+  }
+  return trace_event_names[event];
+}
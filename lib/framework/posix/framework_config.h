@@ -0,0 +1,113 @@
+/**
+ * @file framework_config.h
+ * @brief Configuration of the host build of the framework.
+ *
+ * Included before every source file of the host build in place of the
+ * Kconfig autoconf.h. The values are the Kconfig defaults, except that
+ * assertions are enabled. Options are set from CMake (see CMakeLists.txt).
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#ifndef __FRAMEWORK_CONFIG_H__
+#define __FRAMEWORK_CONFIG_H__
+
+#define CONFIG_FRAMEWORK 1
+
+#ifndef CONFIG_SYS_MAX_MSG_RECEIVES
+#define CONFIG_SYS_MAX_MSG_RECEIVES 4
+#endif
+
+#ifndef CONFIG_SYS_MSG_RECEIVER_BATCH_SIZE
+#define CONFIG_SYS_MSG_RECEIVER_BATCH_SIZE 8
+#endif
+
+#ifndef CONFIG_SYS_ASSERT_ENABLED
+#define CONFIG_SYS_ASSERT_ENABLED 1
+#endif
+
+#ifndef CONFIG_SYS_ASSERT_ON_BROADCAST_FROM_ISR
+#define CONFIG_SYS_ASSERT_ON_BROADCAST_FROM_ISR 1
+#endif
+
+#ifndef CONFIG_BUFFER_POOL_SIZE
+#define CONFIG_BUFFER_POOL_SIZE 1024
+#endif
+
+#ifndef CONFIG_BUFFER_POOL_COUNT
+#define CONFIG_BUFFER_POOL_COUNT 1
+#endif
+
+#ifdef CONFIG_BUFFER_POOL_SLAB
+#ifndef CONFIG_BUFFER_POOL_SLAB_8_COUNT
+#define CONFIG_BUFFER_POOL_SLAB_8_COUNT 16
+#endif
+#ifndef CONFIG_BUFFER_POOL_SLAB_16_COUNT
+#define CONFIG_BUFFER_POOL_SLAB_16_COUNT 8
+#endif
+#ifndef CONFIG_BUFFER_POOL_SLAB_32_COUNT
+#define CONFIG_BUFFER_POOL_SLAB_32_COUNT 16
+#endif
+#ifndef CONFIG_BUFFER_POOL_SLAB_64_COUNT
+#define CONFIG_BUFFER_POOL_SLAB_64_COUNT 4
+#endif
+#ifndef CONFIG_BUFFER_POOL_SLAB_128_COUNT
+#define CONFIG_BUFFER_POOL_SLAB_128_COUNT 2
+#endif
+#endif
+
+#ifndef CONFIG_BUFFER_POOL_WINDOW_SIZE
+#define CONFIG_BUFFER_POOL_WINDOW_SIZE 0
+#endif
+
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+#ifndef CONFIG_SYS_MSG_EXECUTOR_THREADS
+#define CONFIG_SYS_MSG_EXECUTOR_THREADS 1
+#endif
+#ifndef CONFIG_SYS_MSG_EXECUTOR_STACK_SIZE
+#define CONFIG_SYS_MSG_EXECUTOR_STACK_SIZE 4096
+#endif
+#ifndef CONFIG_SYS_MSG_EXECUTOR_PRIORITY
+#define CONFIG_SYS_MSG_EXECUTOR_PRIORITY 1
+#endif
+#endif
+
+#ifdef CONFIG_SYS_MSG_SCHED
+#ifndef CONFIG_SYS_MSG_SCHED_CRITICAL_PRIORITY
+#define CONFIG_SYS_MSG_SCHED_CRITICAL_PRIORITY 0
+#endif
+#ifndef CONFIG_SYS_MSG_SCHED_NORMAL_PRIORITY
+#define CONFIG_SYS_MSG_SCHED_NORMAL_PRIORITY 1
+#endif
+#ifndef CONFIG_SYS_MSG_SCHED_BACKGROUND_PRIORITY
+#define CONFIG_SYS_MSG_SCHED_BACKGROUND_PRIORITY 2
+#endif
+#endif
+
+/* Kernel */
+#ifdef __LP64__
+#define CONFIG_64BIT 1
+#endif
+
+#ifndef CONFIG_SYS_CLOCK_TICKS_PER_SEC
+#define CONFIG_SYS_CLOCK_TICKS_PER_SEC 10000
+#endif
+
+#ifndef CONFIG_LOG_DEFAULT_LEVEL
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#endif
+
+/* Warnings are printed for every failed allocation, which slows down
+ * a benchmark that fills the pool. */
+#ifndef CONFIG_LOG_MAX_LEVEL
+#define CONFIG_LOG_MAX_LEVEL 1
+#endif
+
+/* Modules that use kernel services that aren't ported (k_fifo, k_poll)
+ * or that aren't part of the host library. */
+#if defined(CONFIG_SYS_MSG_FIFO) || defined(CONFIG_SYS_MSG_PRIORITY_LANES) || defined(CONFIG_SYS_MSG_CALL) ||       \
+    defined(CONFIG_SYS_MSG_TOPIC) || defined(CONFIG_SYS_MSG_ISR_QUEUE) || defined(CONFIG_SYS_MSG_STATS) ||            \
+    defined(CONFIG_SYS_MSG_TRACE) || defined(CONFIG_SYS_MSG_RECORD) || defined(CONFIG_SYS_MSG_REMOTE)
+#error "Option isn't supported by the host build of the framework"
+#endif
+
+#endif /* __FRAMEWORK_CONFIG_H__ */
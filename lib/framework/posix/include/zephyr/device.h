@@ -0,0 +1,12 @@
+/**
+ * @file device.h
+ * @brief Device object of the POSIX port of the framework.
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#ifndef __POSIX_ZEPHYR_DEVICE_H__
+#define __POSIX_ZEPHYR_DEVICE_H__
+
+#include <zephyr/init.h>
+
+#endif /* __POSIX_ZEPHYR_DEVICE_H__ */
@@ -0,0 +1,29 @@
+/**
+ * @file init.h
+ * @brief SYS_INIT for the POSIX port of the framework.
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#ifndef __POSIX_ZEPHYR_INIT_H__
+#define __POSIX_ZEPHYR_INIT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct device {
+  const char *name;
+};
+
+/* Init functions run before main. The level and priority are ignored,
+ * the kernel services don't need to be initialized. */
+#define SYS_INIT(_init_fn, _level, _prio)                                                                              \
+  static void __attribute__((__constructor__)) _sys_init_##_init_fn(void) {                                            \
+    (void)_init_fn(NULL);                                                                                              \
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POSIX_ZEPHYR_INIT_H__ */
@@ -0,0 +1,332 @@
+/**
+ * @file kernel.h
+ * @brief Subset of the Zephyr kernel API on POSIX threads.
+ *
+ * Used to build the framework (sys_core, sys_msg and buffer_pool) as a host
+ * library so that it can be profiled and benchmarked on a PC. Only the
+ * services used by those modules are provided:
+ * - k_msgq, k_heap, k_mem_slab and k_sem use a mutex and a condition variable.
+ * - k_spinlock is a mutex and irq_lock is a global recursive mutex.
+ * - k_timer callbacks run in one timer thread that is treated as an
+ *   interrupt (k_is_in_isr returns true in the callback).
+ * - k_thread is a pthread. The stack, priority and deadline are recorded,
+ *   but the host scheduler doesn't use them.
+ * - A tick is CONFIG_SYS_CLOCK_TICKS_PER_SEC and a cycle is a nanosecond
+ *   of CLOCK_MONOTONIC.
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#ifndef __POSIX_ZEPHYR_KERNEL_H__
+#define __POSIX_ZEPHYR_KERNEL_H__
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************/
+/* Time                                                            */
+/*******************************************************************/
+#define MSEC_PER_SEC 1000
+#define USEC_PER_MSEC 1000
+#define USEC_PER_SEC 1000000
+#define NSEC_PER_USEC 1000
+#define NSEC_PER_SEC 1000000000
+
+#define CONFIG_SYS_CLOCK_HW_CYCLES_PER_SEC NSEC_PER_SEC
+
+typedef int64_t k_ticks_t;
+
+typedef struct {
+  k_ticks_t ticks;
+} k_timeout_t;
+
+#define K_TICKS_FOREVER ((k_ticks_t)-1)
+#define Z_TIMEOUT_TICKS(_t) ((k_timeout_t){.ticks = (_t)})
+#define K_NO_WAIT Z_TIMEOUT_TICKS(0)
+#define K_FOREVER Z_TIMEOUT_TICKS(K_TICKS_FOREVER)
+#define K_TICKS(_t) Z_TIMEOUT_TICKS(_t)
+#define K_USEC(_t) Z_TIMEOUT_TICKS(k_us_to_ticks_ceil64(_t))
+#define K_MSEC(_ms) Z_TIMEOUT_TICKS(k_ms_to_ticks_ceil64(_ms))
+#define K_SECONDS(_s) K_MSEC((_s)*MSEC_PER_SEC)
+#define K_TIMEOUT_EQ(_a, _b) ((_a).ticks == (_b).ticks)
+
+#define k_us_to_ticks_ceil64(_us)                                                                                      \
+  ((k_ticks_t)((((uint64_t)(_us)) * CONFIG_SYS_CLOCK_TICKS_PER_SEC + USEC_PER_SEC - 1) / USEC_PER_SEC))
+#define k_ms_to_ticks_ceil64(_ms)                                                                                      \
+  ((k_ticks_t)((((uint64_t)(_ms)) * CONFIG_SYS_CLOCK_TICKS_PER_SEC + MSEC_PER_SEC - 1) / MSEC_PER_SEC))
+#define k_ms_to_ticks_ceil32(_ms) ((uint32_t)k_ms_to_ticks_ceil64(_ms))
+#define k_ticks_to_ms_floor64(_t) ((uint64_t)(_t)*MSEC_PER_SEC / CONFIG_SYS_CLOCK_TICKS_PER_SEC)
+#define k_ticks_to_ms_floor32(_t) ((uint32_t)k_ticks_to_ms_floor64(_t))
+#define k_ticks_to_us_floor64(_t) ((uint64_t)(_t)*USEC_PER_SEC / CONFIG_SYS_CLOCK_TICKS_PER_SEC)
+#define k_ticks_to_us_floor32(_t) ((uint32_t)k_ticks_to_us_floor64(_t))
+#define k_ticks_to_ns_floor64(_t) ((uint64_t)(_t)*NSEC_PER_SEC / CONFIG_SYS_CLOCK_TICKS_PER_SEC)
+
+#define k_us_to_cyc_ceil32(_us) ((uint32_t)((uint64_t)(_us)*NSEC_PER_USEC))
+#define k_cyc_to_ns_floor64(_c) ((uint64_t)(_c))
+#define k_cyc_to_us_floor32(_c) ((uint32_t)((uint64_t)(_c) / NSEC_PER_USEC))
+
+/**
+ * @brief Time since the first call of the kernel (or of the program).
+ */
+int64_t k_uptime_ticks(void);
+int64_t k_uptime_get(void);
+uint32_t k_uptime_get_32(void);
+uint32_t k_cycle_get_32(void);
+uint64_t k_cycle_get_64(void);
+
+static inline uint32_t sys_clock_hw_cycles_per_sec(void) {
+  return CONFIG_SYS_CLOCK_HW_CYCLES_PER_SEC;
+}
+
+/*******************************************************************/
+/* Locks                                                           */
+/*******************************************************************/
+struct k_spinlock {
+  pthread_mutex_t mutex;
+};
+
+typedef struct {
+  int key;
+} k_spinlock_key_t;
+
+#define Z_SPINLOCK_INITIALIZER {.mutex = PTHREAD_MUTEX_INITIALIZER}
+
+static inline k_spinlock_key_t k_spin_lock(struct k_spinlock *l) {
+  pthread_mutex_lock(&l->mutex);
+  return (k_spinlock_key_t){.key = 0};
+}
+
+static inline void k_spin_unlock(struct k_spinlock *l, k_spinlock_key_t key) {
+  ARG_UNUSED(key);
+  pthread_mutex_unlock(&l->mutex);
+}
+
+/**
+ * @brief Lock out the timer thread and every other thread that locks.
+ * Nests like the Zephyr call.
+ */
+unsigned int irq_lock(void);
+void irq_unlock(unsigned int key);
+
+/**
+ * @retval true in a k_timer callback
+ */
+bool k_is_in_isr(void);
+
+/*******************************************************************/
+/* Threads                                                         */
+/*******************************************************************/
+typedef struct z_thread_stack_element {
+  char data;
+} k_thread_stack_t;
+
+typedef void (*k_thread_entry_t)(void *p1, void *p2, void *p3);
+
+struct k_thread {
+  pthread_t pthread;
+  k_thread_entry_t entry;
+  void *p1;
+  void *p2;
+  void *p3;
+  k_timeout_t delay;
+  int prio;
+  int deadline;
+  char name[32];
+};
+
+typedef struct k_thread *k_tid_t;
+
+/* Threads use the host stack size. The stack is only kept so that the
+ * framework code that passes it doesn't change. */
+#define K_KERNEL_STACK_DEFINE(_sym, _size) k_thread_stack_t _sym[_size]
+#define K_THREAD_STACK_DEFINE(_sym, _size) k_thread_stack_t _sym[_size]
+#define K_THREAD_STACK_ARRAY_DEFINE(_sym, _n, _size) k_thread_stack_t _sym[_n][_size]
+#define K_THREAD_STACK_SIZEOF(_sym) sizeof(_sym)
+
+k_tid_t k_thread_create(struct k_thread *new_thread, k_thread_stack_t *stack, size_t stack_size,
+                        k_thread_entry_t entry, void *p1, void *p2, void *p3, int prio, uint32_t options,
+                        k_timeout_t delay);
+int k_thread_join(struct k_thread *thread, k_timeout_t timeout);
+k_tid_t k_current_get(void);
+int k_thread_name_set(k_tid_t thread, const char *str);
+const char *k_thread_name_get(k_tid_t thread);
+int k_thread_priority_get(k_tid_t thread);
+void k_thread_priority_set(k_tid_t thread, int prio);
+void k_thread_deadline_set(k_tid_t thread, int deadline);
+
+int32_t k_sleep(k_timeout_t timeout);
+int32_t k_msleep(int32_t ms);
+int32_t k_usleep(int32_t us);
+void k_busy_wait(uint32_t usec_to_wait);
+void k_yield(void);
+
+/*******************************************************************/
+/* Message Queues                                                  */
+/*******************************************************************/
+/* The fields that the framework reads under the lock have the Zephyr names. */
+struct k_msgq {
+  struct k_spinlock lock;
+  pthread_cond_t changed;
+  size_t msg_size;
+  uint32_t max_msgs;
+  char *buffer_start;
+  char *buffer_end;
+  char *read_ptr;
+  char *write_ptr;
+  uint32_t used_msgs;
+};
+
+#define Z_MSGQ_INITIALIZER(_obj, _buffer, _msg_size, _max_msgs)                                                        \
+  {                                                                                                                    \
+    .lock = Z_SPINLOCK_INITIALIZER, .changed = PTHREAD_COND_INITIALIZER, .msg_size = (_msg_size),                      \
+    .max_msgs = (_max_msgs), .buffer_start = (_buffer), .buffer_end = (_buffer) + ((_max_msgs) * (_msg_size)),         \
+    .read_ptr = (_buffer), .write_ptr = (_buffer), .used_msgs = 0                                                      \
+  }
+
+#define K_MSGQ_DEFINE(_name, _msg_size, _max_msgs, _align)                                                             \
+  static char __aligned(_align) _k_msgq_buf_##_name[(_max_msgs) * (_msg_size)];                                        \
+  struct k_msgq _name = Z_MSGQ_INITIALIZER(_name, _k_msgq_buf_##_name, _msg_size, _max_msgs)
+
+void k_msgq_init(struct k_msgq *msgq, char *buffer, size_t msg_size, uint32_t max_msgs);
+
+/**
+ * @retval 0 on success, -ENOMSG if the queue is full and timeout is K_NO_WAIT,
+ * -EAGAIN if the timeout expired
+ */
+int k_msgq_put(struct k_msgq *msgq, const void *data, k_timeout_t timeout);
+
+/**
+ * @retval 0 on success, -ENOMSG if the queue is empty and timeout is K_NO_WAIT,
+ * -EAGAIN if the timeout expired
+ */
+int k_msgq_get(struct k_msgq *msgq, void *data, k_timeout_t timeout);
+int k_msgq_peek(struct k_msgq *msgq, void *data);
+void k_msgq_purge(struct k_msgq *msgq);
+uint32_t k_msgq_num_free_get(struct k_msgq *msgq);
+uint32_t k_msgq_num_used_get(struct k_msgq *msgq);
+
+/*******************************************************************/
+/* Heaps                                                           */
+/*******************************************************************/
+/* Blocks are taken from malloc. Each block is counted against the capacity
+ * with the overhead of a chunk header and 8 byte chunks, so a pool fills
+ * up at about the same number of buffers as on the target. */
+struct k_heap {
+  struct k_spinlock lock;
+  pthread_cond_t freed;
+  size_t capacity;
+  size_t used;
+};
+
+#define K_HEAP_DEFINE(_name, _bytes)                                                                                   \
+  struct k_heap _name = {.lock = Z_SPINLOCK_INITIALIZER, .freed = PTHREAD_COND_INITIALIZER, .capacity = (_bytes)}
+
+void k_heap_init(struct k_heap *h, void *mem, size_t bytes);
+void *k_heap_alloc(struct k_heap *h, size_t bytes, k_timeout_t timeout);
+void *k_heap_aligned_alloc(struct k_heap *h, size_t align, size_t bytes, k_timeout_t timeout);
+void k_heap_free(struct k_heap *h, void *mem);
+
+/*******************************************************************/
+/* Memory Slabs                                                    */
+/*******************************************************************/
+struct k_mem_slab {
+  struct k_spinlock lock;
+  pthread_cond_t freed;
+  char *buffer;
+  char *free_list;
+  size_t block_size;
+  uint32_t num_blocks;
+  uint32_t num_used;
+};
+
+/**
+ * @retval 0 on success, -EINVAL if the block size isn't a multiple of a pointer
+ */
+int k_mem_slab_init(struct k_mem_slab *slab, void *buffer, size_t block_size, uint32_t num_blocks);
+
+/**
+ * @retval 0 on success, -ENOMEM if the slab is empty and timeout is K_NO_WAIT,
+ * -EAGAIN if the timeout expired
+ */
+int k_mem_slab_alloc(struct k_mem_slab *slab, void **mem, k_timeout_t timeout);
+void k_mem_slab_free(struct k_mem_slab *slab, void *mem);
+uint32_t k_mem_slab_num_used_get(struct k_mem_slab *slab);
+uint32_t k_mem_slab_num_free_get(struct k_mem_slab *slab);
+
+/*******************************************************************/
+/* Semaphores                                                      */
+/*******************************************************************/
+struct k_sem {
+  pthread_mutex_t mutex;
+  pthread_cond_t given;
+  unsigned int count;
+  unsigned int limit;
+};
+
+#define K_SEM_MAX_LIMIT UINT32_MAX
+
+#define Z_SEM_INITIALIZER(_initial_count, _count_limit)                                                                \
+  {                                                                                                                    \
+    .mutex = PTHREAD_MUTEX_INITIALIZER, .given = PTHREAD_COND_INITIALIZER, .count = (_initial_count),                  \
+    .limit = (_count_limit)                                                                                            \
+  }
+
+#define K_SEM_DEFINE(_name, _initial_count, _count_limit)                                                              \
+  struct k_sem _name = Z_SEM_INITIALIZER(_initial_count, _count_limit)
+
+int k_sem_init(struct k_sem *sem, unsigned int initial_count, unsigned int limit);
+void k_sem_give(struct k_sem *sem);
+
+/**
+ * @retval 0 on success, -EBUSY if timeout is K_NO_WAIT, -EAGAIN if the timeout expired
+ */
+int k_sem_take(struct k_sem *sem, k_timeout_t timeout);
+void k_sem_reset(struct k_sem *sem);
+unsigned int k_sem_count_get(struct k_sem *sem);
+
+/*******************************************************************/
+/* Timers                                                          */
+/*******************************************************************/
+struct k_timer;
+typedef void (*k_timer_expiry_t)(struct k_timer *timer);
+typedef void (*k_timer_stop_t)(struct k_timer *timer);
+
+struct k_timer {
+  struct k_timer *p_next; /* in the list of running timers */
+  bool running;
+  uint64_t expiry_ns;
+  k_timeout_t period;
+  k_timer_expiry_t expiry_fn;
+  k_timer_stop_t stop_fn;
+  uint32_t status;
+  void *user_data;
+};
+
+void k_timer_init(struct k_timer *timer, k_timer_expiry_t expiry_fn, k_timer_stop_t stop_fn);
+void k_timer_start(struct k_timer *timer, k_timeout_t duration, k_timeout_t period);
+void k_timer_stop(struct k_timer *timer);
+uint32_t k_timer_status_get(struct k_timer *timer);
+uint32_t k_timer_remaining_get(struct k_timer *timer);
+
+static inline void k_timer_user_data_set(struct k_timer *timer, void *user_data) {
+  timer->user_data = user_data;
+}
+
+static inline void *k_timer_user_data_get(const struct k_timer *timer) {
+  return timer->user_data;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POSIX_ZEPHYR_KERNEL_H__ */
@@ -0,0 +1,50 @@
+/**
+ * @file log.h
+ * @brief Logging for the POSIX port of the framework.
+ *
+ * Messages are written to stderr when their level is at or below the level
+ * of the module and CONFIG_LOG_MAX_LEVEL.
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#ifndef __POSIX_ZEPHYR_LOGGING_LOG_H__
+#define __POSIX_ZEPHYR_LOGGING_LOG_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERR 1
+#define LOG_LEVEL_WRN 2
+#define LOG_LEVEL_INF 3
+#define LOG_LEVEL_DBG 4
+
+#define Z_LOG_MODULE_REGISTER(_name, _level, ...)                                                                      \
+  static const char *const __log_name __attribute__((__unused__)) = #_name;                                            \
+  static const int __log_level __attribute__((__unused__)) =                                                           \
+      ((_level) < CONFIG_LOG_MAX_LEVEL) ? (_level) : CONFIG_LOG_MAX_LEVEL
+
+/* The level is optional, as in Zephyr */
+#define LOG_MODULE_REGISTER(...) Z_LOG_MODULE_REGISTER(__VA_ARGS__, CONFIG_LOG_DEFAULT_LEVEL)
+#define LOG_MODULE_DECLARE(...) Z_LOG_MODULE_REGISTER(__VA_ARGS__, CONFIG_LOG_DEFAULT_LEVEL)
+
+void posix_log(int level, const char *p_module, const char *p_fmt, ...);
+
+#define Z_LOG(_level, ...)                                                                                             \
+  do {                                                                                                                 \
+    if ((_level) <= __log_level) {                                                                                     \
+      posix_log((_level), __log_name, __VA_ARGS__);                                                                    \
+    }                                                                                                                  \
+  } while (0)
+
+#define LOG_ERR(...) Z_LOG(LOG_LEVEL_ERR, __VA_ARGS__)
+#define LOG_WRN(...) Z_LOG(LOG_LEVEL_WRN, __VA_ARGS__)
+#define LOG_INF(...) Z_LOG(LOG_LEVEL_INF, __VA_ARGS__)
+#define LOG_DBG(...) Z_LOG(LOG_LEVEL_DBG, __VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POSIX_ZEPHYR_LOGGING_LOG_H__ */
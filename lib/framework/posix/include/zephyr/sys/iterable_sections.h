@@ -0,0 +1,40 @@
+/**
+ * @file iterable_sections.h
+ * @brief Iterable sections for the POSIX port of the framework.
+ *
+ * The objects of a type are placed in an ELF section named after the type.
+ * The GNU linker defines __start_ and __stop_ symbols for sections that have
+ * the name of a C identifier, so a linker script isn't needed. The symbols
+ * are weak so that a type without objects can still be iterated.
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#ifndef __POSIX_ZEPHYR_SYS_ITERABLE_SECTIONS_H__
+#define __POSIX_ZEPHYR_SYS_ITERABLE_SECTIONS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STRUCT_SECTION_ITERABLE(_struct_type, _varname)                                                                \
+  struct _struct_type _varname __attribute__((__section__("_" #_struct_type "_list"), __used__,                        \
+                                              __aligned__(__alignof__(struct _struct_type))))
+
+#define STRUCT_SECTION_FOREACH(_struct_type, _iterator)                                                                \
+  extern struct _struct_type __start__##_struct_type##_list[] __attribute__((__weak__));                               \
+  extern struct _struct_type __stop__##_struct_type##_list[] __attribute__((__weak__));                                \
+  for (struct _struct_type *_iterator = __start__##_struct_type##_list;                                                \
+       _iterator < __stop__##_struct_type##_list; _iterator++)
+
+#define STRUCT_SECTION_COUNT(_struct_type, _dst)                                                                       \
+  do {                                                                                                                 \
+    extern struct _struct_type __start__##_struct_type##_list[] __attribute__((__weak__));                             \
+    extern struct _struct_type __stop__##_struct_type##_list[] __attribute__((__weak__));                              \
+    *(_dst) = __stop__##_struct_type##_list - __start__##_struct_type##_list;                                          \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POSIX_ZEPHYR_SYS_ITERABLE_SECTIONS_H__ */
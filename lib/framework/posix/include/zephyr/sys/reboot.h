@@ -0,0 +1,29 @@
+/**
+ * @file reboot.h
+ * @brief sys_reboot for the POSIX port of the framework.
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#ifndef __POSIX_ZEPHYR_SYS_REBOOT_H__
+#define __POSIX_ZEPHYR_SYS_REBOOT_H__
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_REBOOT_WARM 0
+#define SYS_REBOOT_COLD 1
+
+/* A reboot ends the program (and leaves a core file for the debugger). */
+static inline void sys_reboot(int type) {
+  (void)type;
+  abort();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POSIX_ZEPHYR_SYS_REBOOT_H__ */
@@ -0,0 +1,71 @@
+/**
+ * @file util.h
+ * @brief Utility macros of the Zephyr API for the POSIX port of the framework.
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#ifndef __POSIX_ZEPHYR_SYS_UTIL_H__
+#define __POSIX_ZEPHYR_SYS_UTIL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BIT(n) (1UL << (n))
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define CONTAINER_OF(ptr, type, field) ((type *)(((char *)(ptr)) - offsetof(type, field)))
+#define ARG_UNUSED(x) (void)(x)
+
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+#define CLAMP(val, low, high) (((val) <= (low)) ? (low) : MIN(val, high))
+
+#define ROUND_UP(x, align) ((((size_t)(x) + ((size_t)(align) - 1)) / (size_t)(align)) * (size_t)(align))
+#define IS_POWER_OF_TWO(x) (((x) != 0U) && (((x) & ((x)-1U)) == 0U))
+#define POPCOUNT(x) __builtin_popcount(x)
+
+#define BUILD_ASSERT(expr, ...) _Static_assert(expr, "" __VA_ARGS__)
+
+#define __packed __attribute__((__packed__))
+#define __aligned(x) __attribute__((__aligned__(x)))
+#define __weak __attribute__((__weak__))
+#define __used __attribute__((__used__))
+#define __noinit
+#define CODE_UNREACHABLE __builtin_unreachable()
+
+#define __ASSERT(test, fmt, ...)                                                                                       \
+  do {                                                                                                                 \
+    if (!(test)) {                                                                                                     \
+      posix_assert_post_action(__FILE__, __LINE__);                                                                    \
+    }                                                                                                                  \
+  } while (0)
+
+void posix_assert_post_action(const char *file, unsigned int line);
+
+/**
+ * @return 1 + the index of the least significant bit set, 0 if none is set
+ */
+static inline unsigned int find_lsb_set(uint32_t op) {
+  return (unsigned int)__builtin_ffs((int)op);
+}
+
+/**
+ * @return 1 + the index of the most significant bit set, 0 if none is set
+ */
+static inline unsigned int find_msb_set(uint32_t op) {
+  return (op == 0) ? 0 : (32 - (unsigned int)__builtin_clz(op));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POSIX_ZEPHYR_SYS_UTIL_H__ */
@@ -0,0 +1,320 @@
+/**
+ * @file msg_bench.c
+ * @brief Microbenchmark of the host build of the framework.
+ *
+ * Measures the cost of sending a message from a producer to message tasks
+ * (send, route, queue, dispatch and free) and of the buffer pool.
+ * The time per message is the wall time of the whole run divided by the
+ * number of messages, so it includes the hand-off between threads.
+ *
+ * Usage: msg_bench [messages]
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <framework/buffer_pool.h>
+#include <framework/sys_core.h>
+#include <framework/sys_msg.h>
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+#define BENCH_DEFAULT_MESSAGES 200000
+#define BENCH_PRODUCERS 4
+#define BENCH_PAYLOAD_SIZE 16
+#define BENCH_POOL_SIZES 5
+
+/* Receivers */
+#define BENCH_ID_SINK 1
+#define BENCH_ID_SUBSCRIBER_1 2
+#define BENCH_ID_SUBSCRIBER_2 3
+#define BENCH_ID_PRODUCER 4
+
+/* Codes */
+#define BENCH_CODE_DATA (SMC_APP_SPECIFIC_START + 32)
+#define BENCH_CODE_EVENT (SMC_APP_SPECIFIC_START + 33)
+
+struct bench_result {
+  uint64_t ns;
+  uint32_t retries; /* times the producer yielded because a queue or the pool was full */
+};
+
+/**************************************************************/
+/* Local Function Prototypes                                  */
+/**************************************************************/
+static dispatch_result_t count_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg);
+static uint64_t time_ns(void);
+static void expect(uint32_t count);
+static void wait_done(void);
+static msg_buf_t *take_msg(msg_code_t code, uint32_t *p_retries);
+static void wait_for_space(mid_t rx_id, uint32_t *p_retries);
+static uint32_t send_msgs(uint32_t count);
+static void producer_thread(void *p_arg1, void *p_arg2, void *p_arg3);
+static void bench_unicast(uint32_t count, struct bench_result *p_result);
+#ifdef CONFIG_SYS_MSG_INLINE
+static void bench_inline(uint32_t count, struct bench_result *p_result);
+#endif
+static void bench_broadcast(uint32_t count, struct bench_result *p_result);
+static void bench_producers(uint32_t count, struct bench_result *p_result);
+static void bench_pool(uint32_t count, void *(*take)(size_t size), struct bench_result *p_result);
+static void report(const char *p_name, uint32_t count, const struct bench_result *p_result);
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+MSG_DISPATCHER_DEFINE(sink_msg_dispatcher, MSG_HANDLER(BENCH_CODE_DATA, count_msg_handler),
+                      MSG_HANDLER(BENCH_CODE_EVENT, count_msg_handler));
+MSG_DISPATCHER_DEFINE(subscriber_msg_dispatcher, MSG_HANDLER(BENCH_CODE_EVENT, count_msg_handler));
+
+MSG_TASK_DEFINE(sink_task, BENCH_ID_SINK, 1, 1024, MSG_TASK_QUEUE_DEPTH, sink_msg_dispatcher);
+MSG_TASK_DEFINE(subscriber_1_task, BENCH_ID_SUBSCRIBER_1, 1, 1024, MSG_TASK_QUEUE_DEPTH, subscriber_msg_dispatcher);
+MSG_TASK_DEFINE(subscriber_2_task, BENCH_ID_SUBSCRIBER_2, 1, 1024, MSG_TASK_QUEUE_DEPTH, subscriber_msg_dispatcher);
+
+static atomic_t handled;
+static atomic_t expected;
+static K_SEM_DEFINE(done, 0, 1);
+
+static struct k_thread producers[BENCH_PRODUCERS];
+static K_THREAD_STACK_ARRAY_DEFINE(producer_stacks, BENCH_PRODUCERS, 1024);
+static atomic_t producer_retries;
+
+static const size_t pool_sizes[BENCH_POOL_SIZES] = {8, 16, 32, 64, 128};
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+int main(int argc, char *argv[]) {
+  uint32_t count = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_MESSAGES;
+  struct bench_result result;
+
+  if (count == 0) {
+    fprintf(stderr, "usage: %s [messages]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("messages: %u pool: %u bytes receivers: %u\n", count, CONFIG_BUFFER_POOL_SIZE, CONFIG_SYS_MAX_MSG_RECEIVES);
+  printf("%-12s %12s %10s %12s\n", "benchmark", "ns/msg", "msgs/s", "retries");
+
+  bench_unicast(count, &result);
+  report("unicast", count, &result);
+
+#ifdef CONFIG_SYS_MSG_INLINE
+  bench_inline(count, &result);
+  report("inline", count, &result);
+#endif
+
+  bench_broadcast(count, &result);
+  report("broadcast", count, &result);
+
+  bench_producers(count, &result);
+  report("producers", count, &result);
+
+  bench_pool(count, buffer_pool_take, &result);
+  report("pool", count, &result);
+
+  bench_pool(count, buffer_pool_take_uninit, &result);
+  report("pool uninit", count, &result);
+
+  /* The message tasks don't return */
+  return EXIT_SUCCESS;
+}
+
+/**************************************************************/
+/* Local Function Definitions                                 */
+/**************************************************************/
+static dispatch_result_t count_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg) {
+  UNUSED_PARAMETER(p_msg_rxer);
+  UNUSED_PARAMETER(p_msg);
+
+  if ((atomic_inc(&handled) + 1) == atomic_get(&expected)) {
+    k_sem_give(&done);
+  }
+  return DISPATCH_OK;
+}
+
+static uint64_t time_ns(void) {
+  return k_cycle_get_64();
+}
+
+/**
+ * @brief Set the number of messages that the tasks will handle in a run.
+ */
+static void expect(uint32_t count) {
+  k_sem_reset(&done);
+  atomic_clear(&handled);
+  atomic_set(&expected, (atomic_val_t)count);
+}
+
+static void wait_done(void) {
+  if (k_sem_take(&done, K_SECONDS(60)) != 0) {
+    fprintf(stderr, "timeout: %ld of %ld messages handled\n", atomic_get(&handled), atomic_get(&expected));
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * @brief Take a message from the pool, waiting for the tasks to free one
+ * if it is empty.
+ */
+static msg_buf_t *take_msg(msg_code_t code, uint32_t *p_retries) {
+  msg_buf_t *p_msg;
+
+  while ((p_msg = buffer_pool_try_to_take(MSG_BUF_SIZE(msg_buf_t, BENCH_PAYLOAD_SIZE), BP_CONTEXT_UNUSED)) == NULL) {
+    *p_retries += 1;
+    k_yield();
+  }
+  p_msg->header.msg_code = code;
+  p_msg->header.tx_id = BENCH_ID_PRODUCER;
+  p_msg->size = BENCH_PAYLOAD_SIZE;
+  return p_msg;
+}
+
+/**
+ * @brief Wait until a queue has space, so that a send that can't wait
+ * doesn't fail (and log). Only used with a single producer.
+ */
+static void wait_for_space(mid_t rx_id, uint32_t *p_retries) {
+  while (msg_queue_count(rx_id) >= MSG_TASK_QUEUE_DEPTH) {
+    *p_retries += 1;
+    k_yield();
+  }
+}
+
+/**
+ * @brief Send messages to the sink, waiting when its queue is full.
+ *
+ * @retval number of retries
+ */
+static uint32_t send_msgs(uint32_t count) {
+  uint32_t retries = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    msg_buf_t *p_msg = take_msg(BENCH_CODE_DATA, &retries);
+    if (msg_send_with_policy(BENCH_ID_SINK, (msg_t *)p_msg, MSG_POLICY_BLOCK, K_FOREVER) != SYS_SUCCESS) {
+      fprintf(stderr, "send failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return retries;
+}
+
+static void producer_thread(void *p_arg1, void *p_arg2, void *p_arg3) {
+  UNUSED_PARAMETER(p_arg2);
+  UNUSED_PARAMETER(p_arg3);
+
+  atomic_add(&producer_retries, (atomic_val_t)send_msgs((uint32_t)(uintptr_t)p_arg1));
+}
+
+/**
+ * @brief One producer sends buffer pool messages to one task.
+ */
+static void bench_unicast(uint32_t count, struct bench_result *p_result) {
+  expect(count);
+  uint64_t start = time_ns();
+  p_result->retries = send_msgs(count);
+  wait_done();
+  p_result->ns = time_ns() - start;
+}
+
+#ifdef CONFIG_SYS_MSG_INLINE
+/**
+ * @brief One producer sends header-only messages to one task (no allocation).
+ */
+static void bench_inline(uint32_t count, struct bench_result *p_result) {
+  p_result->retries = 0;
+
+  expect(count);
+  uint64_t start = time_ns();
+  for (uint32_t i = 0; i < count; i++) {
+    wait_for_space(BENCH_ID_SINK, &p_result->retries);
+    if (msg_send_inline(BENCH_ID_SINK, BENCH_ID_PRODUCER, BENCH_CODE_DATA, MSG_OPTION_NONE) != SYS_SUCCESS) {
+      fprintf(stderr, "send failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  wait_done();
+  p_result->ns = time_ns() - start;
+}
+#endif
+
+/**
+ * @brief One producer broadcasts a shared buffer to three tasks.
+ * The time is per broadcast.
+ */
+static void bench_broadcast(uint32_t count, struct bench_result *p_result) {
+  p_result->retries = 0;
+
+  expect(count * 3);
+  uint64_t start = time_ns();
+  for (uint32_t i = 0; i < count; i++) {
+    msg_buf_t *p_msg = take_msg(BENCH_CODE_EVENT, &p_result->retries);
+    /* A subscriber with a full queue would be skipped */
+    wait_for_space(BENCH_ID_SINK, &p_result->retries);
+    wait_for_space(BENCH_ID_SUBSCRIBER_1, &p_result->retries);
+    wait_for_space(BENCH_ID_SUBSCRIBER_2, &p_result->retries);
+    if (msg_broadcast((msg_t *)p_msg, 0) != SYS_SUCCESS) {
+      buffer_pool_free(p_msg);
+      fprintf(stderr, "broadcast failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  wait_done();
+  p_result->ns = time_ns() - start;
+}
+
+/**
+ * @brief Several producer threads send buffer pool messages to one task.
+ */
+static void bench_producers(uint32_t count, struct bench_result *p_result) {
+  uint32_t per_producer = count / BENCH_PRODUCERS;
+
+  atomic_clear(&producer_retries);
+  expect(per_producer * BENCH_PRODUCERS);
+  uint64_t start = time_ns();
+  for (int i = 0; i < BENCH_PRODUCERS; i++) {
+    k_thread_create(&producers[i], producer_stacks[i], K_THREAD_STACK_SIZEOF(producer_stacks[i]), producer_thread,
+                    (void *)(uintptr_t)per_producer, NULL, NULL, 1, 0, K_NO_WAIT);
+  }
+  for (int i = 0; i < BENCH_PRODUCERS; i++) {
+    k_thread_join(&producers[i], K_FOREVER);
+  }
+  wait_done();
+  p_result->ns = time_ns() - start;
+  p_result->retries = (uint32_t)atomic_get(&producer_retries);
+}
+
+/**
+ * @brief Take and free buffers of several sizes in one thread.
+ * The time is per take and free.
+ *
+ * @param take buffer_pool_take or buffer_pool_take_uninit
+ */
+static void bench_pool(uint32_t count, void *(*take)(size_t size), struct bench_result *p_result) {
+  void *p_buffers[BENCH_POOL_SIZES];
+
+  p_result->retries = 0;
+
+  uint64_t start = time_ns();
+  for (uint32_t i = 0; i < count; i += BENCH_POOL_SIZES) {
+    for (int j = 0; j < BENCH_POOL_SIZES; j++) {
+      p_buffers[j] = take(pool_sizes[j]);
+      if (p_buffers[j] == NULL) {
+        p_result->retries += 1;
+      }
+    }
+    for (int j = 0; j < BENCH_POOL_SIZES; j++) {
+      if (p_buffers[j] != NULL) {
+        buffer_pool_free(p_buffers[j]);
+      }
+    }
+  }
+  p_result->ns = time_ns() - start;
+}
+
+static void report(const char *p_name, uint32_t count, const struct bench_result *p_result) {
+  double ns_per_msg = (double)p_result->ns / count;
+
+  printf("%-12s %12.1f %10.0f %12u\n", p_name, ns_per_msg, NSEC_PER_SEC / ns_per_msg, p_result->retries);
+}
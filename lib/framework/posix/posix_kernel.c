@@ -0,0 +1,674 @@
+/**
+ * @file posix_kernel.c
+ * @brief Kernel services of the host build of the framework (see zephyr/kernel.h).
+ *
+ * Copyright (c) 2023 SEED FIC
+ */
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+/**************************************************************/
+/* Local Constant, Macro and Type Definitions                 */
+/**************************************************************/
+/* Allocation unit and header of a k_heap chunk */
+#define HEAP_CHUNK_UNIT 8
+#define HEAP_CHUNK_HEADER 8
+
+/* Keeps the block size in front of a heap block. The size of the prefix is
+ * a multiple of the alignment of malloc so that blocks stay aligned. */
+union heap_prefix {
+  size_t size;
+  max_align_t align;
+};
+
+/**************************************************************/
+/* Local Data Definitions                                     */
+/**************************************************************/
+static pthread_mutex_t irq_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+static uint64_t start_ns;
+
+static __thread struct k_thread *p_current_thread;
+static __thread struct k_thread native_thread; /* of threads that weren't created with k_thread_create */
+static __thread bool in_isr;
+
+static pthread_mutex_t timer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_changed = PTHREAD_COND_INITIALIZER;
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static struct k_timer *p_timers; /* running timers */
+
+static const char *const level_names[] = {"", "err", "wrn", "inf", "dbg"};
+
+/**************************************************************/
+/* Local Function Prototypes                                  */
+/**************************************************************/
+static void start_time_init(void);
+static uint64_t now_ns(void);
+static uint64_t timeout_to_ns(k_timeout_t timeout);
+static int wait_until(pthread_cond_t *p_cond, pthread_mutex_t *p_mutex, k_timeout_t timeout, uint64_t deadline_ns);
+static uint64_t deadline_of(k_timeout_t timeout);
+static void *thread_entry(void *p_arg);
+static void timer_thread_start(void);
+static void *timer_thread(void *p_arg);
+static void timer_unlink(struct k_timer *timer);
+
+/**************************************************************/
+/* Global Function Definitions                                */
+/**************************************************************/
+int64_t k_uptime_ticks(void) {
+  return (int64_t)(now_ns() / (NSEC_PER_SEC / CONFIG_SYS_CLOCK_TICKS_PER_SEC));
+}
+
+int64_t k_uptime_get(void) {
+  return (int64_t)(now_ns() / (NSEC_PER_SEC / MSEC_PER_SEC));
+}
+
+uint32_t k_uptime_get_32(void) {
+  return (uint32_t)k_uptime_get();
+}
+
+uint32_t k_cycle_get_32(void) {
+  return (uint32_t)now_ns();
+}
+
+uint64_t k_cycle_get_64(void) {
+  return now_ns();
+}
+
+unsigned int irq_lock(void) {
+  pthread_mutex_lock(&irq_mutex);
+  return 0;
+}
+
+void irq_unlock(unsigned int key) {
+  ARG_UNUSED(key);
+  pthread_mutex_unlock(&irq_mutex);
+}
+
+bool k_is_in_isr(void) {
+  return in_isr;
+}
+
+void posix_assert_post_action(const char *file, unsigned int line) {
+  fprintf(stderr, "ASSERTION FAIL @ %s:%u\n", file, line);
+  abort();
+}
+
+void posix_log(int level, const char *p_module, const char *p_fmt, ...) {
+  va_list args;
+
+  flockfile(stderr);
+  fprintf(stderr, "<%s> %s: ", level_names[CLAMP(level, 0, LOG_LEVEL_DBG)], p_module);
+  va_start(args, p_fmt);
+  vfprintf(stderr, p_fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+  funlockfile(stderr);
+}
+
+/*
+ * Threads
+ */
+k_tid_t k_thread_create(struct k_thread *new_thread, k_thread_stack_t *stack, size_t stack_size,
+                        k_thread_entry_t entry, void *p1, void *p2, void *p3, int prio, uint32_t options,
+                        k_timeout_t delay) {
+  ARG_UNUSED(stack);
+  ARG_UNUSED(stack_size);
+  ARG_UNUSED(options);
+
+  new_thread->entry = entry;
+  new_thread->p1 = p1;
+  new_thread->p2 = p2;
+  new_thread->p3 = p3;
+  new_thread->delay = delay;
+  new_thread->prio = prio;
+  new_thread->name[0] = '\0';
+
+  if (pthread_create(&new_thread->pthread, NULL, thread_entry, new_thread) != 0) {
+    posix_assert_post_action(__FILE__, __LINE__);
+  }
+  return new_thread;
+}
+
+int k_thread_join(struct k_thread *thread, k_timeout_t timeout) {
+  ARG_UNUSED(timeout);
+  return (pthread_join(thread->pthread, NULL) == 0) ? 0 : -EINVAL;
+}
+
+k_tid_t k_current_get(void) {
+  if (p_current_thread == NULL) {
+    native_thread.pthread = pthread_self();
+    p_current_thread = &native_thread;
+  }
+  return p_current_thread;
+}
+
+int k_thread_name_set(k_tid_t thread, const char *str) {
+  char name[16];
+
+  strncpy(thread->name, str, sizeof(thread->name) - 1);
+  thread->name[sizeof(thread->name) - 1] = '\0';
+  /* Linux limits thread names to 15 characters */
+  strncpy(name, str, sizeof(name) - 1);
+  name[sizeof(name) - 1] = '\0';
+  (void)pthread_setname_np(thread->pthread, name);
+  return 0;
+}
+
+const char *k_thread_name_get(k_tid_t thread) {
+  return thread->name;
+}
+
+int k_thread_priority_get(k_tid_t thread) {
+  return thread->prio;
+}
+
+void k_thread_priority_set(k_tid_t thread, int prio) {
+  thread->prio = prio;
+}
+
+void k_thread_deadline_set(k_tid_t thread, int deadline) {
+  thread->deadline = deadline;
+}
+
+int32_t k_sleep(k_timeout_t timeout) {
+  if (K_TIMEOUT_EQ(timeout, K_FOREVER)) {
+    while (true) {
+      pause();
+    }
+  }
+
+  uint64_t ns = timeout_to_ns(timeout);
+  struct timespec ts = {.tv_sec = (time_t)(ns / NSEC_PER_SEC), .tv_nsec = (long)(ns % NSEC_PER_SEC)};
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR) {
+  }
+  return 0;
+}
+
+int32_t k_msleep(int32_t ms) {
+  return k_sleep(K_MSEC(ms));
+}
+
+int32_t k_usleep(int32_t us) {
+  return k_sleep(K_USEC(us));
+}
+
+void k_busy_wait(uint32_t usec_to_wait) {
+  uint64_t end = now_ns() + ((uint64_t)usec_to_wait * NSEC_PER_USEC);
+
+  while (now_ns() < end) {
+  }
+}
+
+void k_yield(void) {
+  sched_yield();
+}
+
+/*
+ * Message Queues
+ */
+void k_msgq_init(struct k_msgq *msgq, char *buffer, size_t msg_size, uint32_t max_msgs) {
+  *msgq = (struct k_msgq)Z_MSGQ_INITIALIZER(*msgq, buffer, msg_size, max_msgs);
+}
+
+int k_msgq_put(struct k_msgq *msgq, const void *data, k_timeout_t timeout) {
+  uint64_t deadline = deadline_of(timeout);
+  int result = 0;
+
+  k_spinlock_key_t key = k_spin_lock(&msgq->lock);
+  while (msgq->used_msgs >= msgq->max_msgs && result == 0) {
+    result = wait_until(&msgq->changed, &msgq->lock.mutex, timeout, deadline);
+  }
+  if (result == 0) {
+    memcpy(msgq->write_ptr, data, msgq->msg_size);
+    msgq->write_ptr += msgq->msg_size;
+    if (msgq->write_ptr == msgq->buffer_end) {
+      msgq->write_ptr = msgq->buffer_start;
+    }
+    msgq->used_msgs += 1;
+    pthread_cond_broadcast(&msgq->changed);
+  }
+  k_spin_unlock(&msgq->lock, key);
+
+  return (result == -EBUSY) ? -ENOMSG : result;
+}
+
+int k_msgq_get(struct k_msgq *msgq, void *data, k_timeout_t timeout) {
+  uint64_t deadline = deadline_of(timeout);
+  int result = 0;
+
+  k_spinlock_key_t key = k_spin_lock(&msgq->lock);
+  while (msgq->used_msgs == 0 && result == 0) {
+    result = wait_until(&msgq->changed, &msgq->lock.mutex, timeout, deadline);
+  }
+  if (result == 0) {
+    memcpy(data, msgq->read_ptr, msgq->msg_size);
+    msgq->read_ptr += msgq->msg_size;
+    if (msgq->read_ptr == msgq->buffer_end) {
+      msgq->read_ptr = msgq->buffer_start;
+    }
+    msgq->used_msgs -= 1;
+    pthread_cond_broadcast(&msgq->changed);
+  }
+  k_spin_unlock(&msgq->lock, key);
+
+  return (result == -EBUSY) ? -ENOMSG : result;
+}
+
+int k_msgq_peek(struct k_msgq *msgq, void *data) {
+  int result = -ENOMSG;
+
+  k_spinlock_key_t key = k_spin_lock(&msgq->lock);
+  if (msgq->used_msgs != 0) {
+    memcpy(data, msgq->read_ptr, msgq->msg_size);
+    result = 0;
+  }
+  k_spin_unlock(&msgq->lock, key);
+  return result;
+}
+
+void k_msgq_purge(struct k_msgq *msgq) {
+  k_spinlock_key_t key = k_spin_lock(&msgq->lock);
+  msgq->read_ptr = msgq->write_ptr;
+  msgq->used_msgs = 0;
+  pthread_cond_broadcast(&msgq->changed);
+  k_spin_unlock(&msgq->lock, key);
+}
+
+uint32_t k_msgq_num_free_get(struct k_msgq *msgq) {
+  k_spinlock_key_t key = k_spin_lock(&msgq->lock);
+  uint32_t result = msgq->max_msgs - msgq->used_msgs;
+  k_spin_unlock(&msgq->lock, key);
+  return result;
+}
+
+uint32_t k_msgq_num_used_get(struct k_msgq *msgq) {
+  k_spinlock_key_t key = k_spin_lock(&msgq->lock);
+  uint32_t result = msgq->used_msgs;
+  k_spin_unlock(&msgq->lock, key);
+  return result;
+}
+
+/*
+ * Heaps
+ */
+void k_heap_init(struct k_heap *h, void *mem, size_t bytes) {
+  ARG_UNUSED(mem);
+
+  *h = (struct k_heap){.lock = Z_SPINLOCK_INITIALIZER, .freed = PTHREAD_COND_INITIALIZER, .capacity = bytes};
+}
+
+void *k_heap_alloc(struct k_heap *h, size_t bytes, k_timeout_t timeout) {
+  return k_heap_aligned_alloc(h, sizeof(void *), bytes, timeout);
+}
+
+void *k_heap_aligned_alloc(struct k_heap *h, size_t align, size_t bytes, k_timeout_t timeout) {
+  size_t chunk = ROUND_UP(bytes + HEAP_CHUNK_HEADER, HEAP_CHUNK_UNIT);
+  uint64_t deadline = deadline_of(timeout);
+  int result = 0;
+
+  if (align > sizeof(union heap_prefix) || bytes == 0) {
+    return NULL;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&h->lock);
+  while ((h->used + chunk) > h->capacity && result == 0) {
+    result = wait_until(&h->freed, &h->lock.mutex, timeout, deadline);
+  }
+  if (result == 0) {
+    h->used += chunk;
+  }
+  k_spin_unlock(&h->lock, key);
+
+  if (result != 0) {
+    return NULL;
+  }
+
+  union heap_prefix *p_prefix = malloc(sizeof(union heap_prefix) + bytes);
+  if (p_prefix == NULL) {
+    key = k_spin_lock(&h->lock);
+    h->used -= chunk;
+    k_spin_unlock(&h->lock, key);
+    return NULL;
+  }
+  p_prefix->size = chunk;
+  return p_prefix + 1;
+}
+
+void k_heap_free(struct k_heap *h, void *mem) {
+  if (mem == NULL) {
+    return;
+  }
+
+  union heap_prefix *p_prefix = (union heap_prefix *)mem - 1;
+  size_t chunk = p_prefix->size;
+
+  free(p_prefix);
+
+  k_spinlock_key_t key = k_spin_lock(&h->lock);
+  h->used -= chunk;
+  pthread_cond_broadcast(&h->freed);
+  k_spin_unlock(&h->lock, key);
+}
+
+/*
+ * Memory Slabs
+ */
+int k_mem_slab_init(struct k_mem_slab *slab, void *buffer, size_t block_size, uint32_t num_blocks) {
+  if (block_size < sizeof(void *) || (block_size % sizeof(void *)) != 0) {
+    return -EINVAL;
+  }
+
+  *slab = (struct k_mem_slab){.lock = Z_SPINLOCK_INITIALIZER,
+                              .freed = PTHREAD_COND_INITIALIZER,
+                              .buffer = buffer,
+                              .block_size = block_size,
+                              .num_blocks = num_blocks};
+  /* Each free block holds a pointer to the next one */
+  for (uint32_t i = 0; i < num_blocks; i++) {
+    char *p_block = slab->buffer + (i * block_size);
+    *(char **)p_block = slab->free_list;
+    slab->free_list = p_block;
+  }
+  return 0;
+}
+
+int k_mem_slab_alloc(struct k_mem_slab *slab, void **mem, k_timeout_t timeout) {
+  uint64_t deadline = deadline_of(timeout);
+  int result = 0;
+
+  k_spinlock_key_t key = k_spin_lock(&slab->lock);
+  while (slab->free_list == NULL && result == 0) {
+    result = wait_until(&slab->freed, &slab->lock.mutex, timeout, deadline);
+  }
+  if (result == 0) {
+    *mem = slab->free_list;
+    slab->free_list = *(char **)slab->free_list;
+    slab->num_used += 1;
+  } else {
+    *mem = NULL;
+  }
+  k_spin_unlock(&slab->lock, key);
+
+  return (result == -EBUSY) ? -ENOMEM : result;
+}
+
+void k_mem_slab_free(struct k_mem_slab *slab, void *mem) {
+  k_spinlock_key_t key = k_spin_lock(&slab->lock);
+  *(char **)mem = slab->free_list;
+  slab->free_list = mem;
+  slab->num_used -= 1;
+  pthread_cond_signal(&slab->freed);
+  k_spin_unlock(&slab->lock, key);
+}
+
+uint32_t k_mem_slab_num_used_get(struct k_mem_slab *slab) {
+  return slab->num_used;
+}
+
+uint32_t k_mem_slab_num_free_get(struct k_mem_slab *slab) {
+  return slab->num_blocks - slab->num_used;
+}
+
+/*
+ * Semaphores
+ */
+int k_sem_init(struct k_sem *sem, unsigned int initial_count, unsigned int limit) {
+  if (limit == 0 || initial_count > limit) {
+    return -EINVAL;
+  }
+  *sem = (struct k_sem)Z_SEM_INITIALIZER(initial_count, limit);
+  return 0;
+}
+
+void k_sem_give(struct k_sem *sem) {
+  pthread_mutex_lock(&sem->mutex);
+  if (sem->count < sem->limit) {
+    sem->count += 1;
+  }
+  pthread_cond_signal(&sem->given);
+  pthread_mutex_unlock(&sem->mutex);
+}
+
+int k_sem_take(struct k_sem *sem, k_timeout_t timeout) {
+  uint64_t deadline = deadline_of(timeout);
+  int result = 0;
+
+  pthread_mutex_lock(&sem->mutex);
+  while (sem->count == 0 && result == 0) {
+    result = wait_until(&sem->given, &sem->mutex, timeout, deadline);
+  }
+  if (result == 0) {
+    sem->count -= 1;
+  }
+  pthread_mutex_unlock(&sem->mutex);
+  return result;
+}
+
+void k_sem_reset(struct k_sem *sem) {
+  pthread_mutex_lock(&sem->mutex);
+  sem->count = 0;
+  pthread_mutex_unlock(&sem->mutex);
+}
+
+unsigned int k_sem_count_get(struct k_sem *sem) {
+  pthread_mutex_lock(&sem->mutex);
+  unsigned int count = sem->count;
+  pthread_mutex_unlock(&sem->mutex);
+  return count;
+}
+
+/*
+ * Timers
+ */
+void k_timer_init(struct k_timer *timer, k_timer_expiry_t expiry_fn, k_timer_stop_t stop_fn) {
+  pthread_mutex_lock(&timer_mutex);
+  timer_unlink(timer);
+  *timer = (struct k_timer){.expiry_fn = expiry_fn, .stop_fn = stop_fn};
+  pthread_mutex_unlock(&timer_mutex);
+}
+
+void k_timer_start(struct k_timer *timer, k_timeout_t duration, k_timeout_t period) {
+  if (K_TIMEOUT_EQ(duration, K_FOREVER)) {
+    return;
+  }
+
+  pthread_once(&timer_once, timer_thread_start);
+
+  pthread_mutex_lock(&timer_mutex);
+  timer_unlink(timer);
+  timer->expiry_ns = now_ns() + timeout_to_ns(duration);
+  timer->period = period;
+  timer->status = 0;
+  timer->running = true;
+  timer->p_next = p_timers;
+  p_timers = timer;
+  pthread_cond_signal(&timer_changed);
+  pthread_mutex_unlock(&timer_mutex);
+}
+
+void k_timer_stop(struct k_timer *timer) {
+  pthread_mutex_lock(&timer_mutex);
+  bool running = timer->running;
+  timer_unlink(timer);
+  pthread_mutex_unlock(&timer_mutex);
+
+  if (running && timer->stop_fn != NULL) {
+    timer->stop_fn(timer);
+  }
+}
+
+uint32_t k_timer_status_get(struct k_timer *timer) {
+  pthread_mutex_lock(&timer_mutex);
+  uint32_t status = timer->status;
+  timer->status = 0;
+  pthread_mutex_unlock(&timer_mutex);
+  return status;
+}
+
+uint32_t k_timer_remaining_get(struct k_timer *timer) {
+  uint32_t remaining = 0;
+
+  pthread_mutex_lock(&timer_mutex);
+  uint64_t now = now_ns();
+  if (timer->running && timer->expiry_ns > now) {
+    remaining = (uint32_t)((timer->expiry_ns - now) / (NSEC_PER_SEC / MSEC_PER_SEC));
+  }
+  pthread_mutex_unlock(&timer_mutex);
+  return remaining;
+}
+
+/**************************************************************/
+/* Local Function Definitions                                 */
+/**************************************************************/
+static void start_time_init(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  start_ns = ((uint64_t)ts.tv_sec * NSEC_PER_SEC) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Nanoseconds since the time was first read.
+ */
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  pthread_once(&start_once, start_time_init);
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * NSEC_PER_SEC) + (uint64_t)ts.tv_nsec - start_ns;
+}
+
+static uint64_t timeout_to_ns(k_timeout_t timeout) {
+  return (timeout.ticks <= 0) ? 0 : k_ticks_to_ns_floor64(timeout.ticks);
+}
+
+/**
+ * @brief Absolute deadline (now_ns) of a timeout that isn't K_FOREVER.
+ */
+static uint64_t deadline_of(k_timeout_t timeout) {
+  return K_TIMEOUT_EQ(timeout, K_FOREVER) ? UINT64_MAX : now_ns() + timeout_to_ns(timeout);
+}
+
+/**
+ * @brief Wait for a condition until a deadline.
+ *
+ * @retval 0 if the condition was signaled, -EBUSY if timeout is K_NO_WAIT,
+ * -EAGAIN if the deadline passed
+ */
+static int wait_until(pthread_cond_t *p_cond, pthread_mutex_t *p_mutex, k_timeout_t timeout, uint64_t deadline_ns) {
+  if (K_TIMEOUT_EQ(timeout, K_NO_WAIT)) {
+    return -EBUSY;
+  }
+  if (K_TIMEOUT_EQ(timeout, K_FOREVER)) {
+    pthread_cond_wait(p_cond, p_mutex);
+    return 0;
+  }
+  if (now_ns() >= deadline_ns) {
+    return -EAGAIN;
+  }
+
+  uint64_t abs_ns = deadline_ns + start_ns;
+  struct timespec ts = {.tv_sec = (time_t)(abs_ns / NSEC_PER_SEC), .tv_nsec = (long)(abs_ns % NSEC_PER_SEC)};
+
+  /* A wakeup at the deadline is checked on the next call. */
+  (void)pthread_cond_clockwait(p_cond, p_mutex, CLOCK_MONOTONIC, &ts);
+  return 0;
+}
+
+static void *thread_entry(void *p_arg) {
+  struct k_thread *p_thread = p_arg;
+
+  p_current_thread = p_thread;
+  if (!K_TIMEOUT_EQ(p_thread->delay, K_NO_WAIT)) {
+    k_sleep(p_thread->delay);
+  }
+  p_thread->entry(p_thread->p1, p_thread->p2, p_thread->p3);
+  return NULL;
+}
+
+static void timer_thread_start(void) {
+  pthread_t thread;
+
+  if (pthread_create(&thread, NULL, timer_thread, NULL) != 0) {
+    posix_assert_post_action(__FILE__, __LINE__);
+  }
+  (void)pthread_setname_np(thread, "k_timer");
+  (void)pthread_detach(thread);
+}
+
+/**
+ * @brief Call the expiry function of timers in deadline order.
+ * The callbacks run in this thread as if it were the timer interrupt.
+ */
+static void *timer_thread(void *p_arg) {
+  ARG_UNUSED(p_arg);
+
+  in_isr = true;
+  pthread_mutex_lock(&timer_mutex);
+  while (true) {
+    struct k_timer *p_first = p_timers;
+    for (struct k_timer *p = p_timers; p != NULL; p = p->p_next) {
+      if (p->expiry_ns < p_first->expiry_ns) {
+        p_first = p;
+      }
+    }
+
+    if (p_first == NULL) {
+      pthread_cond_wait(&timer_changed, &timer_mutex);
+      continue;
+    }
+
+    uint64_t now = now_ns();
+    if (p_first->expiry_ns > now) {
+      uint64_t abs_ns = p_first->expiry_ns + start_ns;
+      struct timespec ts = {.tv_sec = (time_t)(abs_ns / NSEC_PER_SEC), .tv_nsec = (long)(abs_ns % NSEC_PER_SEC)};
+      (void)pthread_cond_clockwait(&timer_changed, &timer_mutex, CLOCK_MONOTONIC, &ts);
+      continue;
+    }
+
+    timer_unlink(p_first);
+    p_first->status += 1;
+    if (!K_TIMEOUT_EQ(p_first->period, K_NO_WAIT) && !K_TIMEOUT_EQ(p_first->period, K_FOREVER)) {
+      p_first->expiry_ns += timeout_to_ns(p_first->period);
+      p_first->running = true;
+      p_first->p_next = p_timers;
+      p_timers = p_first;
+    }
+
+    /* The timer can be restarted or stopped by the callback */
+    k_timer_expiry_t expiry_fn = p_first->expiry_fn;
+    pthread_mutex_unlock(&timer_mutex);
+    if (expiry_fn != NULL) {
+      expiry_fn(p_first);
+    }
+    pthread_mutex_lock(&timer_mutex);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Remove a timer from the list of running timers (timer_mutex held).
+ */
+static void timer_unlink(struct k_timer *timer) {
+  for (struct k_timer **pp = &p_timers; *pp != NULL; pp = &(*pp)->p_next) {
+    if (*pp == timer) {
+      *pp = timer->p_next;
+      break;
+    }
+  }
+  timer->p_next = NULL;
+  timer->running = false;
+}
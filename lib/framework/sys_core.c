@@ -1,10 +1,53 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(sys_core, LOG_LEVEL_DBG);
 
+#include <string.h>
+
 #include <framework/buffer_pool.h>
 #include <framework/sys_core.h>
 
-#define MAX_MSG_RECVS 32
+#ifdef CONFIG_SYS_MSG_STATS
+#include <framework/msg_stats.h>
+#endif
+#include <framework/msg_trace.h>
+#ifdef CONFIG_SYS_MSG_CALL
+#include <framework/msg_call.h>
+#endif
+#ifdef CONFIG_SYS_MSG_ISR_QUEUE
+#include <framework/msg_isr.h>
+#endif
+#ifdef CONFIG_SYS_MSG_RECORD
+#include <framework/msg_record.h>
+#endif
+
+/* The registry is indexed by receiver id */
+#define MAX_MSG_RECVS CONFIG_SYS_MAX_MSG_RECEIVES
+#define MSG_CODE_COUNT 256
+
+/* One bit per receiver id in the broadcast routing index */
+BUILD_ASSERT(MAX_MSG_RECVS <= 32, "Broadcast subscriber mask is 32 bits");
+
+#ifdef CONFIG_SYS_MSG_INLINE
+/* An inline message is a queue entry with bit 0 set (message buffers are at
+ * least 4 byte aligned). The code, tx_id and options are held in the upper
+ * bytes and rx_id is the receiver that owns the queue.
+ */
+#define MSG_INLINE_TAG 0x1
+#define MSG_IS_INLINE(_p) ((((uintptr_t)(_p)) & MSG_INLINE_TAG) != 0)
+#define MSG_INLINE_ENCODE(_code, _tx_id, _options)                                                                     \
+  ((msg_t *)(uintptr_t)(MSG_INLINE_TAG | ((uint32_t)(_code) << 8) | ((uint32_t)(_tx_id) << 16) |                       \
+                        ((uint32_t)(_options) << 24)))
+
+BUILD_ASSERT(sizeof(msg_code_t) == 1 && sizeof(mid_t) == 1, "Inline messages hold 8 bit codes and ids");
+#else
+#define MSG_IS_INLINE(_p) false
+#endif
+
+#ifdef CONFIG_SYS_MSG_SCHED
+/* Deadline of a message without one. It is later than any deadline of a
+ * message, but small enough to be compared with them. */
+#define MSG_SCHED_NO_DEADLINE (INT32_MAX / 2)
+#endif
 
 typedef struct msg_task_entries {
   msg_recv_t *p_msg_recv;
@@ -17,9 +60,89 @@ typedef struct msg_task_entries {
 static int sys_initialize(const struct device *p_device);
 
 static void periodic_timer_callback_isr(struct k_timer *p_arg);
+static void pending_timer_callback_isr(struct k_timer *p_arg);
+
+static void msg_task_define_init(void);
+static void msg_task_start(msg_recv_t *p_rxer);
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+static void msg_executor_ready(msg_recv_t *p_rxer);
+static void msg_worker_thread(void *p_arg1, void *p_arg2, void *p_arg3);
+#else
+static void msg_task_thread(void *p_arg1, void *p_arg2, void *p_arg3);
+#endif
+
+static void msg_route_add(msg_recv_t *p_rxer);
+static msg_handler_t *msg_handler_get(const msg_recv_t *p_rxer, msg_code_t msg_code);
+
+static void msg_dispatch(msg_recv_t *p_rxer, msg_t *p_msg);
+
+static uint32_t msg_broadcast_targets(const msg_t *p_msg);
+static msgq_t *msg_lane(msg_recv_t *p_rxer, const msg_t *p_msg);
+static int msg_queue_put(msgq_t *p_queue, msg_t *p_msg, TickType_t timeout);
+static int msg_queue_get(msgq_t *p_queue, msg_t **pp_msg, TickType_t timeout);
+static uint32_t msg_queue_used(msgq_t *p_queue);
+static bool msg_queue_full(msgq_t *p_queue);
+static BaseType_t msg_rxer_put(msg_recv_t *p_rxer, msg_t *p_msg, msg_policy_t policy, TickType_t timeout);
+static void msg_drop_oldest(msg_recv_t *p_rxer, msgq_t *p_queue);
+static bool msg_replace_pending(msgq_t *p_queue, msg_t *p_msg);
+static bool msg_replaceable(const msg_header_t *p_header);
+static void msg_count_drop(msg_recv_t *p_rxer, msg_code_t msg_code, bool queued);
+#ifdef CONFIG_SYS_MSG_TTL
+static bool msg_expired(msg_recv_t *p_rxer, const msg_t *p_msg);
+#endif
+#ifdef CONFIG_SYS_MSG_SCHED
+static int msg_sched_apply(const msg_recv_t *p_rxer, msg_code_t msg_code);
+static void msg_sched_restore(int priority);
+#endif
+static BaseType_t msg_rxer_get(msg_recv_t *p_rxer, msg_t **pp_msg, TickType_t block_ticks);
+static msg_recv_t *pending_rxer(const msg_pending_t *p_pending);
+static void pending_start(msg_pending_t *p_pending);
 
 static msg_task_entries_t msg_task_registry[MAX_MSG_RECVS];
 
+/* Routing index built when a receiver is registered.
+ * The unicast table holds the lowest receiver id that has a handler for a
+ * message code (MSG_ID_RESERVED if there is none) and the broadcast table holds
+ * a mask of every receiver id that has a handler for that code.
+ * Routing cost therefore doesn't depend on the number of receivers.
+ */
+static mid_t msg_unicast_route[MSG_CODE_COUNT];
+static uint32_t msg_broadcast_route[MSG_CODE_COUNT];
+
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+/* Receivers that have messages and aren't being serviced. A receiver is in
+ * the run queue at most once (see msg_executor_ready), so it can't be full.
+ */
+K_MSGQ_DEFINE(msg_run_queue, sizeof(msg_recv_t *), MAX_MSG_RECVS, MSG_QUEUE_ALIGNMENT);
+
+K_THREAD_STACK_ARRAY_DEFINE(msg_worker_stacks, CONFIG_SYS_MSG_EXECUTOR_THREADS, CONFIG_SYS_MSG_EXECUTOR_STACK_SIZE);
+static struct k_thread msg_workers[CONFIG_SYS_MSG_EXECUTOR_THREADS];
+#endif
+
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+static struct {
+  atomic_t high_water;
+  atomic_t enqueue_failures;
+  atomic_t drops;
+  atomic_t coalesced;
+  atomic_t expired;
+} msg_queue_stats[MAX_MSG_RECVS];
+
+static uint16_t msg_drops_by_code[MSG_CODE_COUNT];
+#endif
+
+#ifdef CONFIG_SYS_MSG_COALESCE
+static ATOMIC_DEFINE(msg_coalesce_codes, MSG_CODE_COUNT);
+#endif
+
+#ifdef CONFIG_SYS_MSG_SCHED
+static const int msg_sched_priority[MSG_SCHED_CLASS_COUNT] = {
+    [MSG_SCHED_CLASS_CRITICAL] = CONFIG_SYS_MSG_SCHED_CRITICAL_PRIORITY,
+    [MSG_SCHED_CLASS_NORMAL] = CONFIG_SYS_MSG_SCHED_NORMAL_PRIORITY,
+    [MSG_SCHED_CLASS_BACKGROUND] = CONFIG_SYS_MSG_SCHED_BACKGROUND_PRIORITY,
+};
+#endif
+
 /*****************************************************/
 /* Global Function Definitions                       */
 /*****************************************************/
@@ -42,6 +165,7 @@ void msg_register_receiver(msg_recv_t *p_rxer) {
     if (!msg_task_registry[p_rxer->id].in_use) {
       msg_task_registry[p_rxer->id].in_use = true;
       msg_task_registry[p_rxer->id].p_msg_recv = p_rxer;
+      msg_route_add(p_rxer);
     } else {
       SYSCORE_ASSERT(FORCED);
     }
@@ -55,10 +179,15 @@ void msg_register_task(msg_task_t *p_msg_task) {
     return;
   }
   msg_register_receiver(&p_msg_task->rxer);
+  msg_static_init(&p_msg_task->timer_msg, SMC_PERIODIC, p_msg_task->rxer.id);
   k_timer_init(&p_msg_task->timer, periodic_timer_callback_isr, NULL);
 }
 
 BaseType_t msg_send(mid_t rx_id, msg_t *p_msg) {
+  return msg_send_with_policy(rx_id, p_msg, MSG_POLICY_FAIL_FAST, K_NO_WAIT);
+}
+
+BaseType_t msg_send_with_policy(mid_t rx_id, msg_t *p_msg, msg_policy_t policy, TickType_t timeout) {
   BaseType_t ret = SYS_ERROR;
   if (p_msg == NULL) {
     SYSCORE_ASSERT(FORCED);
@@ -75,12 +204,38 @@ BaseType_t msg_send(mid_t rx_id, msg_t *p_msg) {
 
   msg_recv_t *p_msg_rxer = msg_task_registry[rx_id].p_msg_recv;
   if (p_msg_rxer != NULL) {
-    p_msg->header.rx_id = rx_id;
-    ret = msg_queue(p_msg_rxer->p_queue, &p_msg, K_NO_WAIT);
+    if (!MSG_IS_INLINE(p_msg)) {
+      p_msg->header.rx_id = rx_id;
+    }
+    ret = msg_rxer_put(p_msg_rxer, p_msg, policy, timeout);
   }
   return ret;
 }
 
+#ifdef CONFIG_SYS_MSG_COALESCE
+void msg_coalesce_set(msg_code_t msg_code, bool enable) {
+  atomic_set_bit_to(msg_coalesce_codes, msg_code, enable);
+}
+
+bool msg_coalesce_get(msg_code_t msg_code) {
+  return atomic_test_bit(msg_coalesce_codes, msg_code);
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_TTL
+void msg_set_ttl(msg_t *p_msg, uint32_t ttl_ms) {
+  if (p_msg == NULL || MSG_IS_INLINE(p_msg)) {
+    SYSCORE_ASSERT(FORCED);
+    return;
+  }
+
+  uint32_t expiry = (ttl_ms == 0) ? 0 : k_uptime_get_32() + ttl_ms;
+
+  /* 0 means that the message doesn't expire. */
+  p_msg->header.expiry = (ttl_ms != 0 && expiry == 0) ? 1 : expiry;
+}
+#endif
+
 BaseType_t msg_unicast(msg_t *p_msg) {
   BaseType_t ret = SYS_ERROR;
 
@@ -89,34 +244,22 @@ BaseType_t msg_unicast(msg_t *p_msg) {
     return ret;
   }
 
-  uint32_t i;
-  for (i = MSG_ID_APP_START; i < MAX_MSG_RECVS; i++) {
-    msg_recv_t *p_msg_rxer = msg_task_registry[i].p_msg_recv;
-
-    if (p_msg_rxer != NULL && p_msg_rxer->p_msg_dispatcher != NULL) {
-      /* The handler isn't called here.
-       * It is only used to find the task the message belongs to.
-       */
-      msg_handler_t *msg_handler = p_msg_rxer->p_msg_dispatcher(p_msg->header.msg_code);
-
-      /* If there is a dispatcher, then send the message to that task. */
-      if (msg_handler != NULL) {
-        p_msg->header.rx_id = p_msg_rxer->id;
-        ret = msg_queue(p_msg_rxer->p_queue, &p_msg, K_NO_WAIT);
-        break;
-      }
-    }
+  mid_t rx_id = msg_unicast_route[p_msg->header.msg_code];
+
+  /* If there is a dispatcher, then send the message to that task. */
+  if (rx_id != MSG_ID_RESERVED) {
+    msg_recv_t *p_msg_rxer = msg_task_registry[rx_id].p_msg_recv;
+    p_msg->header.rx_id = rx_id;
+    ret = msg_rxer_put(p_msg_rxer, p_msg, MSG_POLICY_FAIL_FAST, K_NO_WAIT);
   }
   return ret;
 }
 
 BaseType_t msg_broadcast(msg_t *p_msg, size_t msg_size) {
   BaseType_t ret = SYS_ERROR;
-  msg_recv_t *p_msg_rxer;
-  msg_handler_t *p_msg_handler;
-  msg_t *p_new_msg;
-  bool accept;
-  uint32_t i;
+  uint32_t targets;
+
+  UNUSED_PARAMETER(msg_size);
 
   if (p_msg == NULL) {
     SYSCORE_ASSERT(FORCED);
@@ -130,58 +273,174 @@ BaseType_t msg_broadcast(msg_t *p_msg, size_t msg_size) {
   }
 #endif
 
-  for (i = MSG_ID_APP_START; i < MAX_MSG_RECVS; i++) {
+  targets = msg_broadcast_targets(p_msg);
+  return msg_multicast(p_msg, targets);
+}
+
+BaseType_t msg_multicast(msg_t *p_msg, uint32_t targets) {
+  BaseType_t ret = SYS_ERROR;
+  msg_recv_t *p_msg_rxer;
+  uint32_t unchecked;
+  uint32_t i;
+
+  if (p_msg == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return ret;
+  }
+
+  /* Only buffer pool messages can be shared. */
+  if (p_msg->header.options & MSG_OPTION_STATIC) {
+    SYSCORE_ASSERT(FORCED);
+    return ret;
+  }
+
+  /* Ids that aren't registered are ignored. */
+  unchecked = targets;
+  while (unchecked != 0) {
+    i = find_lsb_set(unchecked) - 1;
+    unchecked &= unchecked - 1;
+    if (i >= MAX_MSG_RECVS || msg_task_registry[i].p_msg_recv == NULL) {
+      targets &= ~BIT(i);
+    }
+  }
+  if (targets == 0) {
+    return ret;
+  }
+  /* The message is routed, only full queues can reject it now. */
+  ret = -ENOMSG;
+
+#ifdef CONFIG_SYS_MSG_FIFO
+  /* A buffer can only be linked into one queue, so every receiver but the
+   * last gets a copy and the last one gets the original.
+   */
+  p_msg->header.rx_id = MSG_ID_RESERVED;
+#ifdef CONFIG_SYS_MSG_TIMESTAMP
+  p_msg->header.timestamp = k_cycle_get_32();
+#endif
+  while (targets != 0) {
+    msg_t *p_copy = p_msg;
+
+    i = find_lsb_set(targets) - 1;
+    targets &= targets - 1;
     p_msg_rxer = msg_task_registry[i].p_msg_recv;
 
-    if (p_msg_rxer != NULL && p_msg_rxer->p_msg_dispatcher != NULL) {
-      /* The handler isn't called here. It is only used to determine
-       * if a task should receive a broadcast message.
-       */
-      p_msg_handler = p_msg_rxer->p_msg_dispatcher(p_msg->header.msg_code);
-
-      /* In general a task shouldn't have a handler for a message that it
-       * doesn't want. However, a task that blocks for long periods may want to
-       * filter the broadcasts that it accepts to keep the size of its message
-       * queue small.
-       */
-      if (p_msg_rxer->accept_broadcast != NULL) {
-        accept = p_msg_rxer->accept_broadcast(p_msg);
-      } else {
-        accept = true;
+    if (targets != 0) {
+      p_copy = (msg_t *)buffer_pool_try_to_take_from(buffer_pool_index(p_msg), buffer_pool_size(p_msg), K_NO_WAIT,
+                                                     __func__);
+      if (p_copy == NULL) {
+        msg_count_drop(p_msg_rxer, p_msg->header.msg_code, false);
+        continue;
       }
+      memcpy(p_copy, p_msg, buffer_pool_size(p_msg));
+    }
 
-      /* If there is a dispatcher and the task wants the message,
-       * then create a copy of the message and place it on the queue.
-       */
-      if (p_msg_handler != NULL && accept) {
-        p_new_msg = buffer_pool_try_to_take(msg_size, __func__);
-        if (p_new_msg != NULL) {
-          memcpy(p_new_msg, p_msg, msg_size);
-          p_new_msg->header.rx_id = p_msg_rxer->id;
-          ret = msg_queue(p_msg_rxer->p_queue, &p_new_msg, K_NO_WAIT);
-          if (ret != SYS_SUCCESS) {
-            buffer_pool_free(p_new_msg);
-          }
-        }
-      }
+    if (msg_rxer_put(p_msg_rxer, p_copy, MSG_POLICY_FAIL_FAST, K_NO_WAIT) == SYS_SUCCESS) {
+      ret = SYS_SUCCESS;
+    } else if (p_copy != p_msg || ret == SYS_SUCCESS) {
+      /* The caller only frees the original when no receiver got it. */
+      buffer_pool_free(p_copy);
+    }
+  }
+  return ret;
+#else
+  /* Every subscriber gets a reference before the message becomes visible to
+   * any of them. The broadcaster keeps its own reference until all queues
+   * have been tried so that a fast receiver can't free the message early.
+   */
+  p_msg->header.rx_id = MSG_ID_RESERVED;
+  p_msg->header.options |= MSG_OPTION_SHARED;
+#ifdef CONFIG_SYS_MSG_TIMESTAMP
+  /* A shared header is stamped once for all subscribers. */
+  p_msg->header.timestamp = k_cycle_get_32();
+#endif
+  buffer_pool_add_ref(p_msg, POPCOUNT(targets));
+
+  while (targets != 0) {
+    i = find_lsb_set(targets) - 1;
+    targets &= targets - 1;
+    p_msg_rxer = msg_task_registry[i].p_msg_recv;
+
+    if (msg_rxer_put(p_msg_rxer, p_msg, MSG_POLICY_FAIL_FAST, K_NO_WAIT) == SYS_SUCCESS) {
+      ret = SYS_SUCCESS;
+    } else {
+      /* Drop the reference of the receiver that didn't get the message. */
+      buffer_pool_free(p_msg);
     }
   }
 
-  /* Free original message memory only when all messages were routed.
-   * This contional is here because the message free should occur in
-   * application code when the result returned is SYS_ERROR.
+  /* Release the broadcaster reference only when the message was routed.
+   * Otherwise the message free should occur in application code because
+   * an error is returned.
    */
   if (ret == SYS_SUCCESS) {
     buffer_pool_free(p_msg);
+  } else {
+    p_msg->header.options &= ~MSG_OPTION_SHARED;
+  }
+
+  return ret;
+#endif
+}
+
+#ifdef CONFIG_SYS_MSG_INLINE
+BaseType_t msg_send_inline(mid_t rx_id, mid_t tx_id, msg_code_t code, uint8_t options) {
+  /* Anything else needs a buffer. */
+  if ((options & ~MSG_OPTION_URGENT) != 0) {
+    SYSCORE_ASSERT(FORCED);
+    return SYS_ERROR;
+  }
+
+  return msg_send(rx_id, MSG_INLINE_ENCODE(code, tx_id, options));
+}
+
+BaseType_t msg_unicast_inline(mid_t tx_id, msg_code_t code) {
+  mid_t rx_id = msg_unicast_route[code];
+
+  if (rx_id == MSG_ID_RESERVED) {
+    return SYS_ERROR;
+  }
+  return msg_send(rx_id, MSG_INLINE_ENCODE(code, tx_id, MSG_OPTION_NONE));
+}
+
+BaseType_t msg_broadcast_inline(mid_t tx_id, msg_code_t code) {
+  BaseType_t ret = SYS_ERROR;
+  msg_t *p_entry = MSG_INLINE_ENCODE(code, tx_id, MSG_OPTION_NONE);
+  msg_t msg;
+  uint32_t targets;
+  uint32_t i;
+
+#if CONFIG_SYS_ASSERT_ON_BROADCAST_FROM_ISR
+  if (sys_interrupt_context()) {
+    SYSCORE_ASSERT(FORCED);
+    return ret;
+  }
+#endif
+
+  /* The filters of the subscribers are given the decoded header. */
+  msg_entry_header(p_entry, &msg.header);
+  targets = msg_broadcast_targets(&msg);
+  if (targets != 0) {
+    ret = -ENOMSG;
+  }
+
+  /* A value can be queued any number of times, so there aren't any
+   * references to take. */
+  while (targets != 0) {
+    i = find_lsb_set(targets) - 1;
+    targets &= targets - 1;
+    if (msg_rxer_put(msg_task_registry[i].p_msg_recv, p_entry, MSG_POLICY_FAIL_FAST, K_NO_WAIT) == SYS_SUCCESS) {
+      ret = SYS_SUCCESS;
+    }
   }
 
   return ret;
 }
+#endif
 
 BaseType_t msg_queue(msgq_t *p_queue, void *pp_data, TickType_t block_ticks) {
   BaseType_t status;
   msg_t *p_msg;
-  struct k_msgq_attrs attrs;
+  msg_header_t header;
 
   if (p_queue == NULL) {
     SYSCORE_ASSERT(FORCED);
@@ -199,21 +458,27 @@ BaseType_t msg_queue(msgq_t *p_queue, void *pp_data, TickType_t block_ticks) {
     return SYS_ERROR;
   }
 
-  if (p_msg->header.msg_code == SMC_INVALID) {
+  msg_entry_header(p_msg, &header);
+  if (header.msg_code == SMC_INVALID) {
     SYSCORE_ASSERT(FORCED);
     return SYS_ERROR;
   }
 
+#ifdef CONFIG_SYS_MSG_TIMESTAMP
+  if (!(header.options & (MSG_OPTION_SHARED | MSG_OPTION_INLINE))) {
+    p_msg->header.timestamp = k_cycle_get_32();
+  }
+#endif
+
   if (sys_interrupt_context()) {
-    status = k_msgq_put(p_queue, pp_data, K_NO_WAIT);
+    status = msg_queue_put(p_queue, p_msg, K_NO_WAIT);
   } else {
-    status = k_msgq_put(p_queue, pp_data, block_ticks);
+    status = msg_queue_put(p_queue, p_msg, block_ticks);
   }
 
   if (status != 0) {
-    k_msgq_get_attrs(p_queue, &attrs);
-    LOG_ERR("Unable to queue message code %u to task %u (%u/%u): %d", p_msg->header.msg_code, p_msg->header.rx_id,
-            attrs.used_msgs, attrs.max_msgs, status);
+    LOG_ERR("Unable to queue message code %u to task %u (%u queued): %d", header.msg_code, header.rx_id,
+            msg_queue_used(p_queue), status);
   }
 
   return status;
@@ -231,11 +496,25 @@ BaseType_t msg_recv(msgq_t *p_queue, void *pp_data, TickType_t block_ticks) {
   }
 
   if (sys_interrupt_context()) {
-    return k_msgq_get(p_queue, pp_data, K_NO_WAIT);
+    return msg_queue_get(p_queue, (msg_t **)pp_data, K_NO_WAIT);
   } else {
-    return k_msgq_get(p_queue, pp_data, block_ticks);
+    return msg_queue_get(p_queue, (msg_t **)pp_data, block_ticks);
+  }
+}
+
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+void msg_register_actor(msg_recv_t *p_rxer) {
+  if (p_rxer == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return;
   }
+
+  p_rxer->actor = true;
+  msg_register_receiver(p_rxer);
+  /* Messages may have been queued before the receiver was registered. */
+  msg_executor_ready(p_rxer);
 }
+#endif
 
 void msg_receiver(msg_recv_t *p_rxer) {
   if (p_rxer == NULL) {
@@ -243,42 +522,226 @@ void msg_receiver(msg_recv_t *p_rxer) {
     return;
   }
 
-  dispatch_result_t res = DISPATCH_ERROR;
   msg_t *p_msg = NULL;
 
-  BaseType_t status = msg_recv(p_rxer->p_queue, &p_msg, p_rxer->rx_block_ticks);
+  BaseType_t status = msg_rxer_get(p_rxer, &p_msg, p_rxer->rx_block_ticks);
 
   if ((status == SYS_SUCCESS) && (p_msg != NULL)) {
-    msg_handler_t *msg_handler = p_rxer->p_msg_dispatcher(p_msg->header.msg_code);
-    if (msg_handler != NULL) {
-      res = msg_handler(p_rxer, p_msg);
-      if (p_msg->header.options & MSG_OPTION_CALLBACK) {
-        cb_msg_t *p_cb_msg = (cb_msg_t *)p_msg;
-        if (p_cb_msg->callback != NULL) {
-          p_cb_msg->callback(p_cb_msg->data);
-        }
-      }
-    } else {
-      res = sys_unknown_msg_handler(p_rxer, p_msg);
-    }
+    msg_dispatch(p_rxer, p_msg);
+  }
+}
 
-    if (res != DISPATCH_DO_NOT_FREE) {
-      LOG_INF("Free message buffer!!!");
-      buffer_pool_free(p_msg);
+size_t msg_receiver_batch(msg_recv_t *p_rxer, size_t budget) {
+  if (p_rxer == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return 0;
+  }
+
+  if (budget == 0) {
+    budget = CONFIG_SYS_MSG_RECEIVER_BATCH_SIZE;
+  }
+
+  size_t handled = 0;
+  msg_t *p_msg = NULL;
+
+  /* Only the first message waits. The rest of the batch is what was
+   * already queued when the task woke up. */
+  BaseType_t status = msg_rxer_get(p_rxer, &p_msg, p_rxer->rx_block_ticks);
+
+  while ((status == SYS_SUCCESS) && (p_msg != NULL)) {
+    msg_dispatch(p_rxer, p_msg);
+    handled += 1;
+    if (handled >= budget) {
+      break;
     }
+    p_msg = NULL;
+    status = msg_rxer_get(p_rxer, &p_msg, K_NO_WAIT);
+  }
+
+  return handled;
+}
+
+void msg_static_init(static_msg_t *p_static_msg, msg_code_t code, mid_t tx_id) {
+  if (p_static_msg == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return;
+  }
+
+  p_static_msg->msg.header.msg_code = code;
+  p_static_msg->msg.header.rx_id = MSG_ID_RESERVED;
+  p_static_msg->msg.header.tx_id = tx_id;
+  p_static_msg->msg.header.options = MSG_OPTION_STATIC;
+  atomic_clear(&p_static_msg->in_flight);
+  atomic_clear(&p_static_msg->overruns);
+}
+
+BaseType_t msg_static_send(static_msg_t *p_static_msg, mid_t rx_id) {
+  if (p_static_msg == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return SYS_ERROR;
+  }
+
+  /* The previous message hasn't been handled yet. */
+  if (!atomic_cas(&p_static_msg->in_flight, 0, 1)) {
+    atomic_inc(&p_static_msg->overruns);
+    MSG_TRACE(MSG_TRACE_STATIC_OVERRUN, rx_id, p_static_msg->msg.header.msg_code, atomic_get(&p_static_msg->overruns));
+    return SYS_ERROR;
+  }
+
+  if (msg_send(rx_id, &p_static_msg->msg) != SYS_SUCCESS) {
+    atomic_inc(&p_static_msg->overruns);
+    atomic_clear(&p_static_msg->in_flight);
+    return SYS_ERROR;
+  }
+
+  return SYS_SUCCESS;
+}
+
+void *msg_new(size_t size, msg_code_t code, mid_t tx_id, mid_t rx_id) {
+  msg_t *p_msg = buffer_pool_take_uninit_from(msg_pool(tx_id), size);
+
+  if (p_msg != NULL) {
+    p_msg->header = (msg_header_t){
+        .msg_code = code,
+        .rx_id = rx_id,
+        .tx_id = tx_id,
+        .options = MSG_OPTION_NONE,
+    };
+  }
+  return p_msg;
+}
+
+uint8_t msg_pool(mid_t id) {
+  if (id < MAX_MSG_RECVS && msg_task_registry[id].in_use && msg_task_registry[id].p_msg_recv != NULL) {
+    return msg_task_registry[id].p_msg_recv->pool;
+  }
+  return BP_POOL_DEFAULT;
+}
+
+void msg_release(msg_t *p_msg) {
+  if (p_msg == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return;
+  }
+
+  /* Nothing was allocated for an inline message. */
+  if (MSG_IS_INLINE(p_msg) || (p_msg->header.options & MSG_OPTION_INLINE)) {
+    return;
+  }
+
+  if (p_msg->header.options & MSG_OPTION_STATIC) {
+    atomic_clear(&CONTAINER_OF(p_msg, static_msg_t, msg)->in_flight);
+  } else {
+    buffer_pool_free(p_msg);
+  }
+}
+
+void msg_entry_header(const msg_t *p_entry, msg_header_t *p_header) {
+#ifdef CONFIG_SYS_MSG_INLINE
+  if (MSG_IS_INLINE(p_entry)) {
+    uint32_t word = (uint32_t)(uintptr_t)p_entry;
+
+    *p_header = (msg_header_t){
+        .msg_code = (msg_code_t)(word >> 8),
+        .rx_id = MSG_ID_RESERVED,
+        .tx_id = (mid_t)(word >> 16),
+        .options = (uint8_t)(word >> 24) | MSG_OPTION_INLINE,
+    };
+    return;
+  }
+#endif
+  *p_header = p_entry->header;
+}
+
+void msg_pending_init(msg_pending_t *p_pending, mid_t rx_id) {
+  if (p_pending == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return;
+  }
+
+  p_pending->rx_id = rx_id;
+  p_pending->state = 0;
+  msg_static_init(&p_pending->resume_msg, SMC_INVALID, rx_id);
+  p_pending->resume_msg.msg.header.options |= MSG_OPTION_RESUME;
+  k_timer_init(&p_pending->timer, pending_timer_callback_isr, NULL);
+}
+
+dispatch_result_t msg_defer(msg_pending_t *p_pending, const msg_t *p_msg, TickType_t delay, uint32_t state) {
+  if (p_pending == NULL || p_msg == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return DISPATCH_ERROR;
+  }
+
+  /* When p_msg is the resume message it is being handled, not queued,
+   * so the header can be changed. */
+  p_pending->state = state;
+  p_pending->resume_msg.msg.header.msg_code = p_msg->header.msg_code;
+  p_pending->resume_msg.msg.header.tx_id = p_msg->header.tx_id;
+  p_pending->delay = delay;
+
+  /* Started by msg_dispatch once the message is released. Started now, the
+   * timer could expire while p_msg is the resume message that is in flight,
+   * and that resume would be lost as an overrun. */
+  msg_recv_t *p_rxer = pending_rxer(p_pending);
+  k_timer_stop(&p_pending->timer);
+  if (p_rxer != NULL) {
+    p_rxer->p_deferred = p_pending;
+  } else {
+    pending_start(p_pending);
+  }
+  return DISPATCH_PENDING;
+}
+
+void msg_pending_cancel(msg_pending_t *p_pending) {
+  if (p_pending == NULL) {
+    SYSCORE_ASSERT(FORCED);
+    return;
+  }
+
+  msg_recv_t *p_rxer = pending_rxer(p_pending);
+  if (p_rxer != NULL && p_rxer->p_deferred == p_pending) {
+    p_rxer->p_deferred = NULL;
+  }
+  k_timer_stop(&p_pending->timer);
+}
+
+bool msg_is_resume(const msg_t *p_msg) {
+  return (p_msg != NULL) && (p_msg->header.options & MSG_OPTION_RESUME);
+}
+
+uint32_t msg_resume_state(const msg_t *p_msg) {
+  if (!msg_is_resume(p_msg)) {
+    return 0;
   }
+
+  const static_msg_t *p_static_msg = CONTAINER_OF(p_msg, static_msg_t, msg);
+  return CONTAINER_OF(p_static_msg, msg_pending_t, resume_msg)->state;
+}
+
+bool msg_is_registered(mid_t rx_id) {
+  return (rx_id < MAX_MSG_RECVS) && msg_task_registry[rx_id].in_use;
 }
 
 BaseType_t msg_queue_is_empty(mid_t rx_id) {
+  return ((msg_queue_count(rx_id) == 0) ? 1 : 0);
+}
+
+uint32_t msg_queue_count(mid_t rx_id) {
   if (rx_id >= MAX_MSG_RECVS) {
-    return 1;
+    return 0;
   }
   if (!msg_task_registry[rx_id].in_use) {
-    return 1;
+    return 0;
   }
 
-  msgq_t *p_queue = msg_task_registry[rx_id].p_msg_recv->p_queue;
-  return ((k_msgq_num_used_get(p_queue) == 0) ? 1 : 0);
+  msg_recv_t *p_rxer = msg_task_registry[rx_id].p_msg_recv;
+  uint32_t used = msg_queue_used(p_rxer->p_queue);
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+  if (p_rxer->p_urgent_queue != NULL) {
+    used += msg_queue_used(p_rxer->p_urgent_queue);
+  }
+#endif
+  return used;
 }
 
 size_t msg_flush(mid_t rx_id) {
@@ -294,9 +757,9 @@ size_t msg_flush(mid_t rx_id) {
 
   while (true) {
     p_msg = NULL;
-    k_msgq_get(msg_task_registry[rx_id].p_msg_recv->p_queue, &p_msg, K_NO_WAIT);
+    msg_rxer_get(msg_task_registry[rx_id].p_msg_recv, &p_msg, K_NO_WAIT);
     if (p_msg != NULL) {
-      buffer_pool_free(p_msg);
+      msg_release(p_msg);
       purged += 1;
     } else {
       break;
@@ -305,16 +768,36 @@ size_t msg_flush(mid_t rx_id) {
   return purged;
 }
 
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+int msg_queue_stats_get(mid_t rx_id, struct msg_queue_stats *p_stats) {
+  if (rx_id >= MAX_MSG_RECVS || p_stats == NULL) {
+    return -EINVAL;
+  }
+  if (!msg_task_registry[rx_id].in_use) {
+    return -ENOENT;
+  }
+
+  p_stats->high_water = atomic_get(&msg_queue_stats[rx_id].high_water);
+  p_stats->enqueue_failures = atomic_get(&msg_queue_stats[rx_id].enqueue_failures);
+  p_stats->drops = atomic_get(&msg_queue_stats[rx_id].drops);
+  p_stats->coalesced = atomic_get(&msg_queue_stats[rx_id].coalesced);
+  p_stats->expired = atomic_get(&msg_queue_stats[rx_id].expired);
+  return 0;
+}
+
+uint16_t msg_queue_drops_by_code(msg_code_t msg_code) {
+  return msg_drops_by_code[msg_code];
+}
+#endif
+
 void msg_start_timer(msg_task_t *p_msg_task) {
   if (p_msg_task == NULL) {
     SYSCORE_ASSERT(FORCED);
     return;
   }
 
-  LOG_INF("timer duration = %lld, periodic = %lld", p_msg_task->timer_duration_ticks.ticks,
-          p_msg_task->timer_period_ticks.ticks);
-  LOG_INF("call msg_start_timer!!!");
-
+  MSG_TRACE(MSG_TRACE_TIMER_START, p_msg_task->rxer.id, p_msg_task->timer_msg.msg.header.msg_code,
+            k_ticks_to_ms_floor32(p_msg_task->timer_period_ticks.ticks));
   k_timer_start(&p_msg_task->timer, p_msg_task->timer_duration_ticks, p_msg_task->timer_period_ticks);
 }
 
@@ -324,6 +807,7 @@ void msg_stop_timer(msg_task_t *p_msg_task) {
     return;
   }
 
+  MSG_TRACE(MSG_TRACE_TIMER_STOP, p_msg_task->rxer.id, p_msg_task->timer_msg.msg.header.msg_code, 0);
   k_timer_stop(&p_msg_task->timer);
 }
 
@@ -349,32 +833,727 @@ static int sys_initialize(const struct device *p_device) {
 
   buffer_pool_init();
 
+#ifdef CONFIG_SYS_MSG_ISR_QUEUE
+  msg_isr_init();
+#endif
+#ifdef CONFIG_SYS_MSG_RECORD
+  msg_record_init();
+#endif
+
+  msg_task_define_init();
+
   return 0;
 }
 
-/******************************************************************************/
-/* Interrupt Service Routines                                                 */
-/******************************************************************************/
-static void periodic_timer_callback_isr(struct k_timer *p_arg) {
-  msg_task_t *p_msg_task = (msg_task_t *)CONTAINER_OF(p_arg, msg_task_t, timer);
+/**
+ * @brief Register the tasks defined with MSG_TASK_DEFINE and create their
+ * threads. Runs before the scheduler starts the application,
+ * so interrupts don't need to be locked.
+ */
+static void msg_task_define_init(void) {
+  STRUCT_SECTION_FOREACH(msg_task, p_msg_task) {
+    mid_t id = p_msg_task->rxer.id;
 
-  msg_t *p_msg = (msg_t *)buffer_pool_try_to_take(sizeof(msg_t), __func__);
-
-  if (p_msg != NULL) {
-    LOG_INF("Take a buffer, tx,rx_id = %d", p_msg_task->rxer.id);
-    p_msg->header.msg_code = SMC_PERIODIC;
-    p_msg->header.tx_id = p_msg_task->rxer.id;
-    p_msg->header.rx_id = p_msg_task->rxer.id;
-    if (msg_send(p_msg_task->rxer.id, p_msg) != SYS_SUCCESS) {
-      LOG_ERR("Failed to send message!!!");
-      buffer_pool_free(p_msg);
+    if (id >= MAX_MSG_RECVS || msg_task_registry[id].in_use) {
       SYSCORE_ASSERT(FORCED);
-    } else {
-      LOG_INF("Success to send message!!!");
+      continue;
+    }
+    msg_task_registry[id].in_use = true;
+    msg_task_registry[id].p_msg_recv = &p_msg_task->rxer;
+    msg_route_add(&p_msg_task->rxer);
+
+    msg_static_init(&p_msg_task->timer_msg, SMC_PERIODIC, id);
+    k_timer_init(&p_msg_task->timer, periodic_timer_callback_isr, NULL);
+  }
+
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+  /* The first worker starts the defined tasks and then the other workers. */
+  STRUCT_SECTION_FOREACH(msg_task, p_msg_task) {
+    p_msg_task->rxer.actor = true;
+  }
+  k_thread_create(&msg_workers[0], msg_worker_stacks[0], K_THREAD_STACK_SIZEOF(msg_worker_stacks[0]),
+                  msg_worker_thread, (void *)0, NULL, NULL, CONFIG_SYS_MSG_EXECUTOR_PRIORITY, 0, K_NO_WAIT);
+  k_thread_name_set(&msg_workers[0], "msg_worker");
+#else
+  /* Threads are created after every task is registered so that a task can
+   * send to any other task as soon as it starts. */
+  STRUCT_SECTION_FOREACH(msg_task, p_msg_task) {
+    p_msg_task->p_tid =
+        k_thread_create(&p_msg_task->data, p_msg_task->p_stack, p_msg_task->stack_size, msg_task_thread,
+                        p_msg_task, NULL, NULL, p_msg_task->priority, 0, K_NO_WAIT);
+    k_thread_name_set(p_msg_task->p_tid, p_msg_task->p_name);
+  }
+#endif
+}
+
+/**
+ * @brief Call the SMC_TASK_START handler of a defined task.
+ * The start message is only seen by the task itself (it isn't queued).
+ */
+static void msg_task_start(msg_recv_t *p_rxer) {
+  msg_handler_t *p_start_handler = msg_handler_get(p_rxer, SMC_TASK_START);
+  if (p_start_handler != NULL) {
+    msg_t start_msg = {
+        .header = {.msg_code = SMC_TASK_START, .rx_id = p_rxer->id, .tx_id = p_rxer->id},
+    };
+    p_start_handler(p_rxer, &start_msg);
+  }
+}
+
+/**
+ * @brief Thread of a task defined with MSG_TASK_DEFINE.
+ */
+#ifndef CONFIG_SYS_MSG_EXECUTOR
+static void msg_task_thread(void *p_arg1, void *p_arg2, void *p_arg3) {
+  ARG_UNUSED(p_arg2);
+  ARG_UNUSED(p_arg3);
+
+  msg_task_t *p_msg_task = (msg_task_t *)p_arg1;
+  msg_recv_t *p_rxer = &p_msg_task->rxer;
+
+  msg_task_start(p_rxer);
+
+  while (true) {
+    msg_receiver_batch(p_rxer, 0);
+  }
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+/**
+ * @brief Put an actor on the run queue unless it is already there or
+ * being serviced. Can be called from interrupt context.
+ */
+static void msg_executor_ready(msg_recv_t *p_rxer) {
+  if (p_rxer->actor && atomic_cas(&p_rxer->scheduled, 0, 1)) {
+    k_msgq_put(&msg_run_queue, &p_rxer, K_NO_WAIT);
+  }
+}
+
+static void msg_worker_thread(void *p_arg1, void *p_arg2, void *p_arg3) {
+  ARG_UNUSED(p_arg2);
+  ARG_UNUSED(p_arg3);
+
+  msg_recv_t *p_rxer = NULL;
+  msg_t *p_msg;
+  size_t handled;
+  uintptr_t i;
+
+  if ((uintptr_t)p_arg1 == 0) {
+    STRUCT_SECTION_FOREACH(msg_task, p_msg_task) {
+      msg_task_start(&p_msg_task->rxer);
+      msg_executor_ready(&p_msg_task->rxer);
+    }
+    for (i = 1; i < CONFIG_SYS_MSG_EXECUTOR_THREADS; i++) {
+      k_thread_create(&msg_workers[i], msg_worker_stacks[i], K_THREAD_STACK_SIZEOF(msg_worker_stacks[i]),
+                      msg_worker_thread, (void *)i, NULL, NULL, CONFIG_SYS_MSG_EXECUTOR_PRIORITY, 0, K_NO_WAIT);
+      k_thread_name_set(&msg_workers[i], "msg_worker");
+    }
+  }
+
+  while (true) {
+    k_msgq_get(&msg_run_queue, &p_rxer, K_FOREVER);
+
+    for (handled = 0; handled < CONFIG_SYS_MSG_RECEIVER_BATCH_SIZE; handled++) {
+      p_msg = NULL;
+      if (msg_rxer_get(p_rxer, &p_msg, K_NO_WAIT) != SYS_SUCCESS || p_msg == NULL) {
+        break;
+      }
+      msg_dispatch(p_rxer, p_msg);
+    }
+
+    /* A message queued while the receiver was serviced didn't put it on the
+     * run queue. A busy receiver goes to the back so that it can't starve
+     * the other receivers.
+     */
+    atomic_clear(&p_rxer->scheduled);
+    if (!msg_queue_is_empty(p_rxer->id)) {
+      msg_executor_ready(p_rxer);
+    }
+  }
+}
+#endif
+
+/**
+ * @brief Call the handler for a received message and then free it,
+ * unless the handler kept it.
+ */
+static void msg_dispatch(msg_recv_t *p_rxer, msg_t *p_msg) {
+  dispatch_result_t res = DISPATCH_ERROR;
+
+#ifdef CONFIG_SYS_MSG_INLINE
+  msg_t inline_msg;
+  if (MSG_IS_INLINE(p_msg)) {
+    msg_entry_header(p_msg, &inline_msg.header);
+    inline_msg.header.rx_id = p_rxer->id;
+    p_msg = &inline_msg;
+  }
+#endif
+
+  /* The handler may reuse the message, so sample the header first. */
+  msg_code_t msg_code = p_msg->header.msg_code;
+
+#ifdef CONFIG_SYS_MSG_TTL
+  if (msg_expired(p_rxer, p_msg)) {
+    msg_release(p_msg);
+    return;
+  }
+#endif
+
+#ifdef CONFIG_SYS_MSG_SCHED
+  int priority = 0;
+  if (p_rxer->p_sched != NULL) {
+    priority = msg_sched_apply(p_rxer, msg_code);
+  }
+#endif
+
+#ifdef CONFIG_SYS_MSG_STATS
+  uint32_t start = k_cycle_get_32();
+  /* Inline messages aren't stamped. */
+  uint32_t residency = (p_msg->header.options & MSG_OPTION_INLINE) ? MSG_STATS_NO_RESIDENCY
+                                                                   : start - p_msg->header.timestamp;
+#endif
+
+  msg_handler_t *msg_handler;
+#ifdef CONFIG_SYS_MSG_CALL
+  /* A reply to sysmsg_call_cb goes to its callback instead of the dispatcher. */
+  if (p_msg->header.options & MSG_OPTION_REPLY) {
+    msg_handler = msg_call_reply_handler(p_msg);
+  } else {
+    msg_handler = msg_handler_get(p_rxer, msg_code);
+  }
+#else
+  msg_handler = msg_handler_get(p_rxer, msg_code);
+#endif
+  if (msg_handler != NULL) {
+    res = msg_handler(p_rxer, p_msg);
+    if (p_msg->header.options & MSG_OPTION_CALLBACK) {
+      cb_msg_t *p_cb_msg = (cb_msg_t *)p_msg;
+      if (p_cb_msg->callback != NULL) {
+        p_cb_msg->callback(p_cb_msg->data);
+      }
     }
   } else {
-    LOG_WRN("Failed to get Message buffer!!!");
+    MSG_TRACE(MSG_TRACE_UNKNOWN, p_rxer->id, msg_code, 0);
+    res = sys_unknown_msg_handler(p_rxer, p_msg);
+  }
+
+#ifdef CONFIG_SYS_MSG_SCHED
+  if (p_rxer->p_sched != NULL) {
+    msg_sched_restore(priority);
+  }
+#endif
+
+#ifdef CONFIG_SYS_MSG_STATS
+  msg_stats_record(p_rxer->id, msg_code, residency, k_cycle_get_32() - start);
+#endif
+
+  MSG_TRACE(MSG_TRACE_DISPATCH, p_rxer->id, msg_code, res);
+  if (res != DISPATCH_DO_NOT_FREE) {
+    MSG_TRACE(MSG_TRACE_FREE, p_rxer->id, msg_code, 0);
+    msg_release(p_msg);
+  }
+
+  /* The resume message can be sent again now (see msg_defer). */
+  if (p_rxer->p_deferred != NULL) {
+    pending_start(p_rxer->p_deferred);
+    p_rxer->p_deferred = NULL;
+  }
+}
+
+/**
+ * @brief Find the receivers of a broadcast.
+ *
+ * @retval mask of receiver ids
+ */
+static uint32_t msg_broadcast_targets(const msg_t *p_msg) {
+  msg_recv_t *p_msg_rxer;
+  uint32_t subscribers;
+  uint32_t targets = 0;
+  uint32_t i;
+
+  /* Only the tasks that have a handler for the message code are visited. */
+  subscribers = msg_broadcast_route[p_msg->header.msg_code];
+  while (subscribers != 0) {
+    i = find_lsb_set(subscribers) - 1;
+    subscribers &= subscribers - 1;
+    p_msg_rxer = msg_task_registry[i].p_msg_recv;
+
+    /* In general a task shouldn't have a handler for a message that it
+     * doesn't want. However, a task that blocks for long periods may want to
+     * filter the broadcasts that it accepts to keep the size of its message
+     * queue small.
+     */
+    if (p_msg_rxer->accept_broadcast == NULL || p_msg_rxer->accept_broadcast(p_msg)) {
+      targets |= BIT(i);
+    }
+  }
+
+  return targets;
+}
+
+/**
+ * @brief Select the queue of a receiver that a message is put on.
+ */
+static msgq_t *msg_lane(msg_recv_t *p_rxer, const msg_t *p_msg) {
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+  msg_header_t header;
+
+  msg_entry_header(p_msg, &header);
+  if ((header.options & MSG_OPTION_URGENT) && (p_rxer->p_urgent_queue != NULL)) {
+    return p_rxer->p_urgent_queue;
+  }
+#else
+  UNUSED_PARAMETER(p_msg);
+#endif
+  return p_rxer->p_queue;
+}
+
+/**
+ * @brief Put a message on a queue.
+ * A k_fifo can't be full, so it doesn't wait.
+ */
+static int msg_queue_put(msgq_t *p_queue, msg_t *p_msg, TickType_t timeout) {
+#ifdef CONFIG_SYS_MSG_FIFO
+  UNUSED_PARAMETER(timeout);
+
+  /* Counted first so that a receiver can't see a negative count. */
+  atomic_inc(&p_queue->count);
+  k_fifo_put(&p_queue->fifo, MSG_QUEUE_LINK(p_msg));
+  return 0;
+#else
+  return k_msgq_put(p_queue, &p_msg, timeout);
+#endif
+}
+
+/**
+ * @brief Get the next message of a queue.
+ */
+static int msg_queue_get(msgq_t *p_queue, msg_t **pp_msg, TickType_t timeout) {
+#ifdef CONFIG_SYS_MSG_FIFO
+  void *p_link = k_fifo_get(&p_queue->fifo, timeout);
+
+  if (p_link == NULL) {
+    return K_TIMEOUT_EQ(timeout, K_NO_WAIT) ? -ENOMSG : -EAGAIN;
+  }
+  atomic_dec(&p_queue->count);
+  *pp_msg = MSG_QUEUE_FROM_LINK(p_link);
+  return 0;
+#else
+  return k_msgq_get(p_queue, pp_msg, timeout);
+#endif
+}
+
+static uint32_t msg_queue_used(msgq_t *p_queue) {
+#ifdef CONFIG_SYS_MSG_FIFO
+  return (uint32_t)atomic_get(&p_queue->count);
+#else
+  return k_msgq_num_used_get(p_queue);
+#endif
+}
+
+static bool msg_queue_full(msgq_t *p_queue) {
+#ifdef CONFIG_SYS_MSG_FIFO
+  UNUSED_PARAMETER(p_queue);
+  return false;
+#else
+  return k_msgq_num_free_get(p_queue) == 0;
+#endif
+}
+
+/**
+ * @brief Put a message on the queue of a receiver using a backpressure
+ * policy and update the queue statistics of the receiver.
+ */
+static BaseType_t msg_rxer_put(msg_recv_t *p_rxer, msg_t *p_msg, msg_policy_t policy, TickType_t timeout) {
+  msgq_t *p_queue = msg_lane(p_rxer, p_msg);
+  msg_header_t header;
+  BaseType_t status;
+
+  /* The message belongs to the receiver once it is queued. */
+  msg_entry_header(p_msg, &header);
+  msg_code_t msg_code = header.msg_code;
+
+#ifdef CONFIG_SYS_MSG_RECORD
+  /* Only buffer pool messages have a known payload size. */
+  if (MSG_IS_INLINE(p_msg) || (header.options & MSG_OPTION_STATIC)) {
+    msg_record(p_rxer->id, &header, NULL, 0);
+  } else {
+    msg_record(p_rxer->id, &header, (const uint8_t *)p_msg + sizeof(msg_header_t),
+               buffer_pool_size(p_msg) - sizeof(msg_header_t));
   }
+#endif
+
+#ifdef CONFIG_SYS_MSG_COALESCE
+  /* The receiver is already scheduled for the pending message. */
+  if (atomic_test_bit(msg_coalesce_codes, msg_code) && msg_replace_pending(p_queue, p_msg)) {
+    MSG_TRACE(MSG_TRACE_COALESCE, p_rxer->id, msg_code, msg_queue_used(p_queue));
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+    atomic_inc(&msg_queue_stats[p_rxer->id].coalesced);
+#endif
+    return SYS_SUCCESS;
+  }
+#endif
+
+  switch (policy) {
+    case MSG_POLICY_BLOCK:
+      status = msg_queue(p_queue, &p_msg, timeout);
+      break;
+    case MSG_POLICY_DROP_OLDEST:
+      if (msg_queue_full(p_queue)) {
+        msg_drop_oldest(p_rxer, p_queue);
+      }
+      status = msg_queue(p_queue, &p_msg, K_NO_WAIT);
+      break;
+    case MSG_POLICY_REPLACE:
+      if (msg_replace_pending(p_queue, p_msg)) {
+        msg_count_drop(p_rxer, msg_code, true);
+        status = SYS_SUCCESS;
+      } else {
+        status = msg_queue(p_queue, &p_msg, K_NO_WAIT);
+      }
+      break;
+    default:
+      status = msg_queue(p_queue, &p_msg, K_NO_WAIT);
+      break;
+  }
+
+  if (status != SYS_SUCCESS) {
+    msg_count_drop(p_rxer, msg_code, false);
+    return status;
+  }
+
+  MSG_TRACE(MSG_TRACE_QUEUE, p_rxer->id, msg_code, msg_queue_used(p_queue));
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+  msg_executor_ready(p_rxer);
+#endif
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+  atomic_val_t used = msg_queue_used(p_queue);
+  atomic_val_t high_water = atomic_get(&msg_queue_stats[p_rxer->id].high_water);
+  while (used > high_water && !atomic_cas(&msg_queue_stats[p_rxer->id].high_water, high_water, used)) {
+    high_water = atomic_get(&msg_queue_stats[p_rxer->id].high_water);
+  }
+#endif
+
+  return status;
+}
+
+/**
+ * @brief Free the oldest message on a queue to make room for a new one.
+ */
+static void msg_drop_oldest(msg_recv_t *p_rxer, msgq_t *p_queue) {
+  msg_t *p_oldest = NULL;
+
+  msg_header_t header;
+
+  if (msg_queue_get(p_queue, &p_oldest, K_NO_WAIT) == 0 && p_oldest != NULL) {
+    msg_entry_header(p_oldest, &header);
+    msg_count_drop(p_rxer, header.msg_code, true);
+    msg_release(p_oldest);
+  }
+}
+
+/**
+ * @brief Replace a queued message that has the same code as p_msg.
+ * The entry is swapped in place under the queue lock so that the order of
+ * the other messages doesn't change.
+ *
+ * @retval true if a message was replaced (and freed).
+ */
+static bool msg_replace_pending(msgq_t *p_queue, msg_t *p_msg) {
+  msg_t *p_pending = NULL;
+  msg_header_t header;
+  msg_header_t pending_header;
+
+  msg_entry_header(p_msg, &header);
+  if (!msg_replaceable(&header)) {
+    return false;
+  }
+#ifdef CONFIG_SYS_MSG_TIMESTAMP
+  /* Other receivers may be reading a shared message (see msg_queue). */
+  if (!(header.options & (MSG_OPTION_SHARED | MSG_OPTION_INLINE))) {
+    p_msg->header.timestamp = k_cycle_get_32();
+  }
+#endif
+
+#ifdef CONFIG_SYS_MSG_FIFO
+  sys_sflist_t *p_list = &p_queue->fifo._queue.data_q;
+  sys_sfnode_t *p_prev = NULL;
+  sys_sfnode_t *p_node;
+
+  k_spinlock_key_t key = k_spin_lock(&p_queue->fifo._queue.lock);
+  SYS_SFLIST_FOR_EACH_NODE(p_list, p_node) {
+    msg_entry_header(MSG_QUEUE_FROM_LINK(p_node), &pending_header);
+    if (pending_header.msg_code == header.msg_code && msg_replaceable(&pending_header)) {
+      p_pending = MSG_QUEUE_FROM_LINK(p_node);
+      /* Link the new message after the pending one and then unlink the
+       * pending one. */
+      sys_sfnode_init(MSG_QUEUE_LINK(p_msg), 0);
+      sys_sflist_insert(p_list, p_node, MSG_QUEUE_LINK(p_msg));
+      sys_sflist_remove(p_list, p_prev, p_node);
+      break;
+    }
+    p_prev = p_node;
+  }
+  k_spin_unlock(&p_queue->fifo._queue.lock, key);
+#else
+  uint32_t i;
+
+  k_spinlock_key_t key = k_spin_lock(&p_queue->lock);
+  char *p_entry = p_queue->read_ptr;
+  for (i = 0; i < p_queue->used_msgs; i++) {
+    msg_t **pp_entry = (msg_t **)p_entry;
+    msg_entry_header(*pp_entry, &pending_header);
+    if (pending_header.msg_code == header.msg_code && msg_replaceable(&pending_header)) {
+      p_pending = *pp_entry;
+      *pp_entry = p_msg;
+      break;
+    }
+    p_entry += p_queue->msg_size;
+    if (p_entry == p_queue->buffer_end) {
+      p_entry = p_queue->buffer_start;
+    }
+  }
+  k_spin_unlock(&p_queue->lock, key);
+#endif
+
+  if (p_pending == NULL) {
+    return false;
+  }
+
+  msg_release(p_pending);
+  return true;
+}
+
+/**
+ * @brief A continuation (see msg_defer) or a static message carries state
+ * that a fresh message with the same code doesn't have, so it is never
+ * replaced and never replaces a pending message.
+ */
+static bool msg_replaceable(const msg_header_t *p_header) {
+  return !(p_header->options & (MSG_OPTION_RESUME | MSG_OPTION_STATIC));
+}
+
+/**
+ * @brief Count a message that was rejected (queued is false) or
+ * discarded from a queue by a send policy.
+ */
+static void msg_count_drop(msg_recv_t *p_rxer, msg_code_t msg_code, bool queued) {
+  MSG_TRACE(MSG_TRACE_DROP, p_rxer->id, msg_code, queued);
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+  if (queued) {
+    atomic_inc(&msg_queue_stats[p_rxer->id].drops);
+  } else {
+    atomic_inc(&msg_queue_stats[p_rxer->id].enqueue_failures);
+  }
+
+  unsigned int key = irq_lock();
+  if (msg_drops_by_code[msg_code] < UINT16_MAX) {
+    msg_drops_by_code[msg_code] += 1;
+  }
+  irq_unlock(key);
+#else
+  UNUSED_PARAMETER(p_rxer);
+  UNUSED_PARAMETER(msg_code);
+  UNUSED_PARAMETER(queued);
+#endif
+}
+
+#ifdef CONFIG_SYS_MSG_TTL
+/**
+ * @brief Check the time to live of a received message and count it if it
+ * has expired.
+ */
+static bool msg_expired(msg_recv_t *p_rxer, const msg_t *p_msg) {
+  uint32_t expiry = p_msg->header.expiry;
+  int32_t late;
+
+  if (expiry == 0) {
+    return false;
+  }
+
+  /* Uptime wraps, so it is compared as a difference. */
+  late = (int32_t)(k_uptime_get_32() - expiry);
+  if (late < 0) {
+    return false;
+  }
+
+  MSG_TRACE(MSG_TRACE_EXPIRE, p_rxer->id, p_msg->header.msg_code, late);
+#ifdef CONFIG_SYS_MSG_QUEUE_STATS
+  atomic_inc(&msg_queue_stats[p_rxer->id].expired);
+#endif
+  return true;
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_SCHED
+/**
+ * @brief Set the priority and deadline of the current thread for a message.
+ * A code without an entry (or with a default class or no deadline) uses
+ * the class and deadline of the receiver.
+ *
+ * @retval priority of the thread before the message
+ */
+static int msg_sched_apply(const msg_recv_t *p_rxer, msg_code_t msg_code) {
+  const struct msg_sched *p_sched = p_rxer->p_sched;
+  struct msg_sched_entry entry = p_sched->receiver;
+  k_tid_t tid = k_current_get();
+  int priority = k_thread_priority_get(tid);
+
+  if (msg_code < p_sched->count) {
+    if (p_sched->p_entries[msg_code].sched_class != MSG_SCHED_CLASS_DEFAULT) {
+      entry.sched_class = p_sched->p_entries[msg_code].sched_class;
+    }
+    if (p_sched->p_entries[msg_code].deadline_us != 0) {
+      entry.deadline_us = p_sched->p_entries[msg_code].deadline_us;
+    }
+  }
+
+  if (entry.sched_class != MSG_SCHED_CLASS_DEFAULT && entry.sched_class < MSG_SCHED_CLASS_COUNT &&
+      msg_sched_priority[entry.sched_class] != priority) {
+    k_thread_priority_set(tid, msg_sched_priority[entry.sched_class]);
+  }
+  k_thread_deadline_set(tid, (entry.deadline_us != 0) ? (int)k_us_to_cyc_ceil32(entry.deadline_us)
+                                                      : MSG_SCHED_NO_DEADLINE);
+  return priority;
+}
+
+static void msg_sched_restore(int priority) {
+  k_tid_t tid = k_current_get();
+
+  if (k_thread_priority_get(tid) != priority) {
+    k_thread_priority_set(tid, priority);
+  }
+  k_thread_deadline_set(tid, MSG_SCHED_NO_DEADLINE);
+}
+#endif
+
+/**
+ * @brief Get the next message of a receiver.
+ * The urgent lane is always served before the normal lane.
+ */
+static BaseType_t msg_rxer_get(msg_recv_t *p_rxer, msg_t **pp_msg, TickType_t block_ticks) {
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+  if (p_rxer->p_urgent_queue != NULL) {
+    struct k_poll_event events[2];
+
+    if (msg_recv(p_rxer->p_urgent_queue, pp_msg, K_NO_WAIT) == SYS_SUCCESS) {
+      return SYS_SUCCESS;
+    }
+    if (msg_recv(p_rxer->p_queue, pp_msg, K_NO_WAIT) == SYS_SUCCESS) {
+      return SYS_SUCCESS;
+    }
+    if (K_TIMEOUT_EQ(block_ticks, K_NO_WAIT) || sys_interrupt_context()) {
+      return -ENOMSG;
+    }
+
+    k_poll_event_init(&events[0], MSG_QUEUE_POLL_TYPE, K_POLL_MODE_NOTIFY_ONLY,
+                      MSG_QUEUE_POLL_OBJ(p_rxer->p_urgent_queue));
+    k_poll_event_init(&events[1], MSG_QUEUE_POLL_TYPE, K_POLL_MODE_NOTIFY_ONLY, MSG_QUEUE_POLL_OBJ(p_rxer->p_queue));
+    if (k_poll(events, ARRAY_SIZE(events), block_ticks) != 0) {
+      return -EAGAIN;
+    }
+
+    if (msg_recv(p_rxer->p_urgent_queue, pp_msg, K_NO_WAIT) == SYS_SUCCESS) {
+      return SYS_SUCCESS;
+    }
+    return msg_recv(p_rxer->p_queue, pp_msg, K_NO_WAIT);
+  }
+#endif
+  return msg_recv(p_rxer->p_queue, pp_msg, block_ticks);
+}
+
+/**
+ * @brief Receiver that resumes a continuation, NULL if it isn't registered.
+ */
+static msg_recv_t *pending_rxer(const msg_pending_t *p_pending) {
+  if (p_pending->rx_id < MAX_MSG_RECVS && msg_task_registry[p_pending->rx_id].in_use) {
+    return msg_task_registry[p_pending->rx_id].p_msg_recv;
+  }
+  return NULL;
+}
+
+static void pending_start(msg_pending_t *p_pending) {
+  k_timer_start(&p_pending->timer, p_pending->delay, K_NO_WAIT);
+  MSG_TRACE(MSG_TRACE_TIMER_START, p_pending->rx_id, p_pending->resume_msg.msg.header.msg_code,
+            k_ticks_to_ms_floor32(p_pending->delay.ticks));
+}
+
+/**
+ * @brief Add a receiver to the routing index.
+ * The dispatcher is queried once for every message code so that routing
+ * doesn't need to call it when a message is sent.
+ *
+ * @note Called with interrupts locked.
+ */
+static void msg_route_add(msg_recv_t *p_rxer) {
+  uint32_t count = MSG_CODE_COUNT;
+  uint32_t code;
+
+  if (p_rxer->p_msg_dispatcher == NULL) {
+    return;
+  }
+
+  /* A dispatcher defined with MSG_DISPATCHER_DEFINE is replaced by its table. */
+  if (p_rxer->p_msg_handlers == NULL) {
+    STRUCT_SECTION_FOREACH(msg_handler_table, p_table) {
+      if (p_table->p_dispatcher == p_rxer->p_msg_dispatcher) {
+        p_rxer->p_msg_handlers = p_table;
+        break;
+      }
+    }
+  }
+
+  /* Messages are never routed to the reserved id. */
+  if (p_rxer->id == MSG_ID_RESERVED) {
+    return;
+  }
+
+  /* Codes past the end of a table don't have a handler. */
+  if (p_rxer->p_msg_handlers != NULL) {
+    count = MIN(p_rxer->p_msg_handlers->count, MSG_CODE_COUNT);
+  }
+
+  for (code = 0; code < count; code++) {
+    if (msg_handler_get(p_rxer, (msg_code_t)code) == NULL) {
+      continue;
+    }
+
+    if (msg_unicast_route[code] == MSG_ID_RESERVED || p_rxer->id < msg_unicast_route[code]) {
+      msg_unicast_route[code] = p_rxer->id;
+    }
+    msg_broadcast_route[code] |= BIT(p_rxer->id);
+  }
+}
+
+/**
+ * @brief Get the handler of a message code.
+ * A table is read directly instead of calling the dispatcher.
+ */
+static msg_handler_t *msg_handler_get(const msg_recv_t *p_rxer, msg_code_t msg_code) {
+  const struct msg_handler_table *p_table = p_rxer->p_msg_handlers;
+
+  if (p_table != NULL) {
+    return (msg_code < p_table->count) ? p_table->p_handlers[msg_code] : NULL;
+  }
+  return p_rxer->p_msg_dispatcher(msg_code);
+}
+
+/******************************************************************************/
+/* Interrupt Service Routines                                                 */
+/******************************************************************************/
+static void periodic_timer_callback_isr(struct k_timer *p_arg) {
+  msg_task_t *p_msg_task = (msg_task_t *)CONTAINER_OF(p_arg, msg_task_t, timer);
+
+  /* Doesn't allocate or log. A tick that finds the previous one still
+   * queued is counted in timer_msg.overruns. */
+  msg_static_send(&p_msg_task->timer_msg, p_msg_task->rxer.id);
+}
+
+static void pending_timer_callback_isr(struct k_timer *p_arg) {
+  msg_pending_t *p_pending = CONTAINER_OF(p_arg, msg_pending_t, timer);
+
+  msg_static_send(&p_pending->resume_msg, p_pending->rx_id);
 }
 
 __weak void sys_assertion_handler(char *file, int line) {
@@ -4,6 +4,17 @@ LOG_MODULE_REGISTER(sys_msg, LOG_LEVEL_DBG);
 #include <framework/buffer_pool.h>
 #include <framework/sys_msg.h>
 
+#ifdef CONFIG_SYS_MSG_CALL
+#include <framework/msg_call.h>
+#endif
+#ifdef CONFIG_SYS_MSG_TOPIC
+#include <framework/msg_topic.h>
+#endif
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
@@ -15,7 +26,7 @@ static void deallocate_on_error(msg_t *p_msg, BaseType_t status);
 BaseType_t sysmsg_send(msg_t *p_msg) {
   BaseType_t result = msg_send(p_msg->header.rx_id, p_msg);
   deallocate_on_error(p_msg, result);
-  SYSCORE_ASSERT(result == SYS_SUCCESS);
+  SYSMSG_ASSERT_ROUTED(result);
 
   return result;
 }
@@ -27,11 +38,19 @@ BaseType_t sysmsg_try_to_send(msg_t *p_msg) {
   return result;
 }
 
+BaseType_t sysmsg_send_with_policy(msg_t *p_msg, msg_policy_t policy, TickType_t timeout) {
+  BaseType_t result = msg_send_with_policy(p_msg->header.rx_id, p_msg, policy, timeout);
+  deallocate_on_error(p_msg, result);
+  SYSMSG_ASSERT_ROUTED(result);
+
+  return result;
+}
+
 BaseType_t sysmsg_sendto(msg_t *p_msg, mid_t dest_id) {
   p_msg->header.rx_id = dest_id;
   BaseType_t result = msg_send(p_msg->header.rx_id, p_msg);
   deallocate_on_error(p_msg, result);
-  SYSCORE_ASSERT(result == SYS_SUCCESS);
+  SYSMSG_ASSERT_ROUTED(result);
 
   return result;
 }
@@ -39,7 +58,7 @@ BaseType_t sysmsg_sendto(msg_t *p_msg, mid_t dest_id) {
 BaseType_t sysmsg_unicast(msg_t *p_msg) {
   BaseType_t result = msg_unicast(p_msg);
   deallocate_on_error(p_msg, result);
-  SYSCORE_ASSERT(result == SYS_SUCCESS);
+  SYSMSG_ASSERT_ROUTED(result);
 
   return result;
 }
@@ -47,32 +66,76 @@ BaseType_t sysmsg_unicast(msg_t *p_msg) {
 BaseType_t sysmsg_create_and_send(mid_t tx_id, mid_t rx_id, msg_code_t code) {
   BaseType_t result = SYS_ERROR;
 
-  msg_t *p_msg = (msg_t *)buffer_pool_take(sizeof(msg_t));
-  SYSCORE_ASSERT(p_msg != NULL);
+#ifdef CONFIG_SYS_MSG_INLINE
+  result = msg_send_inline(rx_id, tx_id, code, MSG_OPTION_NONE);
+  SYSMSG_ASSERT_ROUTED(result);
+#else
+  msg_t *p_msg = msg_new(sizeof(msg_t), code, tx_id, MSG_ID_RESERVED);
 
   if (p_msg != NULL) {
-    SYS_MSG_HEADER_INIT(p_msg, code, tx_id);
     result = msg_send(rx_id, p_msg);
     deallocate_on_error(p_msg, result);
-    SYSCORE_ASSERT(result == SYS_SUCCESS);
+    SYSMSG_ASSERT_ROUTED(result);
   }
+#endif
 
   return result;
 }
 
+BaseType_t sysmsg_create_and_send_with_options(mid_t tx_id, mid_t rx_id, msg_code_t code, uint8_t options) {
+  BaseType_t result = SYS_ERROR;
+
+#ifdef CONFIG_SYS_MSG_INLINE
+  if ((options & ~MSG_OPTION_URGENT) == 0) {
+    result = msg_send_inline(rx_id, tx_id, code, options);
+    SYSMSG_ASSERT_ROUTED(result);
+    return result;
+  }
+#endif
+
+  msg_t *p_msg = msg_new(sizeof(msg_t), code, tx_id, MSG_ID_RESERVED);
+
+  if (p_msg != NULL) {
+    p_msg->header.options = options;
+    result = msg_send(rx_id, p_msg);
+    deallocate_on_error(p_msg, result);
+    SYSMSG_ASSERT_ROUTED(result);
+  }
+
+  return result;
+}
+
+#ifdef CONFIG_SYS_MSG_TTL
+BaseType_t sysmsg_create_and_send_ttl(mid_t tx_id, mid_t rx_id, msg_code_t code, uint32_t ttl_ms) {
+  BaseType_t result = SYS_ERROR;
+  msg_t *p_msg = msg_new(sizeof(msg_t), code, tx_id, MSG_ID_RESERVED);
+
+  if (p_msg != NULL) {
+    msg_set_ttl(p_msg, ttl_ms);
+    result = msg_send(rx_id, p_msg);
+    deallocate_on_error(p_msg, result);
+    SYSMSG_ASSERT_ROUTED(result);
+  }
+
+  return result;
+}
+#endif
+
 BaseType_t sysmsg_create_and_sendto_self(mid_t id, msg_code_t code) {
   BaseType_t result = SYS_ERROR;
 
-  msg_t *p_msg = (msg_t *)buffer_pool_take(sizeof(msg_t));
-  SYSCORE_ASSERT(p_msg != NULL);
+#ifdef CONFIG_SYS_MSG_INLINE
+  result = msg_send_inline(id, id, code, MSG_OPTION_NONE);
+  SYSMSG_ASSERT_ROUTED(result);
+#else
+  msg_t *p_msg = msg_new(sizeof(msg_t), code, id, id);
 
   if (p_msg != NULL) {
-    SYS_MSG_HEADER_INIT(p_msg, code, id);
-    p_msg->header.rx_id = id;
     result = msg_send(id, p_msg);
     deallocate_on_error(p_msg, result);
-    SYSCORE_ASSERT(result == SYS_SUCCESS);
+    SYSMSG_ASSERT_ROUTED(result);
   }
+#endif
 
   return result;
 }
@@ -80,15 +143,18 @@ BaseType_t sysmsg_create_and_sendto_self(mid_t id, msg_code_t code) {
 BaseType_t sysmsg_unicast_create_and_send(mid_t tx_id, msg_code_t code) {
   BaseType_t result = SYS_ERROR;
 
-  msg_t *p_msg = (msg_t *)buffer_pool_take(sizeof(msg_t));
-  SYSCORE_ASSERT(p_msg != NULL);
+#ifdef CONFIG_SYS_MSG_INLINE
+  result = msg_unicast_inline(tx_id, code);
+  SYSMSG_ASSERT_ROUTED(result);
+#else
+  msg_t *p_msg = msg_new(sizeof(msg_t), code, tx_id, MSG_ID_RESERVED);
 
   if (p_msg != NULL) {
-    SYS_MSG_HEADER_INIT(p_msg, code, tx_id);
     result = msg_unicast(p_msg);
     deallocate_on_error(p_msg, result);
-    SYSCORE_ASSERT(result == SYS_SUCCESS);
+    SYSMSG_ASSERT_ROUTED(result);
   }
+#endif
 
   return result;
 }
@@ -96,15 +162,17 @@ BaseType_t sysmsg_unicast_create_and_send(mid_t tx_id, msg_code_t code) {
 BaseType_t sysmsg_create_and_broadcast(mid_t tx_id, msg_code_t code) {
   BaseType_t result = SYS_ERROR;
 
+#ifdef CONFIG_SYS_MSG_INLINE
+  result = msg_broadcast_inline(tx_id, code);
+#else
   size_t size = sizeof(msg_t);
-  msg_t *p_msg = buffer_pool_take(size);
+  msg_t *p_msg = msg_new(size, code, tx_id, MSG_ID_RESERVED);
 
   if (p_msg != NULL) {
-    SYS_MSG_HEADER_INIT(p_msg, code, tx_id);
-    p_msg->header.rx_id = MSG_ID_RESERVED;
     result = msg_broadcast(p_msg, size);
     deallocate_on_error(p_msg, result);
   }
+#endif
 
   return result;
 }
@@ -112,14 +180,47 @@ BaseType_t sysmsg_create_and_broadcast(mid_t tx_id, msg_code_t code) {
 BaseType_t sysmsg_reply(msg_t *p_msg, msg_code_t code) {
   BaseType_t result = SYS_ERROR;
 
+  /* Other receivers may still be reading a shared message. */
+  if (p_msg->header.options & MSG_OPTION_SHARED) {
+    SYSCORE_ASSERT(FORCED);
+    deallocate_on_error(p_msg, result);
+    return result;
+  }
+
+#ifdef CONFIG_SYS_MSG_INLINE
+  /* The handler was given a copy of the header, so send a new one. */
+  if (p_msg->header.options & MSG_OPTION_INLINE) {
+    result = msg_send_inline(p_msg->header.tx_id, p_msg->header.rx_id, code,
+                             p_msg->header.options & MSG_OPTION_URGENT);
+    SYSMSG_ASSERT_ROUTED(result);
+    return result;
+  }
+#endif
+
   mid_t swap = p_msg->header.rx_id;
   p_msg->header.rx_id = p_msg->header.tx_id;
   p_msg->header.tx_id = swap;
   p_msg->header.msg_code = code;
 
+#ifdef CONFIG_SYS_MSG_CALL
+  /* The reply of a call goes to the caller that is waiting for it. */
+  if (p_msg->header.seq != 0) {
+    p_msg->header.options |= MSG_OPTION_REPLY;
+    if (msg_call_complete(p_msg)) {
+      return SYS_SUCCESS;
+    }
+  }
+#endif
+
   result = msg_send(p_msg->header.rx_id, p_msg);
+#ifdef CONFIG_SYS_MSG_CALL
+  /* Nothing will complete the call of a reply that wasn't queued. */
+  if (result != SYS_SUCCESS && (p_msg->header.options & MSG_OPTION_REPLY)) {
+    msg_call_drop(p_msg);
+  }
+#endif
   deallocate_on_error(p_msg, result);
-  SYSCORE_ASSERT(result == SYS_SUCCESS);
+  SYSMSG_ASSERT_ROUTED(result);
 
   return result;
 }
@@ -127,13 +228,9 @@ BaseType_t sysmsg_reply(msg_t *p_msg, msg_code_t code) {
 BaseType_t sysmsg_cb_create_and_send(mid_t tx_id, mid_t rx_id, msg_code_t code, void (*cb)(uint32_t), uint32_t cb_data) {
   BaseType_t result = SYS_ERROR;
 
-  size_t size = sizeof(cb_msg_t);
-  cb_msg_t *p_msg = buffer_pool_take(size);
+  cb_msg_t *p_msg = MSG_NEW(cb_msg_t, code, tx_id, rx_id);
 
   if (p_msg != NULL) {
-    p_msg->header.msg_code = code;
-    p_msg->header.rx_id = rx_id;
-    p_msg->header.tx_id = tx_id;
     p_msg->header.options = MSG_OPTION_CALLBACK;
     p_msg->callback = cb;
     p_msg->data = cb_data;
@@ -152,10 +249,9 @@ BaseType_t sysmsg_filtered_targeted_send(msg_t *p_msg, mid_t *target_id, size_t
   BaseType_t result;
 
   if (target_id == NULL) {
-#ifdef CONFIG_FILTER
-    /* With filtering, send targeted message to filter */
-    p_msg->header.rx_id = MSG_ID_EVENT_FILTER;
-    result = msg_send(MSG_ID_EVENT_FILTER, p_msg);
+#ifdef CONFIG_SYS_MSG_TOPIC
+    /* Publish the event, the filter task is used if it is enabled */
+    result = msg_publish((event_msg_t *)p_msg);
 #else
     /* Without filtering, send broadcast */
     p_msg->header.rx_id = MSG_ID_RESERVED;
@@ -168,7 +264,7 @@ BaseType_t sysmsg_filtered_targeted_send(msg_t *p_msg, mid_t *target_id, size_t
   }
 
   deallocate_on_error(p_msg, result);
-  SYSCORE_ASSERT(result == SYS_SUCCESS);
+  SYSMSG_ASSERT_ROUTED(result);
 
   return result;
 }
@@ -178,6 +274,6 @@ BaseType_t sysmsg_filtered_targeted_send(msg_t *p_msg, mid_t *target_id, size_t
 /******************************************************************************/
 static void deallocate_on_error(msg_t *p_msg, BaseType_t status) {
   if (status != SYS_SUCCESS) {
-    buffer_pool_free(p_msg);
+    msg_release(p_msg);
   }
 }
@@ -0,0 +1,947 @@
+/*
+ * Copyright (c) 2023 SEED FIC
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * @file test message framework
+ *
+ * This suite verifies message routing between registered receivers
+ * and the buffer sharing used by broadcast.
+ */
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include <framework/buffer_pool.h>
+#include <framework/msg_call.h>
+#include <framework/msg_isr.h>
+#ifdef CONFIG_SYS_MSG_RECORD
+#include <framework/msg_record.h>
+#endif
+#ifdef CONFIG_SYS_MSG_REMOTE
+#include <framework/msg_remote.h>
+#endif
+#include <framework/msg_topic.h>
+#include <framework/sys_msg.h>
+
+#define TEST_ID_A 1
+#define TEST_ID_B 2
+#define TEST_ID_C 3
+#define TEST_ID_DEFINED 4
+#define TEST_ID_REMOTE 5
+#define TEST_ID_ACTOR 5
+
+#define TEST_CODE_UNICAST SMC_APP_SPECIFIC_START
+#define TEST_CODE_SHARED (SMC_APP_SPECIFIC_START + 1)
+#define TEST_CODE_DEFINED (SMC_APP_SPECIFIC_START + 2)
+#define TEST_CODE_UNUSED (SMC_APP_SPECIFIC_START + 3)
+#define TEST_CODE_INLINE (SMC_APP_SPECIFIC_START + 4)
+#define TEST_CODE_DEFER (SMC_APP_SPECIFIC_START + 5)
+#define TEST_CODE_CALL (SMC_APP_SPECIFIC_START + 6)
+#define TEST_CODE_CALL_REPLY (SMC_APP_SPECIFIC_START + 7)
+#define TEST_CODE_CALL_SLOW (SMC_APP_SPECIFIC_START + 8)
+#define TEST_CODE_ACTOR (SMC_APP_SPECIFIC_START + 9)
+
+#define TEST_CALL_TIMEOUT_US 5000
+#define TEST_DEFER_BUSY_US 20000
+
+MSG_QUEUE_DEFINE(queue_a, 4);
+MSG_QUEUE_DEFINE(queue_b, 4);
+MSG_QUEUE_DEFINE(queue_c, 4);
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+MSG_QUEUE_DEFINE(queue_c_urgent, 4);
+#endif
+
+static atomic_t test_msg_handled;
+static int test_msg_priority;
+static uint8_t test_msg_options;
+
+static dispatch_result_t test_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg)
+{
+	ARG_UNUSED(p_msg_rxer);
+
+	atomic_inc(&test_msg_handled);
+	test_msg_priority = k_thread_priority_get(k_current_get());
+	test_msg_options = p_msg->header.options;
+	return DISPATCH_OK;
+}
+
+static msg_handler_t *dispatcher_a(msg_code_t msg_code)
+{
+	switch (msg_code) {
+	case TEST_CODE_SHARED: return test_msg_handler;
+	default: return NULL;
+	}
+}
+
+static msg_handler_t *dispatcher_b(msg_code_t msg_code)
+{
+	switch (msg_code) {
+	case TEST_CODE_UNICAST: return test_msg_handler;
+	case TEST_CODE_SHARED: return test_msg_handler;
+	default: return NULL;
+	}
+}
+
+static msg_handler_t *dispatcher_c(msg_code_t msg_code)
+{
+	switch (msg_code) {
+	case TEST_CODE_UNICAST: return test_msg_handler;
+	default: return NULL;
+	}
+}
+
+static atomic_t defined_task_started;
+static atomic_t defined_task_handled;
+
+static dispatch_result_t defined_start_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg)
+{
+	ARG_UNUSED(p_msg_rxer);
+	ARG_UNUSED(p_msg);
+
+	atomic_set(&defined_task_started, 1);
+	return DISPATCH_OK;
+}
+
+static dispatch_result_t defined_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg)
+{
+	ARG_UNUSED(p_msg_rxer);
+	ARG_UNUSED(p_msg);
+
+	atomic_inc(&defined_task_handled);
+	return DISPATCH_OK;
+}
+
+static msg_header_t inline_header;
+static K_SEM_DEFINE(inline_handled, 0, 1);
+
+static dispatch_result_t inline_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg)
+{
+	ARG_UNUSED(p_msg_rxer);
+
+	inline_header = p_msg->header;
+	k_sem_give(&inline_handled);
+	return DISPATCH_OK;
+}
+
+static msg_pending_t defer_pending;
+static uint32_t defer_resumed_state;
+static K_SEM_DEFINE(defer_done, 0, 1);
+
+static dispatch_result_t defer_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg)
+{
+	ARG_UNUSED(p_msg_rxer);
+
+	if (!msg_is_resume(p_msg)) {
+		return msg_defer(&defer_pending, p_msg, K_MSEC(20), 42);
+	}
+	if (msg_resume_state(p_msg) == 42) {
+		defer_resumed_state = 42;
+		/* The delay of the next resume ends before this handler returns. */
+		dispatch_result_t res = msg_defer(&defer_pending, p_msg, K_MSEC(1), 43);
+
+		k_busy_wait(TEST_DEFER_BUSY_US);
+		return res;
+	}
+	k_sem_give(&defer_done);
+	return DISPATCH_OK;
+}
+
+static dispatch_result_t call_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg)
+{
+	ARG_UNUSED(p_msg_rxer);
+
+	sysmsg_reply(p_msg, TEST_CODE_CALL_REPLY);
+	return DISPATCH_DO_NOT_FREE;
+}
+
+static uint32_t call_delay_us;
+
+/* Replies around the time that the caller times out */
+static dispatch_result_t call_slow_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg)
+{
+	ARG_UNUSED(p_msg_rxer);
+
+	k_busy_wait(call_delay_us);
+	sysmsg_reply(p_msg, TEST_CODE_CALL_REPLY);
+	return DISPATCH_DO_NOT_FREE;
+}
+
+/* The defined task uses a handler table, the other receivers use switches. */
+MSG_DISPATCHER_DEFINE(dispatcher_defined,
+		      MSG_HANDLER(SMC_TASK_START, defined_start_handler),
+		      MSG_HANDLER(TEST_CODE_DEFINED, defined_msg_handler),
+		      MSG_HANDLER(TEST_CODE_INLINE, inline_msg_handler),
+		      MSG_HANDLER(TEST_CODE_DEFER, defer_msg_handler),
+		      MSG_HANDLER(TEST_CODE_CALL, call_msg_handler),
+		      MSG_HANDLER(TEST_CODE_CALL_SLOW, call_slow_msg_handler));
+
+MSG_TASK_DEFINE(defined_task, TEST_ID_DEFINED, K_PRIO_PREEMPT(1), 1024, 4, dispatcher_defined);
+
+#if CONFIG_BUFFER_POOL_COUNT > 1
+#define TEST_POOL 1
+#define TEST_POOL_SIZE 256
+
+BUFFER_POOL_DEFINE(test_pool, TEST_POOL, TEST_POOL_SIZE);
+#endif
+
+static msg_recv_t rxer_a = {
+	.id = TEST_ID_A,
+	.p_queue = &queue_a,
+	.p_msg_dispatcher = dispatcher_a,
+};
+
+static msg_recv_t rxer_b = {
+	.id = TEST_ID_B,
+	.p_queue = &queue_b,
+	.p_msg_dispatcher = dispatcher_b,
+};
+
+static msg_recv_t rxer_c = {
+	.id = TEST_ID_C,
+	.p_queue = &queue_c,
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+	.p_urgent_queue = &queue_c_urgent,
+#endif
+	.p_msg_dispatcher = dispatcher_c,
+};
+
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+MSG_QUEUE_DEFINE(queue_actor, 4);
+
+static atomic_t actor_handled;
+static k_tid_t actor_thread;
+static K_SEM_DEFINE(actor_done, 0, 1);
+
+static dispatch_result_t actor_msg_handler(msg_recv_t *p_msg_rxer, msg_t *p_msg)
+{
+	ARG_UNUSED(p_msg_rxer);
+	ARG_UNUSED(p_msg);
+
+	actor_thread = k_current_get();
+	if (atomic_inc(&actor_handled) == 2) {
+		k_sem_give(&actor_done);
+	}
+	return DISPATCH_OK;
+}
+
+static msg_handler_t *dispatcher_actor(msg_code_t msg_code)
+{
+	switch (msg_code) {
+	case TEST_CODE_ACTOR: return actor_msg_handler;
+	default: return NULL;
+	}
+}
+
+static msg_recv_t rxer_actor = {
+	.id = TEST_ID_ACTOR,
+	.p_queue = &queue_actor,
+	.p_msg_dispatcher = dispatcher_actor,
+};
+#endif
+
+static msg_t *create_msg(msg_code_t code)
+{
+	msg_t *p_msg = buffer_pool_take(sizeof(msg_t));
+
+	zassert_not_null(p_msg, "buffer pool is empty");
+	SYS_MSG_HEADER_INIT(p_msg, code, MSG_ID_RESERVED);
+	return p_msg;
+}
+
+static void *framework_setup(void)
+{
+	/* Registration order must not change the routing result. */
+	msg_register_receiver(&rxer_c);
+	msg_register_receiver(&rxer_a);
+	msg_register_receiver(&rxer_b);
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+	msg_register_actor(&rxer_actor);
+#endif
+	return NULL;
+}
+
+static void framework_after(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	msg_flush(TEST_ID_A);
+	msg_flush(TEST_ID_B);
+	msg_flush(TEST_ID_C);
+}
+
+ZTEST(framework, test_unicast_routes_to_lowest_owner)
+{
+	msg_t *p_msg = create_msg(TEST_CODE_UNICAST);
+
+	zassert_equal(msg_unicast(p_msg), SYS_SUCCESS, "unicast failed");
+	zassert_equal(p_msg->header.rx_id, TEST_ID_B, "wrong unicast receiver");
+	zassert_false(msg_queue_is_empty(TEST_ID_B), "owner queue is empty");
+	zassert_true(msg_queue_is_empty(TEST_ID_C), "message was duplicated");
+}
+
+ZTEST(framework, test_unicast_without_owner)
+{
+	msg_t *p_msg = create_msg(TEST_CODE_UNUSED);
+
+	zassert_equal(msg_unicast(p_msg), SYS_ERROR, "unicast without owner succeeded");
+	buffer_pool_free(p_msg);
+}
+
+ZTEST(framework, test_defined_task)
+{
+	msg_t *p_msg = create_msg(TEST_CODE_DEFINED);
+
+	k_sleep(K_MSEC(10));
+	zassert_equal(atomic_get(&defined_task_started), 1, "start handler wasn't called");
+	zassert_equal_ptr(defined_task.rxer.p_msg_handlers, &dispatcher_defined_table,
+			  "handler table wasn't found");
+	zassert_is_null(dispatcher_defined(TEST_CODE_UNUSED), "code without a handler");
+
+	/* The defined task was registered by the framework. */
+	zassert_equal(msg_unicast(p_msg), SYS_SUCCESS, "defined task isn't routed");
+	k_sleep(K_MSEC(10));
+	zassert_equal(atomic_get(&defined_task_handled), 1, "defined task didn't handle message");
+}
+
+ZTEST(framework, test_broadcast_reaches_subscribers)
+{
+	msg_t *p_msg = create_msg(TEST_CODE_SHARED);
+
+	zassert_equal(msg_broadcast(p_msg, sizeof(msg_t)), SYS_SUCCESS, "broadcast failed");
+	zassert_false(msg_queue_is_empty(TEST_ID_A), "subscriber A missed broadcast");
+	zassert_false(msg_queue_is_empty(TEST_ID_B), "subscriber B missed broadcast");
+	zassert_true(msg_queue_is_empty(TEST_ID_C), "non-subscriber received broadcast");
+}
+
+ZTEST(framework, test_broadcast_to_full_queues)
+{
+	msg_t *p_msg = NULL;
+
+	/* FIFO queues don't have a depth. */
+	if (IS_ENABLED(CONFIG_SYS_MSG_FIFO)) {
+		ztest_test_skip();
+	}
+
+	for (int i = 0; i < 4; i++) {
+		zassert_equal(msg_broadcast(create_msg(TEST_CODE_SHARED), sizeof(msg_t)), SYS_SUCCESS,
+			      "broadcast failed");
+	}
+
+	/* Full queues aren't a routing error. */
+	p_msg = create_msg(TEST_CODE_SHARED);
+	zassert_equal(msg_broadcast(p_msg, sizeof(msg_t)), -ENOMSG, "full queues weren't reported");
+	zassert_false(p_msg->header.options & MSG_OPTION_SHARED, "rejected message is shared");
+	buffer_pool_free(p_msg);
+
+	p_msg = create_msg(TEST_CODE_UNUSED);
+	zassert_equal(msg_broadcast(p_msg, sizeof(msg_t)), SYS_ERROR, "broadcast without subscribers");
+	buffer_pool_free(p_msg);
+}
+
+ZTEST(framework, test_broadcast_shares_one_buffer)
+{
+	struct bp_stats before;
+	struct bp_stats after;
+	msg_t *p_msg_a = NULL;
+	msg_t *p_msg_b = NULL;
+	msg_t *p_msg = NULL;
+
+	if (IS_ENABLED(CONFIG_SYS_MSG_FIFO)) {
+		ztest_test_skip();
+	}
+
+	p_msg = create_msg(TEST_CODE_SHARED);
+	zassert_ok(buffer_pool_get_stats(0, &before), "stats not available");
+	zassert_equal(msg_broadcast(p_msg, sizeof(msg_t)), SYS_SUCCESS, "broadcast failed");
+	zassert_ok(buffer_pool_get_stats(0, &after), "stats not available");
+	zassert_equal(after.cur_allocs, before.cur_allocs, "broadcast copied the message");
+
+	zassert_ok(msg_recv(&queue_a, &p_msg_a, K_NO_WAIT), "A has no message");
+	zassert_ok(msg_recv(&queue_b, &p_msg_b, K_NO_WAIT), "B has no message");
+	zassert_equal_ptr(p_msg_a, p_msg_b, "subscribers got different buffers");
+	zassert_true(p_msg_a->header.options & MSG_OPTION_SHARED, "message isn't shared");
+
+	buffer_pool_free(p_msg_a);
+	zassert_ok(buffer_pool_get_stats(0, &after), "stats not available");
+	zassert_equal(after.cur_allocs, before.cur_allocs, "freed with a reference left");
+
+	buffer_pool_free(p_msg_b);
+	zassert_ok(buffer_pool_get_stats(0, &after), "stats not available");
+	zassert_equal(after.cur_allocs, before.cur_allocs - 1, "last reference didn't free");
+}
+
+ZTEST(framework, test_static_msg_overrun)
+{
+	static static_msg_t tick;
+
+	msg_static_init(&tick, TEST_CODE_UNICAST, TEST_ID_A);
+	zassert_equal(msg_static_send(&tick, TEST_ID_C), SYS_SUCCESS, "first tick failed");
+	zassert_equal(msg_static_send(&tick, TEST_ID_C), SYS_ERROR, "tick was queued twice");
+	zassert_equal(atomic_get(&tick.overruns), 1, "overrun wasn't counted");
+
+	zassert_equal(msg_flush(TEST_ID_C), 1, "tick wasn't queued");
+	zassert_equal(msg_static_send(&tick, TEST_ID_C), SYS_SUCCESS, "tick wasn't released");
+}
+
+ZTEST(framework, test_send_policies)
+{
+	msg_t *p_msg = NULL;
+	int i;
+
+	/* A k_fifo queue is never full. */
+	if (IS_ENABLED(CONFIG_SYS_MSG_FIFO)) {
+		ztest_test_skip();
+	}
+
+	for (i = 0; i < 4; i++) {
+		zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST + (i == 0))),
+			      SYS_SUCCESS, "queue filled early");
+	}
+
+	p_msg = create_msg(TEST_CODE_UNICAST);
+	zassert_equal(msg_send_with_policy(TEST_ID_C, p_msg, MSG_POLICY_FAIL_FAST, K_NO_WAIT),
+		      SYS_ERROR, "full queue accepted a message");
+	zassert_equal(msg_send_with_policy(TEST_ID_C, p_msg, MSG_POLICY_REPLACE, K_NO_WAIT),
+		      SYS_SUCCESS, "pending message wasn't replaced");
+
+	/* The oldest message is the only one with the other code. */
+	p_msg = create_msg(TEST_CODE_UNICAST);
+	zassert_equal(msg_send_with_policy(TEST_ID_C, p_msg, MSG_POLICY_DROP_OLDEST, K_NO_WAIT),
+		      SYS_SUCCESS, "oldest message wasn't dropped");
+	zassert_ok(msg_recv(&queue_c, &p_msg, K_NO_WAIT), "queue is empty");
+	zassert_equal(p_msg->header.msg_code, TEST_CODE_UNICAST, "oldest message is still queued");
+	buffer_pool_free(p_msg);
+}
+
+ZTEST(framework, test_msg_new_initializes_header)
+{
+	cb_msg_t *p_msg = NULL;
+
+	/* Leave a used header in the pool so that it could be taken again */
+	p_msg = buffer_pool_take(sizeof(cb_msg_t));
+	zassert_not_null(p_msg, "take failed");
+	memset(p_msg, 0xA5, sizeof(cb_msg_t));
+	buffer_pool_free(p_msg);
+
+	p_msg = MSG_NEW(cb_msg_t, TEST_CODE_UNICAST, TEST_ID_A, TEST_ID_C);
+	zassert_not_null(p_msg, "take failed");
+	zassert_equal(buffer_pool_size(p_msg), sizeof(cb_msg_t), "wrong size");
+	zassert_equal(p_msg->header.msg_code, TEST_CODE_UNICAST, "wrong code");
+	zassert_equal(p_msg->header.rx_id, TEST_ID_C, "wrong receiver");
+	zassert_equal(p_msg->header.tx_id, TEST_ID_A, "wrong sender");
+	zassert_equal(p_msg->header.options, MSG_OPTION_NONE, "stale options");
+	buffer_pool_free(p_msg);
+}
+
+#if CONFIG_BUFFER_POOL_COUNT > 1
+ZTEST(framework, test_pool_is_isolated)
+{
+	static void *buffers[TEST_POOL_SIZE / sizeof(msg_t)];
+	struct bp_stats before;
+	struct bp_stats after;
+	msg_t *p_msg = NULL;
+	size_t count = 0;
+
+	zassert_ok(buffer_pool_get_stats(TEST_POOL, &before), "stats not available");
+	zassert_equal(strcmp(before.name, "test_pool"), 0, "wrong pool name");
+
+	/* Receiver A creates its messages from the test pool */
+	rxer_a.pool = TEST_POOL;
+	p_msg = msg_new(sizeof(msg_t), TEST_CODE_UNICAST, TEST_ID_A, TEST_ID_C);
+	rxer_a.pool = BP_POOL_DEFAULT;
+	zassert_not_null(p_msg, "take failed");
+	zassert_equal(buffer_pool_index(p_msg), TEST_POOL, "message isn't in the test pool");
+	zassert_ok(buffer_pool_get_stats(TEST_POOL, &after), "stats not available");
+	zassert_equal(after.cur_allocs, before.cur_allocs + 1, "take wasn't counted");
+	buffer_pool_free(p_msg);
+
+	/* An empty pool doesn't take from the default pool */
+	while (count < ARRAY_SIZE(buffers)) {
+		buffers[count] = buffer_pool_try_to_take_from(TEST_POOL, sizeof(msg_t), K_NO_WAIT, __func__);
+		if (buffers[count] == NULL) {
+			break;
+		}
+		count++;
+	}
+	zassert_true(count > 0 && count < ARRAY_SIZE(buffers), "pool wasn't emptied");
+	p_msg = create_msg(TEST_CODE_UNICAST);
+	zassert_equal(buffer_pool_index(p_msg), BP_POOL_DEFAULT, "message isn't in the default pool");
+	buffer_pool_free(p_msg);
+
+	while (count > 0) {
+		buffer_pool_free(buffers[--count]);
+	}
+	zassert_ok(buffer_pool_get_stats(TEST_POOL, &after), "stats not available");
+	zassert_equal(after.cur_allocs, before.cur_allocs, "buffers weren't freed");
+	zassert_equal(after.take_failures, before.take_failures + 1, "failure wasn't counted");
+}
+#endif
+
+#ifdef CONFIG_BUFFER_POOL_SLAB
+static int slab_used_total(const struct bp_stats *p_stats)
+{
+	int used = 0;
+
+	for (size_t i = 0; i < BP_SLAB_CLASSES; i++) {
+		used += p_stats->slab_used[i];
+	}
+	return used;
+}
+
+ZTEST(framework, test_slab_class_and_heap_fallback)
+{
+	static void *buffers[64];
+	struct bp_stats before;
+	struct bp_stats after;
+	size_t class;
+	int count;
+
+	zassert_ok(buffer_pool_get_stats(0, &before), "stats not available");
+	buffers[0] = buffer_pool_take(sizeof(msg_t));
+	zassert_not_null(buffers[0], "take failed");
+	zassert_equal(buffer_pool_size(buffers[0]), sizeof(msg_t), "wrong size");
+	zassert_ok(buffer_pool_get_stats(0, &after), "stats not available");
+	zassert_equal(slab_used_total(&after), slab_used_total(&before) + 1, "message isn't in a slab");
+
+	for (class = 0; class < BP_SLAB_CLASSES; class++) {
+		if (after.slab_used[class] != before.slab_used[class]) {
+			break;
+		}
+	}
+	count = after.slab_free[class];
+	if (count >= (int)ARRAY_SIZE(buffers)) {
+		buffer_pool_free(buffers[0]);
+		ztest_test_skip();
+	}
+
+	/* Empty the class, the next buffer comes from the heap */
+	for (int i = 1; i <= count + 1; i++) {
+		buffers[i] = buffer_pool_take(sizeof(msg_t));
+		zassert_not_null(buffers[i], "take failed");
+	}
+	zassert_ok(buffer_pool_get_stats(0, &after), "stats not available");
+	zassert_equal(after.slab_free[class], 0, "class isn't empty");
+	zassert_equal(after.heap_fallbacks, before.heap_fallbacks + 1, "heap wasn't used");
+
+	for (int i = 0; i <= count + 1; i++) {
+		buffer_pool_free(buffers[i]);
+	}
+	zassert_ok(buffer_pool_get_stats(0, &after), "stats not available");
+	zassert_equal(slab_used_total(&after), slab_used_total(&before), "blocks weren't returned");
+	zassert_equal(after.cur_allocs, before.cur_allocs, "buffers weren't freed");
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_INLINE
+ZTEST(framework, test_inline_msg)
+{
+	struct bp_stats before;
+	struct bp_stats after;
+
+	zassert_ok(buffer_pool_get_stats(0, &before), "stats not available");
+	zassert_equal(msg_send_inline(TEST_ID_DEFINED, TEST_ID_A, TEST_CODE_INLINE, MSG_OPTION_NONE),
+		      SYS_SUCCESS, "inline send failed");
+	zassert_ok(buffer_pool_get_stats(0, &after), "stats not available");
+	zassert_equal(after.cur_allocs, before.cur_allocs, "inline message was allocated");
+
+	zassert_ok(k_sem_take(&inline_handled, K_MSEC(100)), "inline message wasn't handled");
+	zassert_equal(inline_header.msg_code, TEST_CODE_INLINE, "wrong code");
+	zassert_equal(inline_header.tx_id, TEST_ID_A, "wrong sender");
+	zassert_equal(inline_header.rx_id, TEST_ID_DEFINED, "wrong receiver");
+	zassert_true(inline_header.options & MSG_OPTION_INLINE, "message isn't inline");
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_FIFO
+ZTEST(framework, test_fifo_queue_has_no_depth)
+{
+	msg_t *p_msg = NULL;
+	msg_t *p_msg_a = NULL;
+	msg_t *p_msg_b = NULL;
+	int i;
+
+	/* The queues are defined with a depth of 4. */
+	for (i = 0; i < 6; i++) {
+		zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS,
+			      "message wasn't queued");
+	}
+	zassert_equal(msg_flush(TEST_ID_C), 6, "wrong number of queued messages");
+
+	/* Each subscriber of a broadcast gets its own buffer. */
+	p_msg = create_msg(TEST_CODE_SHARED);
+	zassert_equal(msg_broadcast(p_msg, sizeof(msg_t)), SYS_SUCCESS, "broadcast failed");
+	zassert_ok(msg_recv(&queue_a, &p_msg_a, K_NO_WAIT), "A has no message");
+	zassert_ok(msg_recv(&queue_b, &p_msg_b, K_NO_WAIT), "B has no message");
+	zassert_not_equal(p_msg_a, p_msg_b, "subscribers got the same buffer");
+	zassert_equal(p_msg_a->header.msg_code, p_msg_b->header.msg_code, "copy differs");
+	buffer_pool_free(p_msg_a);
+	buffer_pool_free(p_msg_b);
+}
+#endif
+
+ZTEST(framework, test_deferred_handler)
+{
+	msg_pending_init(&defer_pending, TEST_ID_DEFINED);
+	zassert_equal(msg_send(TEST_ID_DEFINED, create_msg(TEST_CODE_DEFER)), SYS_SUCCESS,
+		      "send failed");
+
+	/* The task keeps handling messages while the handler is deferred. */
+	zassert_equal(msg_send(TEST_ID_DEFINED, create_msg(TEST_CODE_INLINE)), SYS_SUCCESS,
+		      "send failed");
+	zassert_ok(k_sem_take(&inline_handled, K_MSEC(10)), "task is blocked");
+
+	/* Deferring from the resume handler doesn't lose the next resume. */
+	zassert_ok(k_sem_take(&defer_done, K_MSEC(100)), "handler wasn't resumed");
+	zassert_equal(defer_resumed_state, 42, "state wasn't saved");
+	zassert_equal(atomic_get(&defer_pending.resume_msg.overruns), 0, "resume overran");
+}
+
+ZTEST(framework, test_call_reply)
+{
+	msg_t *p_reply = NULL;
+
+	zassert_equal(sysmsg_call(TEST_ID_DEFINED, create_msg(TEST_CODE_CALL), &p_reply, K_MSEC(100)),
+		      SYS_SUCCESS, "call failed");
+	zassert_not_null(p_reply, "no reply");
+	zassert_equal(p_reply->header.msg_code, TEST_CODE_CALL_REPLY, "wrong reply code");
+	zassert_true(p_reply->header.options & MSG_OPTION_REPLY, "reply isn't marked");
+	msg_release(p_reply);
+}
+
+ZTEST(framework, test_call_reply_at_timeout)
+{
+	msg_t *p_reply = NULL;
+	BaseType_t result;
+
+	for (call_delay_us = TEST_CALL_TIMEOUT_US - 2000; call_delay_us <= TEST_CALL_TIMEOUT_US + 2000;
+	     call_delay_us += 100) {
+		p_reply = NULL;
+		result = sysmsg_call(TEST_ID_DEFINED, create_msg(TEST_CODE_CALL_SLOW), &p_reply,
+				     K_USEC(TEST_CALL_TIMEOUT_US));
+		if (result == SYS_SUCCESS) {
+			zassert_not_null(p_reply, "success without a reply at %u us", call_delay_us);
+			msg_release(p_reply);
+		} else {
+			zassert_is_null(p_reply, "reply after a timeout at %u us", call_delay_us);
+		}
+	}
+
+	/* A late reply is freed by the framework, wait for the last one. */
+	k_usleep(2 * TEST_CALL_TIMEOUT_US);
+}
+
+ZTEST(framework, test_call_cb_table_recovers)
+{
+	/* Receiver C never replies, so every call is lost. */
+	for (int i = 0; i < CONFIG_SYS_MSG_CALL_MAX_PENDING; i++) {
+		zassert_equal(sysmsg_call_cb(TEST_ID_C, create_msg(TEST_CODE_UNICAST), test_msg_handler),
+			      SYS_SUCCESS, "call %d failed", i);
+	}
+	zassert_equal(sysmsg_call_cb(TEST_ID_C, create_msg(TEST_CODE_UNICAST), test_msg_handler), SYS_ERROR,
+		      "call table isn't full");
+	msg_flush(TEST_ID_C);
+
+	/* The lost calls are given up after their timeout. */
+	k_msleep(CONFIG_SYS_MSG_CALL_CB_TIMEOUT_MS + 10);
+	for (int i = 0; i < CONFIG_SYS_MSG_CALL_MAX_PENDING; i++) {
+		zassert_equal(sysmsg_call_cb(TEST_ID_C, create_msg(TEST_CODE_UNICAST), test_msg_handler),
+			      SYS_SUCCESS, "call table didn't recover");
+	}
+	msg_flush(TEST_ID_C);
+
+	/* Leave the table free for the other tests. */
+	k_msleep(CONFIG_SYS_MSG_CALL_CB_TIMEOUT_MS + 10);
+}
+
+ZTEST(framework, test_publish_reaches_topic_subscribers)
+{
+	event_msg_t *p_event_msg = NULL;
+
+	zassert_equal(msg_topic_subscribe(TEST_ID_A, MSG_TOPIC(SENSOR_EVENT_TEMPERATURE)), SYS_SUCCESS,
+		      "subscribe failed");
+	zassert_equal(msg_topic_subscribe(TEST_ID_C, MSG_TOPIC(SENSOR_EVENT_TEMPERATURE)), SYS_SUCCESS,
+		      "subscribe failed");
+	zassert_equal(msg_topic_subscribe(TEST_ID_B, MSG_TOPIC(SENSOR_EVENT_HUMIDITY)), SYS_SUCCESS,
+		      "subscribe failed");
+
+	zassert_equal(sysmsg_publish(TEST_ID_DEFINED, SENSOR_EVENT_TEMPERATURE, (event_data_t)25), SYS_SUCCESS,
+		      "publish failed");
+	zassert_false(msg_queue_is_empty(TEST_ID_A), "subscriber A missed event");
+	zassert_false(msg_queue_is_empty(TEST_ID_C), "subscriber C missed event");
+	zassert_true(msg_queue_is_empty(TEST_ID_B), "subscriber of another topic received event");
+
+	zassert_ok(msg_recv(&queue_a, &p_event_msg, K_NO_WAIT), "A has no message");
+	zassert_equal(p_event_msg->header.msg_code, SMC_SENSOR_EVENT, "wrong code");
+	zassert_equal(p_event_msg->event_data.u32, 25, "wrong value");
+	zassert_equal(!!(p_event_msg->header.options & MSG_OPTION_SHARED), !IS_ENABLED(CONFIG_SYS_MSG_FIFO),
+		      "event isn't shared");
+	msg_release((msg_t *)p_event_msg);
+
+	msg_topic_unsubscribe(TEST_ID_A, MSG_TOPIC_ALL);
+	msg_topic_unsubscribe(TEST_ID_B, MSG_TOPIC_ALL);
+	msg_topic_unsubscribe(TEST_ID_C, MSG_TOPIC_ALL);
+	zassert_equal(msg_topic_subscribers(SENSOR_EVENT_TEMPERATURE), 0, "subscribers left");
+}
+
+ZTEST(framework, test_publish_without_subscribers)
+{
+	struct bp_stats before;
+	struct bp_stats after;
+
+	/* The event filter task would free the event later */
+	if (IS_ENABLED(CONFIG_SYS_MSG_EVENT_FILTER)) {
+		ztest_test_skip();
+	}
+
+	zassert_equal(msg_topic_subscribers(SENSOR_EVENT_TEMPERATURE), 0, "topic has subscribers");
+	zassert_ok(buffer_pool_get_stats(msg_pool(TEST_ID_DEFINED), &before), "stats not available");
+	zassert_equal(sysmsg_publish(TEST_ID_DEFINED, SENSOR_EVENT_TEMPERATURE, (event_data_t)25), SYS_SUCCESS,
+		      "publish without subscribers failed");
+	zassert_ok(buffer_pool_get_stats(msg_pool(TEST_ID_DEFINED), &after), "stats not available");
+	zassert_equal(after.cur_allocs, before.cur_allocs, "event wasn't freed");
+}
+
+ZTEST(framework, test_coalesce_pending_msg)
+{
+	struct bp_stats before;
+	struct bp_stats after;
+
+	msg_coalesce_set(TEST_CODE_UNICAST, true);
+	zassert_ok(buffer_pool_get_stats(0, &before), "stats not available");
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	zassert_ok(buffer_pool_get_stats(0, &after), "stats not available");
+	zassert_equal(after.cur_allocs, before.cur_allocs + 1, "pending message wasn't freed");
+	msg_coalesce_set(TEST_CODE_UNICAST, false);
+
+	zassert_equal(msg_flush(TEST_ID_C), 1, "messages weren't coalesced");
+}
+
+ZTEST(framework, test_coalesce_keeps_resume_msg)
+{
+	static static_msg_t resume;
+
+	/* A resume message carries the state of a deferred handler. */
+	msg_static_init(&resume, TEST_CODE_UNICAST, TEST_ID_C);
+	resume.msg.header.options |= MSG_OPTION_RESUME;
+	msg_coalesce_set(TEST_CODE_UNICAST, true);
+
+	zassert_equal(msg_static_send(&resume, TEST_ID_C), SYS_SUCCESS, "resume send failed");
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_flush(TEST_ID_C), 2, "resume message was replaced");
+
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_static_send(&resume, TEST_ID_C), SYS_SUCCESS, "resume send failed");
+	zassert_equal(msg_flush(TEST_ID_C), 2, "pending message was replaced by a resume message");
+
+	msg_coalesce_set(TEST_CODE_UNICAST, false);
+}
+
+ZTEST(framework, test_ttl_discards_stale_msg)
+{
+	msg_t *p_stale = create_msg(TEST_CODE_UNICAST);
+	atomic_val_t handled = atomic_get(&test_msg_handled);
+
+	msg_set_ttl(p_stale, 1);
+	zassert_equal(msg_send(TEST_ID_C, p_stale), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	k_sleep(K_MSEC(5));
+
+	/* Both are received, but only the message without a TTL is handled. */
+	zassert_equal(msg_receiver_batch(&rxer_c, 4), 2, "wrong number of received messages");
+	zassert_equal(atomic_get(&test_msg_handled), handled + 1, "stale message was handled");
+}
+
+ZTEST(framework, test_batch_drains_queued_msgs)
+{
+	atomic_val_t handled = atomic_get(&test_msg_handled);
+
+	for (int i = 0; i < 3; i++) {
+		zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	}
+
+	/* The budget limits a batch and the rest stays queued. */
+	zassert_equal(msg_receiver_batch(&rxer_c, 2), 2, "budget wasn't used");
+	zassert_false(msg_queue_is_empty(TEST_ID_C), "batch went over its budget");
+	zassert_equal(msg_receiver_batch(&rxer_c, 0), 1, "queued message wasn't received");
+	zassert_true(msg_queue_is_empty(TEST_ID_C), "queue wasn't drained");
+	zassert_equal(atomic_get(&test_msg_handled), handled + 3, "wrong number of handled messages");
+
+	/* An empty queue doesn't block without rx_block_ticks. */
+	zassert_equal(msg_receiver_batch(&rxer_c, 0), 0, "empty queue dispatched a message");
+}
+
+#ifdef CONFIG_SYS_MSG_EXECUTOR
+ZTEST(framework, test_executor_dispatches_actor)
+{
+	atomic_set(&actor_handled, 0);
+	for (int i = 0; i < 3; i++) {
+		zassert_equal(msg_send(TEST_ID_ACTOR, create_msg(TEST_CODE_ACTOR)), SYS_SUCCESS, "send failed");
+	}
+
+	/* The actor has no thread, a worker of the executor handles its queue. */
+	zassert_ok(k_sem_take(&actor_done, K_MSEC(100)), "actor wasn't serviced");
+	zassert_equal(atomic_get(&actor_handled), 3, "wrong number of handled messages");
+	zassert_not_equal(actor_thread, k_current_get(), "actor was handled by the sender");
+	zassert_true(msg_queue_is_empty(TEST_ID_ACTOR), "actor queue wasn't drained");
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_PRIORITY_LANES
+static static_msg_t lane_msg;
+
+static void lane_timer_handler(struct k_timer *p_timer)
+{
+	ARG_UNUSED(p_timer);
+
+	msg_static_send(&lane_msg, TEST_ID_C);
+}
+
+static K_TIMER_DEFINE(lane_timer, lane_timer_handler, NULL);
+
+ZTEST(framework, test_urgent_msg_is_served_first)
+{
+	msg_t *p_urgent = create_msg(TEST_CODE_UNICAST);
+
+	p_urgent->header.options |= MSG_OPTION_URGENT;
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_send(TEST_ID_C, p_urgent), SYS_SUCCESS, "urgent send failed");
+
+	/* The urgent message was sent last, but it is handled first. */
+	zassert_equal(msg_receiver_batch(&rxer_c, 1), 1, "message wasn't received");
+	zassert_true(test_msg_options & MSG_OPTION_URGENT, "normal message was served first");
+	zassert_equal(msg_receiver_batch(&rxer_c, 0), 2, "normal lane wasn't served");
+	zassert_false(test_msg_options & MSG_OPTION_URGENT, "urgent message was handled twice");
+}
+
+ZTEST(framework, test_receiver_wakes_from_either_lane)
+{
+	TickType_t block_ticks = rxer_c.rx_block_ticks;
+	const uint8_t lanes[] = {MSG_OPTION_NONE, MSG_OPTION_URGENT};
+
+	rxer_c.rx_block_ticks = K_MSEC(100);
+	for (size_t i = 0; i < ARRAY_SIZE(lanes); i++) {
+		msg_static_init(&lane_msg, TEST_CODE_UNICAST, TEST_ID_C);
+		lane_msg.msg.header.options |= lanes[i];
+
+		/* The receiver is blocked in k_poll when the message is sent. */
+		k_timer_start(&lane_timer, K_MSEC(10), K_NO_WAIT);
+		zassert_equal(msg_receiver_batch(&rxer_c, 1), 1, "receiver didn't wake up");
+		zassert_equal(test_msg_options & MSG_OPTION_URGENT, lanes[i], "message came from the wrong lane");
+	}
+	rxer_c.rx_block_ticks = block_ticks;
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_SCHED
+MSG_SCHED_DEFINE(sched_c, MSG_SCHED_CLASS_DEFAULT, 0,
+		 MSG_SCHED(TEST_CODE_UNICAST, MSG_SCHED_CLASS_CRITICAL, 1000));
+
+ZTEST(framework, test_sched_class_is_applied_at_dispatch)
+{
+	int priority = k_thread_priority_get(k_current_get());
+
+	rxer_c.p_sched = &sched_c;
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_receiver_batch(&rxer_c, 1), 1, "message wasn't received");
+	rxer_c.p_sched = NULL;
+
+	zassert_equal(test_msg_priority, CONFIG_SYS_MSG_SCHED_CRITICAL_PRIORITY, "class wasn't applied");
+	zassert_equal(k_thread_priority_get(k_current_get()), priority, "priority wasn't restored");
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_RECORD
+ZTEST(framework, test_record_and_replay)
+{
+	struct msg_record records[4];
+	struct msg_replay_report report;
+	size_t count;
+
+	msg_record_clear();
+	msg_record_start();
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_UNICAST)), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_send(TEST_ID_C, create_msg(TEST_CODE_INLINE)), SYS_SUCCESS, "send failed");
+	zassert_equal(msg_flush(TEST_ID_C), 2, "messages weren't queued");
+
+	count = msg_record_snapshot(records, ARRAY_SIZE(records), NULL);
+	zassert_equal(count, 2, "wrong number of records");
+	zassert_equal(records[0].rx_id, TEST_ID_C, "wrong receiver recorded");
+	zassert_equal(records[0].msg_code, TEST_CODE_UNICAST, "wrong code recorded");
+	zassert_equal(records[1].msg_code, TEST_CODE_INLINE, "records out of order");
+
+	/* Back to back, nobody drains receiver C. */
+	zassert_equal(msg_replay(records, count, 0, 0, &report), 0, "replay failed");
+	zassert_equal(report.sent, 2, "replay didn't send the stream");
+	zassert_equal(report.failed, 0, "replay failed to send");
+	zassert_equal(report.max_queued[TEST_ID_C], 2, "wrong queue depth");
+	zassert_equal(msg_flush(TEST_ID_C), 2, "replayed messages weren't queued");
+
+	/* The replay itself isn't recorded. */
+	zassert_equal(msg_record_snapshot(records, ARRAY_SIZE(records), NULL), 2, "replay was recorded");
+}
+#endif
+
+#ifdef CONFIG_SYS_MSG_REMOTE
+ZTEST(framework, test_remote_proxy_loopback)
+{
+	static const uint8_t payload[] = {0x7e, 0x7d, 1, 2};
+	struct msg_remote_stats stats;
+	msg_t *p_msg = buffer_pool_take(sizeof(msg_header_t) + sizeof(payload));
+	msg_t *p_received = NULL;
+
+	/* Messages to TEST_ID_REMOTE come back over the link to receiver C. */
+	zassert_equal(msg_remote_register(TEST_ID_REMOTE, TEST_ID_C), 0, "proxy wasn't registered");
+	zassert_equal(msg_remote_register(TEST_ID_C, TEST_ID_A), -EINVAL, "local receiver became a proxy");
+	zassert_true(msg_remote_is_proxy(TEST_ID_REMOTE), "proxy isn't listed");
+
+	/* The payload holds the flag and escape bytes of the framing. */
+	zassert_not_null(p_msg, "buffer pool is empty");
+	SYS_MSG_HEADER_INIT(p_msg, TEST_CODE_UNICAST, TEST_ID_A);
+	memcpy((uint8_t *)p_msg + sizeof(msg_header_t), payload, sizeof(payload));
+	zassert_equal(msg_send(TEST_ID_REMOTE, p_msg), SYS_SUCCESS, "send failed");
+
+	zassert_equal(msg_recv(&queue_c, &p_received, K_MSEC(500)), SYS_SUCCESS, "message didn't cross the link");
+	zassert_equal(p_received->header.msg_code, TEST_CODE_UNICAST, "wrong code");
+	zassert_equal(p_received->header.tx_id, TEST_ID_A, "wrong sender");
+	zassert_equal(buffer_pool_size(p_received), sizeof(msg_header_t) + sizeof(payload), "wrong size");
+	zassert_mem_equal((uint8_t *)p_received + sizeof(msg_header_t), payload, sizeof(payload), "wrong payload");
+	msg_release(p_received);
+
+#ifdef CONFIG_SYS_MSG_INLINE
+	msg_header_t header;
+
+	zassert_equal(msg_send_inline(TEST_ID_REMOTE, TEST_ID_B, TEST_CODE_UNICAST, MSG_OPTION_NONE), SYS_SUCCESS,
+		      "send failed");
+	zassert_equal(msg_recv(&queue_c, &p_received, K_MSEC(500)), SYS_SUCCESS, "message didn't cross the link");
+	msg_entry_header(p_received, &header);
+	zassert_equal(header.msg_code, TEST_CODE_UNICAST, "wrong code");
+	zassert_equal(header.tx_id, TEST_ID_B, "wrong sender");
+	msg_release(p_received);
+#endif
+
+	msg_remote_stats_get(&stats);
+	zassert_equal(stats.msgs_received, stats.msgs_sent, "messages were lost");
+	zassert_equal(stats.crc_errors, 0, "frame was corrupted");
+	zassert_equal(stats.lost_frames, 0, "frame was lost");
+}
+#endif
+
+ZTEST(framework, test_isr_broadcast_is_deferred)
+{
+	zassert_equal(msg_isr_broadcast(TEST_ID_DEFINED, TEST_CODE_SHARED), SYS_SUCCESS, "ring is full");
+
+	/* The work item sends the broadcast in thread context. */
+	k_sleep(K_MSEC(10));
+	zassert_false(msg_queue_is_empty(TEST_ID_A), "subscriber A missed broadcast");
+	zassert_false(msg_queue_is_empty(TEST_ID_B), "subscriber B missed broadcast");
+	zassert_true(msg_queue_is_empty(TEST_ID_C), "non-subscriber received broadcast");
+	zassert_equal(msg_isr_drops(), 0, "records were dropped");
+}
+
+ZTEST_SUITE(framework, NULL, framework_setup, NULL, framework_after, NULL);